@@ -0,0 +1,347 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file AssemblyBufferPool.h
+/// Recycled buffers for reassembling slices into contiguous frames.
+///
+/// Frame sizes swing by an order of magnitude between I- and P-frames, so a
+/// single growable buffer either wastes memory or reallocates and copies on
+/// every keyframe. NvstAssemblyBufferPool keeps a few size classes learned
+/// from the frames it has seen, and hands buffers out as ready-made decode
+/// units whose releaseProc puts them back on the free list.
+
+#pragma once
+
+#include "../common/Histogram.h"
+#include "../common/VideoDecodeUnit.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+/// Number of size classes of an NvstAssemblyBufferPool.
+#define NVST_ASSEMBLY_BUFFER_CLASS_COUNT 4
+
+/// Zeroed bytes past the end of every assembled frame, so SIMD bitstream readers may over-read.
+#define NVST_ASSEMBLY_BUFFER_PADDING 64
+
+/// Configuration of NvstAssemblyBufferPool.
+/// \ingroup VideoData
+typedef struct NvstAssemblyBufferPoolConfig_t
+{
+    /// Initial size of every class, and the smallest a class may become.
+    uint32_t minBufferBytes;
+    /// Size classes are recomputed after this many released frames.
+    uint32_t relearnInterval;
+    /// Class sizes are the learned quantiles times this factor.
+    double headroom;
+    /// Idle buffers kept per class; buffers released beyond that are freed.
+    uint32_t maxIdleBuffersPerClass;
+} NvstAssemblyBufferPoolConfig;
+
+/// Default configuration: 64 KB minimum, relearn every 256 frames, 25% headroom, 8 idle buffers per class.
+static inline void nvstAssemblyBufferPoolGetDefaultConfig(NvstAssemblyBufferPoolConfig* config)
+{
+    config->minBufferBytes = 64 * 1024;
+    config->relearnInterval = 256;
+    config->headroom = 1.25;
+    config->maxIdleBuffersPerClass = 8;
+}
+
+/// Counters of an NvstAssemblyBufferPool.
+/// \ingroup VideoData
+typedef struct NvstAssemblyBufferPoolStats_t
+{
+    /// Buffers handed out.
+    uint64_t acquired;
+    /// Buffers returned through releaseProc.
+    uint64_t released;
+    /// Heap allocations; stays flat once the classes have settled.
+    uint64_t allocations;
+    /// Times append() outgrew a buffer and moved the frame to a larger one.
+    uint64_t grows;
+    /// Current size of each class in bytes, smallest first.
+    uint32_t classBytes[NVST_ASSEMBLY_BUFFER_CLASS_COUNT];
+} NvstAssemblyBufferPoolStats;
+
+class NvstAssemblyBufferPool;
+
+/// A frame being assembled. vdu describes the assembled bytes and can be passed to the decoder as-is.
+/// \ingroup VideoData
+typedef struct NvstAssemblyBuffer_t
+{
+    /// Decode unit of the frame. streamBuffer/streamSizeBytes track the appended data and
+    /// releaseProc returns the buffer to its pool; the other fields are for the caller to fill in.
+    NvstVideoDecodeUnit vdu;
+    /// Bytes available in the buffer, excluding the padding.
+    uint32_t capacity;
+    /// Owning pool.
+    NvstAssemblyBufferPool* pool;
+} NvstAssemblyBuffer;
+
+/// Pool of frame assembly buffers with size classes learned from observed frame sizes.
+///
+/// The classes track the 50th, 90th and 99th percentile and the maximum of
+/// recent frame sizes, plus headroom. Intra frames are given a buffer of the
+/// largest class up front, so a keyframe is assembled without reallocation.
+/// Buffers are 64 byte aligned. Thread safe; acquire and release take a short lock.
+/// \warning Every buffer must be released before the pool is destroyed.
+/// \ingroup VideoData
+class NvstAssemblyBufferPool
+{
+public:
+    explicit NvstAssemblyBufferPool(const NvstAssemblyBufferPoolConfig& config)
+        : m_config(config)
+    {
+        if (m_config.relearnInterval == 0)
+        {
+            m_config.relearnInterval = 1;
+        }
+        if (m_config.headroom < 1.0)
+        {
+            m_config.headroom = 1.0;
+        }
+        for (uint32_t i = 0; i < NVST_ASSEMBLY_BUFFER_CLASS_COUNT; ++i)
+        {
+            m_classBytes[i] = roundUp(m_config.minBufferBytes);
+            m_idle[i].reserve(m_config.maxIdleBuffersPerClass);
+        }
+    }
+
+    ~NvstAssemblyBufferPool()
+    {
+        for (std::vector<NvstAssemblyBuffer*>& idle : m_idle)
+        {
+            for (NvstAssemblyBuffer* buffer : idle)
+            {
+                freeBuffer(buffer);
+            }
+        }
+    }
+
+    NvstAssemblyBufferPool(const NvstAssemblyBufferPool&) = delete;
+    NvstAssemblyBufferPool& operator=(const NvstAssemblyBufferPool&) = delete;
+
+    /// Take an empty buffer for a new frame.
+    /// \param[in] expectedBytes Best guess of the frame size, e.g. first slice size times slicesInFrame; 0 if unknown.
+    /// \param[in] intra Whether the frame is an intra frame; picks the largest class.
+    /// \return The buffer, or NULL if memory is exhausted.
+    NvstAssemblyBuffer* acquire(uint32_t expectedBytes, bool intra)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t sizeClass = NVST_ASSEMBLY_BUFFER_CLASS_COUNT - 1;
+        if (!intra)
+        {
+            sizeClass = 0;
+            while (sizeClass + 1 < NVST_ASSEMBLY_BUFFER_CLASS_COUNT && m_classBytes[sizeClass] < expectedBytes)
+            {
+                ++sizeClass;
+            }
+        }
+        NvstAssemblyBuffer* buffer = takeLocked(sizeClass, expectedBytes);
+        if (buffer)
+        {
+            ++m_stats.acquired;
+        }
+        return buffer;
+    }
+
+    /// Append bytes to a frame, moving it to a larger buffer if necessary.
+    /// \param[in,out] buffer Frame being assembled; may be replaced by a larger buffer.
+    /// \param[in] data Bytes to append, e.g. a slice's streamBuffer.
+    /// \param[in] size Number of bytes.
+    /// \return false if a larger buffer couldn't be allocated; buffer is unchanged in that case.
+    bool append(NvstAssemblyBuffer** buffer, const void* data, uint32_t size)
+    {
+        NvstAssemblyBuffer* current = *buffer;
+        const uint64_t needed = static_cast<uint64_t>(current->vdu.streamSizeBytes) + size;
+        if (needed > current->capacity)
+        {
+            if (needed > UINT32_MAX - NVST_ASSEMBLY_BUFFER_PADDING)
+            {
+                return false;
+            }
+            NvstAssemblyBuffer* larger;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                larger = takeLocked(NVST_ASSEMBLY_BUFFER_CLASS_COUNT - 1, static_cast<uint32_t>(needed));
+                if (!larger)
+                {
+                    return false;
+                }
+                ++m_stats.grows;
+            }
+            std::memcpy(larger->vdu.streamBuffer, current->vdu.streamBuffer, current->vdu.streamSizeBytes);
+            larger->vdu.streamSizeBytes = current->vdu.streamSizeBytes;
+            giveBack(current, false);
+            current = larger;
+            *buffer = larger;
+        }
+        uint8_t* bytes = static_cast<uint8_t*>(current->vdu.streamBuffer);
+        std::memcpy(bytes + current->vdu.streamSizeBytes, data, size);
+        current->vdu.streamSizeBytes += size;
+        std::memset(bytes + current->vdu.streamSizeBytes, 0, NVST_ASSEMBLY_BUFFER_PADDING);
+        return true;
+    }
+
+    /// Return a buffer. Has the RELEASE_VU_PROC signature and is installed as the buffer's vdu.releaseProc.
+    /// The size of the released frame feeds the size class estimate.
+    static void release(const NvstVideoDecodeUnit* vdu)
+    {
+        NvstAssemblyBuffer* buffer = static_cast<NvstAssemblyBuffer*>(vdu->decodeUnitCtx);
+        buffer->pool->giveBack(buffer, true);
+    }
+
+    NvstAssemblyBufferPoolStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        NvstAssemblyBufferPoolStats stats = m_stats;
+        for (uint32_t i = 0; i < NVST_ASSEMBLY_BUFFER_CLASS_COUNT; ++i)
+        {
+            stats.classBytes[i] = m_classBytes[i];
+        }
+        return stats;
+    }
+
+private:
+    static uint32_t roundUp(uint64_t bytes)
+    {
+        const uint64_t rounded = (bytes + 4095) & ~4095ull;
+        return rounded > UINT32_MAX - 4096 ? UINT32_MAX - 4095 : static_cast<uint32_t>(rounded);
+    }
+
+    /// Take an idle buffer of a class that holds at least minBytes, or allocate one.
+    NvstAssemblyBuffer* takeLocked(uint32_t sizeClass, uint32_t minBytes)
+    {
+        const uint32_t needed = minBytes > m_classBytes[sizeClass] ? roundUp(minBytes) : m_classBytes[sizeClass];
+        NvstAssemblyBuffer* buffer = nullptr;
+        // Prefer the requested class, but a larger idle buffer beats an allocation.
+        for (uint32_t c = sizeClass; c < NVST_ASSEMBLY_BUFFER_CLASS_COUNT && !buffer; ++c)
+        {
+            std::vector<NvstAssemblyBuffer*>& idle = m_idle[c];
+            for (size_t i = idle.size(); i-- > 0;)
+            {
+                if (idle[i]->capacity >= needed)
+                {
+                    buffer = idle[i];
+                    idle[i] = idle.back();
+                    idle.pop_back();
+                    break;
+                }
+            }
+        }
+        if (!buffer)
+        {
+            buffer = allocate(needed);
+            if (!buffer)
+            {
+                return nullptr;
+            }
+            ++m_stats.allocations;
+        }
+        void* memory = buffer->vdu.streamBuffer;
+        buffer->vdu = NvstVideoDecodeUnit();
+        buffer->vdu.streamBuffer = memory;
+        buffer->vdu.decodeUnitCtx = buffer;
+        buffer->vdu.releaseProc = &NvstAssemblyBufferPool::release;
+        buffer->pool = this;
+        return buffer;
+    }
+
+    void giveBack(NvstAssemblyBuffer* buffer, bool learn)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (learn)
+        {
+            ++m_stats.released;
+            m_sizes.record(buffer->vdu.streamSizeBytes);
+            if (++m_sinceRelearn >= m_config.relearnInterval)
+            {
+                relearnLocked();
+            }
+        }
+        // File the buffer under the largest class it can serve.
+        int32_t sizeClass = NVST_ASSEMBLY_BUFFER_CLASS_COUNT - 1;
+        while (sizeClass >= 0 && buffer->capacity < m_classBytes[sizeClass])
+        {
+            --sizeClass;
+        }
+        if (sizeClass < 0 || m_idle[sizeClass].size() >= m_config.maxIdleBuffersPerClass)
+        {
+            freeBuffer(buffer);
+            return;
+        }
+        m_idle[sizeClass].push_back(buffer);
+    }
+
+    void relearnLocked()
+    {
+        static const double kQuantiles[NVST_ASSEMBLY_BUFFER_CLASS_COUNT] = {0.5, 0.9, 0.99, 1.0};
+        for (uint32_t i = 0; i < NVST_ASSEMBLY_BUFFER_CLASS_COUNT; ++i)
+        {
+            const double bytes = static_cast<double>(m_sizes.valueAtQuantile(kQuantiles[i])) * m_config.headroom;
+            const uint32_t classBytes = roundUp(static_cast<uint64_t>(bytes));
+            m_classBytes[i] = classBytes > m_config.minBufferBytes ? classBytes : roundUp(m_config.minBufferBytes);
+        }
+        // Forget old frames, so the classes follow resolution and bitrate changes.
+        m_sizes.reset();
+        m_sinceRelearn = 0;
+    }
+
+    static NvstAssemblyBuffer* allocate(uint32_t capacity)
+    {
+        const size_t bytes = static_cast<size_t>(capacity) + NVST_ASSEMBLY_BUFFER_PADDING;
+#ifdef _WIN32
+        void* memory = _aligned_malloc(bytes, 64);
+#else
+        void* memory = nullptr;
+        if (posix_memalign(&memory, 64, bytes) != 0)
+        {
+            memory = nullptr;
+        }
+#endif
+        if (!memory)
+        {
+            return nullptr;
+        }
+        NvstAssemblyBuffer* buffer = new NvstAssemblyBuffer();
+        buffer->vdu.streamBuffer = memory;
+        buffer->capacity = capacity;
+        buffer->pool = nullptr;
+        std::memset(memory, 0, NVST_ASSEMBLY_BUFFER_PADDING);
+        return buffer;
+    }
+
+    static void freeBuffer(NvstAssemblyBuffer* buffer)
+    {
+#ifdef _WIN32
+        _aligned_free(buffer->vdu.streamBuffer);
+#else
+        free(buffer->vdu.streamBuffer);
+#endif
+        delete buffer;
+    }
+
+    NvstAssemblyBufferPoolConfig m_config;
+    mutable std::mutex m_mutex;
+    uint32_t m_classBytes[NVST_ASSEMBLY_BUFFER_CLASS_COUNT];
+    std::vector<NvstAssemblyBuffer*> m_idle[NVST_ASSEMBLY_BUFFER_CLASS_COUNT];
+    NvstHistogram m_sizes;
+    uint32_t m_sinceRelearn = 0;
+    NvstAssemblyBufferPoolStats m_stats = {};
+};
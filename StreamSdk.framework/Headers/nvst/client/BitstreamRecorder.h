@@ -0,0 +1,583 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file BitstreamRecorder.h
+/// Indexed recording of received decode units, cheap enough to leave enabled.
+///
+/// Unlike NVST_CLIENT_DIAGNOSTIC_CLIENT_BITSTREAM_CAPTURE, which has to be set
+/// before connecting and dumps the raw elementary stream, recording can start
+/// and stop at any time and keeps the metadata of every VDU.
+///
+/// File layout, all fields little endian:
+/// - NvstBitstreamFileHeader
+/// - one NvstBitstreamRecord per VDU, followed by its payload padded to 8 bytes
+/// - the footer: one NvstBitstreamIndexEntry per record, then NvstBitstreamFileTrailer
+///
+/// Records are self-describing, so a file whose footer is missing because the
+/// process died can still be read; NvstBitstreamReader rebuilds the index then.
+/// \warning Memory mapping is only implemented for POSIX platforms.
+
+#pragma once
+
+#include "../common/Result.h"
+#include "../common/VideoDecodeUnit.h"
+#include "../common/VideoFormat.h"
+
+#include <nvsc/TimeUtils.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// Identifies a recording; also the last 8 bytes of a complete file.
+#define NVST_BITSTREAM_FILE_MAGIC "NVSTBSR1"
+/// Value of NvstBitstreamRecord::tag.
+#define NVST_BITSTREAM_RECORD_TAG 0x5253564Eu
+
+/// First bytes of a recording.
+/// \ingroup VideoData
+typedef struct NvstBitstreamFileHeader_t
+{
+    /// NVST_BITSTREAM_FILE_MAGIC, without the terminating zero.
+    char magic[8];
+    /// Layout version, currently 1.
+    uint32_t version;
+    /// NvstVideoFormat of every stream in the file.
+    uint32_t videoFormat;
+    /// Time the recording started at, in nanoseconds on the monotonic nvstGetTimeNs() clock,
+    /// the clock of NvstBitstreamRecord::arrivalTimeUs.
+    int64_t startTimeNs;
+    /// Wall clock time the recording started at, in nanoseconds since the Unix epoch.
+    int64_t wallClockStartTimeNs;
+} NvstBitstreamFileHeader;
+
+/// Metadata stored in front of every recorded VDU.
+/// \ingroup VideoData
+typedef struct NvstBitstreamRecord_t
+{
+    /// NVST_BITSTREAM_RECORD_TAG.
+    uint32_t tag;
+    /// Payload size; the payload follows this header and is padded to 8 bytes.
+    uint32_t sizeBytes;
+    /// NvstVideoDecodeUnit::timeStampUs.
+    uint64_t timeStampUs;
+    /// Time the VDU was recorded, in microseconds on the nvstGetTimeNs() clock.
+    uint64_t arrivalTimeUs;
+    /// NvstVideoDecodeUnit::frameNumber.
+    uint32_t frameNumber;
+    /// NvstVideoDecodeUnit::streamIndex.
+    uint16_t streamIndex;
+    /// NvstVideoDecodeUnit::frameType (NvstVideoFrameType).
+    uint8_t frameType;
+    /// NvstVideoDecodeUnit::vduType (NvstVideoDecodeUnitType).
+    uint8_t vduType;
+    /// NvstVideoDecodeUnit::sliceIndex.
+    uint16_t sliceIndex;
+    /// NvstVideoDecodeUnit::slicesInFrame.
+    uint16_t slicesInFrame;
+    uint32_t reserved;
+} NvstBitstreamRecord;
+
+/// Footer entry locating one record.
+/// \ingroup VideoData
+typedef struct NvstBitstreamIndexEntry_t
+{
+    /// Offset of the NvstBitstreamRecord in the file; the payload starts sizeof(NvstBitstreamRecord) later.
+    uint64_t offset;
+    /// Copy of the record's metadata.
+    NvstBitstreamRecord record;
+} NvstBitstreamIndexEntry;
+
+/// Last bytes of a complete recording.
+/// \ingroup VideoData
+typedef struct NvstBitstreamFileTrailer_t
+{
+    /// Offset of the first NvstBitstreamIndexEntry.
+    uint64_t indexOffset;
+    /// Number of index entries.
+    uint64_t recordCount;
+    /// NVST_BITSTREAM_FILE_MAGIC, without the terminating zero.
+    char magic[8];
+} NvstBitstreamFileTrailer;
+
+static_assert(sizeof(NvstBitstreamFileHeader) == 32, "recording layout changed");
+static_assert(sizeof(NvstBitstreamRecord) == 40, "recording layout changed");
+static_assert(sizeof(NvstBitstreamIndexEntry) == 48, "recording layout changed");
+static_assert(sizeof(NvstBitstreamFileTrailer) == 24, "recording layout changed");
+
+/// Configuration of NvstBitstreamRecorder.
+/// \ingroup VideoData
+typedef struct NvstBitstreamRecorderConfig_t
+{
+    /// The file is extended and remapped in steps of this many bytes.
+    uint64_t growBytes;
+    /// Records that would take the file beyond this size are dropped. 0 means unlimited.
+    uint64_t maxBytes;
+} NvstBitstreamRecorderConfig;
+
+/// Default configuration: 64 MB steps, 4 GB limit.
+static inline void nvstBitstreamRecorderGetDefaultConfig(NvstBitstreamRecorderConfig* config)
+{
+    config->growBytes = 64ull << 20;
+    config->maxBytes = 4ull << 30;
+}
+
+/// Counters of an NvstBitstreamRecorder.
+/// \ingroup VideoData
+typedef struct NvstBitstreamRecorderStats_t
+{
+    /// VDUs written.
+    uint64_t records;
+    /// Bytes written, headers and padding included.
+    uint64_t bytes;
+    /// VDUs not recorded because maxBytes was reached or the file couldn't be extended.
+    uint64_t droppedRecords;
+    /// Times the file was extended and remapped.
+    uint64_t remaps;
+} NvstBitstreamRecorderStats;
+
+/// Append-only writer of indexed VDU recordings.
+///
+/// record() copies the VDU into a shared file mapping, so its cost is one
+/// memcpy of the payload plus the page faults of fresh pages; there are no
+/// system calls except when the file grows, and no heap allocations. The
+/// index is not kept in memory: close() rebuilds it by walking the record
+/// headers in the mapping and appends it as the footer.
+/// Thread safe; one recorder can be shared by every video stream.
+/// \ingroup VideoData
+class NvstBitstreamRecorder
+{
+public:
+    NvstBitstreamRecorder()
+    {
+        nvstBitstreamRecorderGetDefaultConfig(&m_config);
+    }
+
+    explicit NvstBitstreamRecorder(const NvstBitstreamRecorderConfig& config)
+        : m_config(config)
+    {
+        if (m_config.growBytes < (1u << 20))
+        {
+            m_config.growBytes = 1u << 20;
+        }
+    }
+
+    /// Writes the footer.
+    ~NvstBitstreamRecorder() { close(); }
+
+    NvstBitstreamRecorder(const NvstBitstreamRecorder&) = delete;
+    NvstBitstreamRecorder& operator=(const NvstBitstreamRecorder&) = delete;
+
+    /// Create (or truncate) the file and start recording.
+    /// \param[in] path Path of the recording.
+    /// \param[in] format Codec of the recorded streams.
+    /// \retval NVST_R_INVALID_PARAM if path is NULL
+    /// \retval NVST_R_NOT_FOUND if the file can't be created
+    /// \retval NVST_R_NO_IMPLEMENTATION on platforms without mmap support
+    /// \retval NVST_R_GENERIC_ERROR if the file couldn't be sized or mapped
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult open(const char* path, NvstVideoFormat format)
+    {
+        close();
+        if (!path)
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+#ifdef _WIN32
+        (void)format;
+        return NVST_R_NO_IMPLEMENTATION;
+#else
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (m_fd < 0)
+        {
+            return NVST_R_NOT_FOUND;
+        }
+        if (!reserve(sizeof(NvstBitstreamFileHeader)))
+        {
+            closeFile(0);
+            return NVST_R_GENERIC_ERROR;
+        }
+        NvstBitstreamFileHeader header = {};
+        std::memcpy(header.magic, NVST_BITSTREAM_FILE_MAGIC, sizeof(header.magic));
+        header.version = 1;
+        header.videoFormat = static_cast<uint32_t>(format);
+        header.startTimeNs = nvstGetTimeNs();
+        header.wallClockStartTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::memcpy(m_mapping, &header, sizeof(header));
+        m_size = sizeof(header);
+        m_stats = NvstBitstreamRecorderStats();
+        return NVST_R_SUCCESS;
+#endif
+    }
+
+    /// Append a VDU. Doesn't take ownership; call before handing the VDU on or releasing it.
+    /// \retval NVST_R_INVALID_PARAM if vdu is NULL
+    /// \retval NVST_R_INVALID_STATE if no recording is open
+    /// \retval NVST_R_FRAME_DROPPED if maxBytes was reached or the file couldn't be extended
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult record(const NvstVideoDecodeUnit* vdu)
+    {
+        if (!vdu)
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+        NvstBitstreamRecord record;
+        record.tag = NVST_BITSTREAM_RECORD_TAG;
+        record.sizeBytes = vdu->streamBuffer ? vdu->streamSizeBytes : 0;
+        record.timeStampUs = vdu->timeStampUs;
+        record.arrivalTimeUs = static_cast<uint64_t>(nvstGetTimeNs() / 1000);
+        record.frameNumber = vdu->frameNumber;
+        record.streamIndex = vdu->streamIndex;
+        record.frameType = static_cast<uint8_t>(vdu->frameType);
+        record.vduType = static_cast<uint8_t>(vdu->vduType);
+        record.sliceIndex = static_cast<uint16_t>(vdu->sliceIndex);
+        record.slicesInFrame = static_cast<uint16_t>(vdu->slicesInFrame);
+        record.reserved = 0;
+        const uint64_t recordBytes = sizeof(record) + padded(record.sizeBytes);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_mapping)
+        {
+            return NVST_R_INVALID_STATE;
+        }
+        if ((m_config.maxBytes && m_size + recordBytes > m_config.maxBytes) || !reserve(m_size + recordBytes))
+        {
+            ++m_stats.droppedRecords;
+            return NVST_R_FRAME_DROPPED;
+        }
+        uint8_t* out = m_mapping + m_size;
+        if (record.sizeBytes)
+        {
+            std::memcpy(out + sizeof(record), vdu->streamBuffer, record.sizeBytes);
+        }
+        std::memset(out + sizeof(record) + record.sizeBytes, 0, padded(record.sizeBytes) - record.sizeBytes);
+        // The header goes last, so a record is only visible to recovery once complete.
+        std::memcpy(out, &record, sizeof(record));
+        m_size += recordBytes;
+        ++m_stats.records;
+        m_stats.bytes += recordBytes;
+        return NVST_R_SUCCESS;
+    }
+
+    /// Write the footer index, trim the file to its final size and close it.
+    /// \retval NVST_R_GENERIC_ERROR if the footer couldn't be written; the records are still recoverable
+    /// \retval NVST_R_SUCCESS otherwise, or if no recording was open
+    NvstResult close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_mapping)
+        {
+            return NVST_R_SUCCESS;
+        }
+        const uint64_t recordsEnd = m_size;
+        const uint64_t footerBytes =
+            m_stats.records * sizeof(NvstBitstreamIndexEntry) + sizeof(NvstBitstreamFileTrailer);
+        if (!reserve(recordsEnd + footerBytes))
+        {
+            closeFile(recordsEnd);
+            return NVST_R_GENERIC_ERROR;
+        }
+        uint64_t indexEntry = recordsEnd;
+        for (uint64_t offset = sizeof(NvstBitstreamFileHeader); offset < recordsEnd;)
+        {
+            NvstBitstreamIndexEntry entry;
+            entry.offset = offset;
+            std::memcpy(&entry.record, m_mapping + offset, sizeof(entry.record));
+            std::memcpy(m_mapping + indexEntry, &entry, sizeof(entry));
+            indexEntry += sizeof(entry);
+            offset += sizeof(entry.record) + padded(entry.record.sizeBytes);
+        }
+        NvstBitstreamFileTrailer trailer;
+        trailer.indexOffset = recordsEnd;
+        trailer.recordCount = m_stats.records;
+        std::memcpy(trailer.magic, NVST_BITSTREAM_FILE_MAGIC, sizeof(trailer.magic));
+        std::memcpy(m_mapping + indexEntry, &trailer, sizeof(trailer));
+        closeFile(indexEntry + sizeof(trailer));
+        return NVST_R_SUCCESS;
+    }
+
+    /// \return true while a recording is open.
+    bool isOpen() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_mapping != nullptr;
+    }
+
+    NvstBitstreamRecorderStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    /// \return Payload size rounded up to the 8 byte record alignment.
+    static uint64_t padded(uint64_t sizeBytes) { return (sizeBytes + 7) & ~7ull; }
+
+private:
+    /// Make sure the mapping covers at least \p bytes, extending the file if necessary.
+    bool reserve(uint64_t bytes)
+    {
+#ifdef _WIN32
+        (void)bytes;
+        return false;
+#else
+        if (bytes <= m_capacity)
+        {
+            return true;
+        }
+        const uint64_t capacity = (bytes + m_config.growBytes - 1) / m_config.growBytes * m_config.growBytes;
+#if defined(__linux__)
+        // Allocate the blocks up front: writing to a sparse mapping on a full disk raises SIGBUS.
+        if (posix_fallocate(m_fd, static_cast<off_t>(m_capacity), static_cast<off_t>(capacity - m_capacity)) != 0)
+        {
+            return false;
+        }
+#else
+        if (ftruncate(m_fd, static_cast<off_t>(capacity)) != 0)
+        {
+            return false;
+        }
+#endif
+        void* mapping = mmap(nullptr, static_cast<size_t>(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return false;
+        }
+        if (m_mapping)
+        {
+            munmap(m_mapping, static_cast<size_t>(m_capacity));
+            ++m_stats.remaps;
+        }
+        m_mapping = static_cast<uint8_t*>(mapping);
+        m_capacity = capacity;
+        return true;
+#endif
+    }
+
+    void closeFile(uint64_t finalSize)
+    {
+#ifdef _WIN32
+        (void)finalSize;
+#else
+        if (m_mapping)
+        {
+            munmap(m_mapping, static_cast<size_t>(m_capacity));
+        }
+        if (m_fd >= 0)
+        {
+            // On failure the file keeps its zeroed preallocated tail, which readers treat as the end of the records.
+            if (ftruncate(m_fd, static_cast<off_t>(finalSize)) != 0)
+            {
+                finalSize = 0;
+            }
+            ::close(m_fd);
+        }
+#endif
+        m_mapping = nullptr;
+        m_capacity = 0;
+        m_size = 0;
+        m_fd = -1;
+    }
+
+    NvstBitstreamRecorderConfig m_config;
+    mutable std::mutex m_mutex;
+    int m_fd = -1;
+    uint8_t* m_mapping = nullptr;
+    uint64_t m_capacity = 0;
+    uint64_t m_size = 0;
+    NvstBitstreamRecorderStats m_stats = {};
+};
+
+/// Read-only, memory-mapped view of a recording made by NvstBitstreamRecorder.
+/// \ingroup VideoData
+class NvstBitstreamReader
+{
+public:
+    NvstBitstreamReader() = default;
+    ~NvstBitstreamReader() { close(); }
+
+    NvstBitstreamReader(const NvstBitstreamReader&) = delete;
+    NvstBitstreamReader& operator=(const NvstBitstreamReader&) = delete;
+
+    /// Map a recording. The footer index is used in place; if it is missing, or any entry points
+    /// outside the records, the records are walked from the start until the first incomplete one.
+    /// \retval NVST_R_INVALID_PARAM if path is NULL
+    /// \retval NVST_R_NOT_FOUND if the file can't be opened
+    /// \retval NVST_R_INVALID_VALUE if the file isn't a recording
+    /// \retval NVST_R_NO_IMPLEMENTATION on platforms without mmap support
+    /// \retval NVST_R_GENERIC_ERROR if mapping failed
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult open(const char* path)
+    {
+        close();
+        if (!path)
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+#ifdef _WIN32
+        return NVST_R_NO_IMPLEMENTATION;
+#else
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return NVST_R_NOT_FOUND;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || static_cast<uint64_t>(info.st_size) < sizeof(NvstBitstreamFileHeader))
+        {
+            ::close(fd);
+            return NVST_R_INVALID_VALUE;
+        }
+        void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            return NVST_R_GENERIC_ERROR;
+        }
+        m_data = static_cast<const uint8_t*>(mapping);
+        m_size = static_cast<uint64_t>(info.st_size);
+
+        std::memcpy(&m_header, m_data, sizeof(m_header));
+        if (std::memcmp(m_header.magic, NVST_BITSTREAM_FILE_MAGIC, sizeof(m_header.magic)) != 0 ||
+            m_header.version != 1)
+        {
+            close();
+            return NVST_R_INVALID_VALUE;
+        }
+        if (!useFooter())
+        {
+            recoverIndex();
+        }
+        return NVST_R_SUCCESS;
+#endif
+    }
+
+    void close()
+    {
+#ifndef _WIN32
+        if (m_data)
+        {
+            munmap(const_cast<uint8_t*>(m_data), static_cast<size_t>(m_size));
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_index = nullptr;
+        m_recordCount = 0;
+        m_recovered.clear();
+    }
+
+    /// \return Codec of the recording.
+    NvstVideoFormat format() const { return static_cast<NvstVideoFormat>(m_header.videoFormat); }
+
+    /// \return true if the footer was missing and the index had to be rebuilt.
+    bool isRecovered() const { return !m_recovered.empty(); }
+
+    /// \return Number of records.
+    uint64_t recordCount() const { return m_recordCount; }
+
+    /// \return Index entry of a record. Entries are in recording order.
+    const NvstBitstreamIndexEntry& entry(uint64_t index) const { return m_index[index]; }
+
+    /// \return Payload of a record; valid until close().
+    const uint8_t* payload(uint64_t index) const { return m_data + m_index[index].offset + sizeof(NvstBitstreamRecord); }
+
+    /// Describe a record as a decode unit pointing into the mapping.
+    /// releaseProc is left NULL; the payload stays valid until close().
+    void fillVideoDecodeUnit(uint64_t index, NvstVideoDecodeUnit* vdu) const
+    {
+        const NvstBitstreamRecord& record = m_index[index].record;
+        *vdu = NvstVideoDecodeUnit();
+        vdu->timeStampUs = record.timeStampUs;
+        vdu->frameNumber = record.frameNumber;
+        vdu->frameType = static_cast<NvstVideoFrameType>(record.frameType);
+        vdu->vduType = static_cast<NvstVideoDecodeUnitType>(record.vduType);
+        vdu->sliceIndex = record.sliceIndex;
+        vdu->slicesInFrame = record.slicesInFrame;
+        vdu->streamBuffer = const_cast<uint8_t*>(payload(index));
+        vdu->streamSizeBytes = record.sizeBytes;
+        vdu->streamIndex = record.streamIndex;
+    }
+
+private:
+    bool useFooter()
+    {
+        NvstBitstreamFileTrailer trailer;
+        if (m_size < sizeof(m_header) + sizeof(trailer))
+        {
+            return false;
+        }
+        std::memcpy(&trailer, m_data + m_size - sizeof(trailer), sizeof(trailer));
+        const uint64_t footerEnd = m_size - sizeof(trailer);
+        if (std::memcmp(trailer.magic, NVST_BITSTREAM_FILE_MAGIC, sizeof(trailer.magic)) != 0 ||
+            trailer.indexOffset > footerEnd || trailer.indexOffset % 8 != 0 ||
+            (footerEnd - trailer.indexOffset) / sizeof(NvstBitstreamIndexEntry) != trailer.recordCount)
+        {
+            return false;
+        }
+        const NvstBitstreamIndexEntry* index =
+            reinterpret_cast<const NvstBitstreamIndexEntry*>(m_data + trailer.indexOffset);
+        for (uint64_t i = 0; i < trailer.recordCount; ++i)
+        {
+            // Every record must lie between the file header and the index; otherwise fall back to the scan.
+            const NvstBitstreamIndexEntry& entry = index[i];
+            if (entry.offset < sizeof(m_header) || entry.offset > trailer.indexOffset ||
+                trailer.indexOffset - entry.offset < sizeof(NvstBitstreamRecord) ||
+                trailer.indexOffset - entry.offset - sizeof(NvstBitstreamRecord) <
+                    NvstBitstreamRecorder::padded(entry.record.sizeBytes))
+            {
+                return false;
+            }
+        }
+        m_index = index;
+        m_recordCount = trailer.recordCount;
+        return true;
+    }
+
+    void recoverIndex()
+    {
+        uint64_t offset = sizeof(NvstBitstreamFileHeader);
+        while (offset + sizeof(NvstBitstreamRecord) <= m_size)
+        {
+            NvstBitstreamIndexEntry entry;
+            entry.offset = offset;
+            std::memcpy(&entry.record, m_data + offset, sizeof(entry.record));
+            const uint64_t end =
+                offset + sizeof(entry.record) + NvstBitstreamRecorder::padded(entry.record.sizeBytes);
+            if (entry.record.tag != NVST_BITSTREAM_RECORD_TAG || end > m_size)
+            {
+                break;
+            }
+            m_recovered.push_back(entry);
+            offset = end;
+        }
+        m_index = m_recovered.data();
+        m_recordCount = m_recovered.size();
+    }
+
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+    NvstBitstreamFileHeader m_header = {};
+    const NvstBitstreamIndexEntry* m_index = nullptr;
+    uint64_t m_recordCount = 0;
+    std::vector<NvstBitstreamIndexEntry> m_recovered;
+};
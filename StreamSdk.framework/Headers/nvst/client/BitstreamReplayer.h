@@ -0,0 +1,351 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file BitstreamReplayer.h
+/// Replay of recorded decode units into the client decode path, without a server.
+///
+/// NvstBitstreamReplayer feeds the VDUs of an NvstBitstreamReader to a
+/// DECODE_VU_PROC or an onVideoReceived callback, exactly as the SDK would:
+/// the callback owns each VDU until it calls releaseProc. Delivery follows
+/// the recorded arrival times, optionally sped up or slowed down, or runs as
+/// fast as the decoder releases units. Loss and jitter are drawn from a
+/// seeded generator, so two runs with the same configuration deliver the same
+/// units at the same offsets, which makes decoder and renderer throughput
+/// numbers comparable across CI machines.
+
+#pragma once
+
+#include "BitstreamRecorder.h"
+#include "VideoDecoder.h"
+#include "../common/Histogram.h"
+#include "../common/StreamConfig.h"
+
+#include <nvsc/TimeUtils.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/// How delivery is paced.
+/// \ingroup Video
+typedef enum NvstReplayCadence_t
+{
+    /// Recorded arrival times.
+    NVST_REPLAY_ORIGINAL = 0,
+    /// Recorded arrival times divided by NvstBitstreamReplayConfig::speed.
+    NVST_REPLAY_SCALED = 1,
+    /// No pacing; the next unit is delivered as soon as the previous callback returns.
+    NVST_REPLAY_AS_FAST_AS_POSSIBLE = 2,
+} NvstReplayCadence;
+
+/// Configuration of NvstBitstreamReplayer.
+/// \ingroup Video
+typedef struct NvstBitstreamReplayConfig_t
+{
+    /// Pacing of the deliveries.
+    NvstReplayCadence cadence;
+    /// Playback speed for NVST_REPLAY_SCALED; 2.0 replays twice as fast.
+    double speed;
+    /// Number of times the recording is replayed. Frame numbers and timestamps keep increasing across loops.
+    uint32_t loops;
+    /// Only records of this stream are replayed; -1 replays every stream.
+    int32_t streamIndex;
+    /// Probability (0..1) that a delivered unit starts a loss burst.
+    double lossRate;
+    /// Mean number of consecutive units lost per burst (Gilbert-Elliott model); at least 1.
+    double meanBurstLength;
+    /// Each delivery is delayed by a uniformly distributed 0..jitterUs. Delivery order is preserved.
+    /// Ignored for NVST_REPLAY_AS_FAST_AS_POSSIBLE.
+    uint32_t jitterUs;
+    /// Seed of the loss and jitter generator.
+    uint64_t seed;
+    /// run() waits up to this long after the last delivery for every unit to be released.
+    /// Units still held then are reported in NvstBitstreamReplayStats::outstanding.
+    uint32_t drainTimeoutMs;
+} NvstBitstreamReplayConfig;
+
+/// Default configuration: original cadence, one loop, all streams, no impairments.
+static inline void nvstBitstreamReplayGetDefaultConfig(NvstBitstreamReplayConfig* config)
+{
+    config->cadence = NVST_REPLAY_ORIGINAL;
+    config->speed = 1.0;
+    config->loops = 1;
+    config->streamIndex = -1;
+    config->lossRate = 0.0;
+    config->meanBurstLength = 1.0;
+    config->jitterUs = 0;
+    config->seed = 1;
+    config->drainTimeoutMs = 5000;
+}
+
+/// Result of NvstBitstreamReplayer::run().
+/// \ingroup Video
+typedef struct NvstBitstreamReplayStats_t
+{
+    /// Units handed to the callback.
+    uint64_t delivered;
+    /// Units dropped by the loss model.
+    uint64_t lost;
+    /// Payload bytes delivered.
+    uint64_t bytes;
+    /// Units whose releaseProc was called.
+    uint64_t released;
+    /// Times delivery had to wait for the callback to release a unit of the previous loop.
+    uint64_t backpressureWaits;
+    /// Units still not released when run() returned because drainTimeoutMs expired.
+    uint64_t outstanding;
+    /// Time from the first delivery until the last release (or the drain timeout).
+    uint64_t elapsedUs;
+} NvstBitstreamReplayStats;
+
+/// Replays a recording into a decoder callback on the calling thread.
+/// \ingroup Video
+class NvstBitstreamReplayer
+{
+public:
+    /// \param[in] reader Opened recording. Must outlive the replayer, and every unit must be released before close().
+    /// \param[in] config Replay configuration.
+    NvstBitstreamReplayer(const NvstBitstreamReader& reader, const NvstBitstreamReplayConfig& config)
+        : m_reader(reader)
+        , m_config(config)
+        , m_slots(new Slot[reader.recordCount() ? reader.recordCount() : 1])
+    {
+        if (m_config.cadence == NVST_REPLAY_ORIGINAL || m_config.speed <= 0.0)
+        {
+            m_config.speed = 1.0;
+        }
+        if (m_config.meanBurstLength < 1.0)
+        {
+            m_config.meanBurstLength = 1.0;
+        }
+        for (uint64_t i = 0; i < m_reader.recordCount(); ++i)
+        {
+            const NvstBitstreamRecord& record = m_reader.entry(i).record;
+            m_maxFrameNumber = record.frameNumber > m_maxFrameNumber ? record.frameNumber : m_maxFrameNumber;
+        }
+        const uint64_t count = m_reader.recordCount();
+        if (count > 1)
+        {
+            const uint64_t first = m_reader.entry(0).record.arrivalTimeUs;
+            const uint64_t last = m_reader.entry(count - 1).record.arrivalTimeUs;
+            // One loop lasts the recording plus one average inter-arrival gap.
+            m_loopDurationUs = (last - first) + (last - first) / (count - 1);
+        }
+    }
+
+    /// Waits until every delivered unit has been released, since their releaseProc points into the replayer.
+    /// Blocks indefinitely if the decoder never releases a unit.
+    ~NvstBitstreamReplayer() { waitForReleases(INT64_MAX); }
+
+    NvstBitstreamReplayer(const NvstBitstreamReplayer&) = delete;
+    NvstBitstreamReplayer& operator=(const NvstBitstreamReplayer&) = delete;
+
+    /// Replay into a DECODE_VU_PROC, e.g. the one of NvstVideoDecoderStreamConfig.
+    /// Units left outstanding by a previous run() are waited for first.
+    NvstBitstreamReplayStats run(DECODE_VU_PROC decodeProc, void* userData)
+    {
+        return replay([=](const NvstVideoDecodeUnit* vdu) { decodeProc(userData, vdu); });
+    }
+
+    /// Replay into an NvstVideoReceiverStreamConfig::onVideoReceived callback.
+    NvstBitstreamReplayStats run(ON_VIDEO_RECEIVED_PROC onVideoReceived, void* context, NvstStreamConnection connection)
+    {
+        return replay([=](const NvstVideoDecodeUnit* vdu) { onVideoReceived(context, connection, vdu); });
+    }
+
+    /// Make a running run() return after the current delivery. May be called from any thread.
+    void stop() { m_stopped.store(true, std::memory_order_relaxed); }
+
+    /// Time from delivery to release of every unit of the last run(), in microseconds; i.e. how long the
+    /// decoder held it.
+    const NvstHistogram& holdTimeHistogram() const { return m_holdTimeUs; }
+
+    /// How late each delivery of the last run() was relative to its paced schedule, in microseconds.
+    const NvstHistogram& latenessHistogram() const { return m_latenessUs; }
+
+private:
+    struct Slot
+    {
+        NvstVideoDecodeUnit vdu;
+        NvstBitstreamReplayer* owner;
+        int64_t deliveredNs;
+        std::atomic<bool> busy{false};
+    };
+
+    static void releaseUnit(const NvstVideoDecodeUnit* vdu)
+    {
+        Slot* slot = static_cast<Slot*>(vdu->decodeUnitCtx);
+        NvstBitstreamReplayer* owner = slot->owner;
+        owner->m_holdTimeUs.record(static_cast<uint64_t>(nvstGetTimeNs() - slot->deliveredNs) / 1000);
+        owner->m_released.fetch_add(1, std::memory_order_relaxed);
+        slot->busy.store(false, std::memory_order_release);
+        // Last access to the replayer; once this reaches zero it may be destroyed.
+        owner->m_outstanding.fetch_sub(1, std::memory_order_release);
+    }
+
+    /// \return true if every delivered unit was released before deadlineNs.
+    bool waitForReleases(int64_t deadlineNs) const
+    {
+        while (m_outstanding.load(std::memory_order_acquire) != 0)
+        {
+            if (nvstGetTimeNs() >= deadlineNs)
+            {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+        return true;
+    }
+
+    /// splitmix64; the standard distributions differ between library implementations.
+    uint64_t nextRandom()
+    {
+        uint64_t z = (m_random += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    /// \return Uniform value in [0, 1).
+    double nextUnit() { return static_cast<double>(nextRandom() >> 11) * (1.0 / 9007199254740992.0); }
+
+    /// Gilbert-Elliott loss model.
+    bool lose()
+    {
+        if (m_inBurst)
+        {
+            m_inBurst = nextUnit() >= 1.0 / m_config.meanBurstLength;
+        }
+        else
+        {
+            m_inBurst = m_config.lossRate > 0.0 && nextUnit() < m_config.lossRate;
+        }
+        return m_inBurst;
+    }
+
+    template <typename Deliver>
+    NvstBitstreamReplayStats replay(Deliver deliver)
+    {
+        NvstBitstreamReplayStats stats = {};
+        waitForReleases(INT64_MAX);
+        m_stopped.store(false, std::memory_order_relaxed);
+        m_released.store(0, std::memory_order_relaxed);
+        m_holdTimeUs.reset();
+        m_latenessUs.reset();
+        m_random = m_config.seed;
+        m_inBurst = false;
+
+        const uint64_t count = m_reader.recordCount();
+        if (count == 0)
+        {
+            return stats;
+        }
+        const bool paced = m_config.cadence != NVST_REPLAY_AS_FAST_AS_POSSIBLE;
+        const uint64_t firstArrivalUs = m_reader.entry(0).record.arrivalTimeUs;
+        const int64_t startNs = nvstGetTimeNs();
+        int64_t previousDueNs = startNs;
+
+        for (uint32_t loop = 0; loop < m_config.loops && !m_stopped.load(std::memory_order_relaxed); ++loop)
+        {
+            for (uint64_t i = 0; i < count && !m_stopped.load(std::memory_order_relaxed); ++i)
+            {
+                const NvstBitstreamRecord& record = m_reader.entry(i).record;
+                if (m_config.streamIndex >= 0 && record.streamIndex != m_config.streamIndex)
+                {
+                    continue;
+                }
+                const uint64_t recordedUs = loop * m_loopDurationUs + (record.arrivalTimeUs - firstArrivalUs);
+                const bool lost = lose();
+                if (paced)
+                {
+                    const uint32_t jitterUs =
+                        m_config.jitterUs ? static_cast<uint32_t>(nextRandom() % (m_config.jitterUs + 1ull)) : 0;
+                    int64_t dueNs = startNs + static_cast<int64_t>(recordedUs * 1000.0 / m_config.speed) +
+                        static_cast<int64_t>(jitterUs) * 1000;
+                    dueNs = dueNs < previousDueNs ? previousDueNs : dueNs;
+                    previousDueNs = dueNs;
+                    if (lost)
+                    {
+                        ++stats.lost;
+                        continue;
+                    }
+                    waitUntil(dueNs);
+                    const int64_t nowNs = nvstGetTimeNs();
+                    m_latenessUs.record(nowNs > dueNs ? static_cast<uint64_t>(nowNs - dueNs) / 1000 : 0);
+                }
+                else if (lost)
+                {
+                    ++stats.lost;
+                    continue;
+                }
+
+                Slot& slot = m_slots[i];
+                if (slot.busy.load(std::memory_order_acquire))
+                {
+                    ++stats.backpressureWaits;
+                    while (slot.busy.load(std::memory_order_acquire))
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                m_reader.fillVideoDecodeUnit(i, &slot.vdu);
+                slot.vdu.frameNumber += loop * (m_maxFrameNumber + 1);
+                slot.vdu.timeStampUs += loop * m_loopDurationUs;
+                slot.vdu.decodeUnitCtx = &slot;
+                slot.vdu.releaseProc = releaseUnit;
+                slot.owner = this;
+                slot.deliveredNs = nvstGetTimeNs();
+                slot.busy.store(true, std::memory_order_relaxed);
+                m_outstanding.fetch_add(1, std::memory_order_relaxed);
+                ++stats.delivered;
+                stats.bytes += record.sizeBytes;
+                deliver(&slot.vdu);
+            }
+        }
+
+        waitForReleases(nvstGetTimeNs() + static_cast<int64_t>(m_config.drainTimeoutMs) * 1000000);
+        stats.released = m_released.load(std::memory_order_acquire);
+        stats.outstanding = m_outstanding.load(std::memory_order_acquire);
+        stats.elapsedUs = static_cast<uint64_t>(nvstGetTimeNs() - startNs) / 1000;
+        return stats;
+    }
+
+    /// Sleep until shortly before the deadline, then spin, so deliveries stay within a few microseconds.
+    static void waitUntil(int64_t deadlineNs)
+    {
+        const int64_t spinNs = 200000;
+        const int64_t remainingNs = deadlineNs - nvstGetTimeNs();
+        if (remainingNs > spinNs)
+        {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(remainingNs - spinNs));
+        }
+        while (nvstGetTimeNs() < deadlineNs)
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    const NvstBitstreamReader& m_reader;
+    NvstBitstreamReplayConfig m_config;
+    std::unique_ptr<Slot[]> m_slots;
+    uint32_t m_maxFrameNumber = 0;
+    uint64_t m_loopDurationUs = 0;
+    uint64_t m_random = 0;
+    bool m_inBurst = false;
+    std::atomic<bool> m_stopped{false};
+    std::atomic<uint64_t> m_released{0};
+    std::atomic<uint64_t> m_outstanding{0};
+    NvstHistogram m_holdTimeUs;
+    NvstHistogram m_latenessUs;
+};
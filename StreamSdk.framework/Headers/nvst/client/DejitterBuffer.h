@@ -0,0 +1,370 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file DejitterBuffer.h
+/// Reference adaptive dejitter buffer (ADJB) engine.
+///
+/// NvstAdjbEngine sizes the video dejitter buffer from the arrival jitter of
+/// frames and takes part in the NvstClientDJBConfig handshake with QoS: it
+/// answers NVST_CE_ADJB_CONFIG_CHANGE_EVENT requests and announces mode changes
+/// through NVST_RUNTIME_PARAM_ADJB_CONFIG.
+///
+/// Jitter is the transit time of a frame (arrival minus server timestamp) above
+/// the smallest transit seen. Its adjbQuantile is tracked with a stochastic
+/// approximation whose step is adjbQuantileConvergenceFactor times the spread of
+/// the samples, so the estimate needs no history and converges at a rate that
+/// doesn't depend on the absolute jitter.
+///
+/// The engine keeps no clock of its own: arrivals carry their time, so it can be
+/// fed recorded traces, e.g. the timeStampUs and arrivalTimeUs of the records of
+/// an NvstBitstreamReader.
+
+#pragma once
+
+#include "StreamClient.h"
+#include "../common/Histogram.h"
+
+#include <nvsc/DefineDefaultConfigs_auto.h>
+
+#include <cstdint>
+#include <mutex>
+
+/// Configuration of NvstAdjbEngine.
+/// \ingroup Video
+typedef struct NvstAdjbEngineConfig_t
+{
+    /// NVST_DJB_MODE_VVSYNC, NVST_DJB_MODE_TIMESTAMP or NVST_DJB_MODE_FIXED.
+    NvstClientDJBMode mode;
+    /// Tracked jitter quantile in per mille (NvscVideoSettings::adjbQuantile).
+    uint32_t quantile;
+    /// Step of the quantile estimate in per mille of the jitter spread
+    /// (NvscVideoSettings::adjbQuantileConvergenceFactor).
+    uint32_t convergenceFactor;
+    /// Depth limits of this renderer in the adaptive modes
+    /// (NvscVideoSettings::adjbMinLengthMs and adjbMaxLengthMs).
+    uint32_t minDepthUs;
+    uint32_t maxDepthUs;
+    /// Largest depth the implementation supports; only reachable when QoS sets force.
+    uint32_t hardMaxDepthUs;
+    /// Depth used in NVST_DJB_MODE_FIXED (NvscVideoSettings::dejitterBufferLengthMs),
+    /// bounded only by hardMaxDepthUs.
+    uint32_t fixedDepthUs;
+    /// Display refresh interval; NVST_DJB_MODE_VVSYNC rounds the depth up to whole intervals.
+    uint32_t vsyncIntervalUs;
+    /// The smallest transit is allowed to rise by this much per frame to follow clock drift.
+    uint32_t baselineRelaxUsPerFrame;
+    /// Client acknowledgements and mode changes are sent to; NULL disables sending.
+    NvstClient client;
+    /// Function used to send them. Defaults to nvstSetRuntimeParam; NULL disables sending.
+    SET_RUNTIME_PARAM setRuntimeParamProc;
+} NvstAdjbEngineConfig;
+
+/// Default configuration: timestamp mode, the SDK's adaptive dejitter defaults
+/// (DEFAULT_ADAPTIVE_DEJITTER_* and DEFAULT_DEJITTER_BUFFER_LENGTH_MS), 200 ms forced limit, 60 Hz.
+static inline void nvstAdjbEngineGetDefaultConfig(NvstAdjbEngineConfig* config)
+{
+    config->mode = NVST_DJB_MODE_TIMESTAMP;
+    config->quantile = DEFAULT_ADAPTIVE_DEJITTER_JITTER_HISTORY_QUANTILE;
+    config->convergenceFactor = DEFAULT_ADAPTIVE_DEJITTER_JITTER_HISTORY_QUANTILE_CONVERGENCE_FACTOR;
+    config->minDepthUs = DEFAULT_ADAPTIVE_DEJITTER_BUFFER_MIN_LENGTH_MS * 1000;
+    config->maxDepthUs = DEFAULT_ADAPTIVE_DEJITTER_BUFFER_MAX_LENGTH_MS * 1000;
+    config->hardMaxDepthUs = 200000;
+    config->fixedDepthUs = DEFAULT_DEJITTER_BUFFER_LENGTH_MS * 1000;
+    config->vsyncIntervalUs = 16667;
+    config->baselineRelaxUsPerFrame = 5;
+    config->client = NULL;
+    config->setRuntimeParamProc = nvstSetRuntimeParam;
+}
+
+/// One frame of an arrival trace.
+typedef struct NvstAdjbArrival_t
+{
+    /// Server timestamp of the frame.
+    uint64_t timestampUs;
+    /// Time the frame was complete on the client.
+    uint64_t arrivalUs;
+} NvstAdjbArrival;
+
+/// Counters of an NvstAdjbEngine.
+/// \ingroup Video
+typedef struct NvstAdjbEngineStats_t
+{
+    /// Frames seen.
+    uint64_t frames;
+    /// Frames whose jitter exceeded the depth in effect, i.e. that would have underrun the buffer.
+    uint64_t lateFrames;
+    /// QoS requests answered.
+    uint64_t configChanges;
+    /// Configurations sent through setRuntimeParamProc.
+    uint64_t configsSent;
+    /// Current jitter quantile estimate.
+    uint32_t jitterQuantileUs;
+    /// Current depth.
+    uint32_t depthUs;
+    /// Current limits after combining the local configuration and the QoS request.
+    uint32_t effectiveMinDepthUs;
+    uint32_t effectiveMaxDepthUs;
+} NvstAdjbEngineStats;
+
+/// Adaptive dejitter buffer sizing with the QoS configuration handshake.
+///
+/// onArrival() and the configuration calls may come from different threads.
+/// \ingroup Video
+class NvstAdjbEngine
+{
+public:
+    explicit NvstAdjbEngine(const NvstAdjbEngineConfig& config)
+        : m_config(config)
+    {
+        if (m_config.quantile >= 1000)
+        {
+            m_config.quantile = 999;
+        }
+        if (m_config.hardMaxDepthUs < m_config.maxDepthUs)
+        {
+            m_config.hardMaxDepthUs = m_config.maxDepthUs;
+        }
+        applyLimitsLocked();
+        updateDepthLocked();
+    }
+
+    NvstAdjbEngine(const NvstAdjbEngine&) = delete;
+    NvstAdjbEngine& operator=(const NvstAdjbEngine&) = delete;
+
+    /// Account for a frame and compute when it should leave the buffer.
+    /// \param[in] timestampUs Server timestamp of the frame.
+    /// \param[in] arrivalUs Time the frame was complete on the client.
+    /// \return Release time of the frame; arrivalUs or earlier means release immediately.
+    uint64_t onArrival(uint64_t timestampUs, uint64_t arrivalUs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const int64_t transitUs = static_cast<int64_t>(arrivalUs) - static_cast<int64_t>(timestampUs);
+        if (!m_stats.frames || transitUs < m_baselineUs)
+        {
+            m_baselineUs = transitUs;
+        }
+        else
+        {
+            m_baselineUs += m_config.baselineRelaxUsPerFrame;
+        }
+        ++m_stats.frames;
+        const double jitterUs = static_cast<double>(transitUs - m_baselineUs);
+        if (jitterUs > m_stats.depthUs)
+        {
+            ++m_stats.lateFrames;
+        }
+        trackQuantileLocked(jitterUs);
+        updateDepthLocked();
+        m_depthUs.record(m_stats.depthUs);
+        return static_cast<uint64_t>(static_cast<int64_t>(timestampUs) + m_baselineUs + m_stats.depthUs);
+    }
+
+    /// Feed a recorded trace, e.g. to evaluate a configuration offline.
+    void replay(const NvstAdjbArrival* trace, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            onArrival(trace[i].timestampUs, trace[i].arrivalUs);
+        }
+    }
+
+    /// Answer a QoS request: combine it with the local limits, and acknowledge the result.
+    /// \param[in] requested Configuration from NVST_CE_ADJB_CONFIG_CHANGE_EVENT.
+    /// \param[out] acknowledged If not NULL, receives the configuration sent back.
+    /// \return Result of setRuntimeParamProc, or NVST_R_SUCCESS if sending is disabled.
+    NvstResult onConfigChange(const NvstClientDJBConfig& requested, NvstClientDJBConfig* acknowledged = nullptr)
+    {
+        NvstClientDJBConfig reply;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_requested = requested;
+            ++m_stats.configChanges;
+            applyLimitsLocked();
+            updateDepthLocked();
+            reply = currentConfigLocked(NVST_DJB_CHANGE_QOS);
+        }
+        if (acknowledged)
+        {
+            *acknowledged = reply;
+        }
+        return send(reply);
+    }
+
+    /// Pass every client event here; ADJB requests are answered, others are ignored.
+    /// \retval NVST_R_NOT_FOUND if the event is not an ADJB request
+    NvstResult onClientEvent(const NvstClientEvent& event)
+    {
+        if (event.type != NVST_CE_ADJB_CONFIG_CHANGE_EVENT)
+        {
+            return NVST_R_NOT_FOUND;
+        }
+        return onConfigChange(event.data.djbConfig);
+    }
+
+    /// Switch modes, e.g. when the renderer enters or leaves VVsync, and tell QoS.
+    NvstResult setMode(NvstClientDJBMode mode)
+    {
+        NvstClientDJBConfig update;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (mode == m_config.mode)
+            {
+                return NVST_R_SUCCESS;
+            }
+            m_config.mode = mode;
+            updateDepthLocked();
+            update = currentConfigLocked(NVST_DJB_CHANGE_MODE);
+        }
+        return send(update);
+    }
+
+    /// Change the display refresh interval used by NVST_DJB_MODE_VVSYNC.
+    void setVsyncInterval(uint32_t vsyncIntervalUs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_config.vsyncIntervalUs = vsyncIntervalUs;
+        updateDepthLocked();
+    }
+
+    /// \return Current buffer depth.
+    uint32_t depthUs() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats.depthUs;
+    }
+
+    /// Depth after every frame, in microseconds. Read it from the thread calling onArrival().
+    const NvstHistogram& depthHistogram() const { return m_depthUs; }
+
+    NvstAdjbEngineStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    void trackQuantileLocked(double jitterUs)
+    {
+        const double deviation = jitterUs > m_estimateUs ? jitterUs - m_estimateUs : m_estimateUs - jitterUs;
+        m_spreadUs += (deviation - m_spreadUs) / 64.0;
+        // Never let the step vanish, or a quiet start would freeze the estimate.
+        const double step = (m_spreadUs > 100.0 ? m_spreadUs : 100.0) * m_config.convergenceFactor / 1000.0;
+        const double quantile = m_config.quantile / 1000.0;
+        if (jitterUs > m_estimateUs)
+        {
+            m_estimateUs += step * quantile;
+        }
+        else
+        {
+            m_estimateUs -= step * (1.0 - quantile);
+            if (m_estimateUs < 0.0)
+            {
+                m_estimateUs = 0.0;
+            }
+        }
+        m_stats.jitterQuantileUs = static_cast<uint32_t>(m_estimateUs + 0.5);
+    }
+
+    /// Combine the local configuration with the last QoS request.
+    void applyLimitsLocked()
+    {
+        const uint32_t localMax = m_config.maxDepthUs ? m_config.maxDepthUs : m_config.hardMaxDepthUs;
+        uint32_t lower = m_config.minDepthUs > m_requested.minDepthUs ? m_config.minDepthUs : m_requested.minDepthUs;
+        uint32_t upper = localMax;
+        if (m_requested.maxDepthUs && (m_requested.maxDepthUs < upper || m_requested.force))
+        {
+            upper = m_requested.maxDepthUs;
+        }
+        if (m_requested.force)
+        {
+            // Forced requests may exceed the local limit, but not what the implementation supports.
+            upper = upper < m_config.hardMaxDepthUs ? upper : m_config.hardMaxDepthUs;
+            if (lower > upper)
+            {
+                upper = lower < m_config.hardMaxDepthUs ? lower : m_config.hardMaxDepthUs;
+            }
+        }
+        if (lower > upper)
+        {
+            lower = upper;
+        }
+        m_stats.effectiveMinDepthUs = lower;
+        m_stats.effectiveMaxDepthUs = upper;
+    }
+
+    void updateDepthLocked()
+    {
+        uint32_t depth = 0;
+        switch (m_config.mode)
+        {
+        case NVST_DJB_MODE_FIXED:
+            // The adaptive limits don't apply; dejitterBufferLengthMs may exceed adjbMaxLengthMs.
+            m_stats.depthUs =
+                m_config.fixedDepthUs < m_config.hardMaxDepthUs ? m_config.fixedDepthUs : m_config.hardMaxDepthUs;
+            return;
+        case NVST_DJB_MODE_VVSYNC:
+        {
+            // Frames leave on vsync boundaries; a partial interval buys nothing.
+            const uint32_t interval = m_config.vsyncIntervalUs ? m_config.vsyncIntervalUs : 1;
+            depth = (m_stats.jitterQuantileUs + interval - 1) / interval * interval;
+            break;
+        }
+        default:
+            depth = m_stats.jitterQuantileUs;
+            break;
+        }
+        if (depth < m_stats.effectiveMinDepthUs)
+        {
+            depth = m_stats.effectiveMinDepthUs;
+        }
+        if (depth > m_stats.effectiveMaxDepthUs)
+        {
+            depth = m_stats.effectiveMaxDepthUs;
+        }
+        m_stats.depthUs = depth;
+    }
+
+    NvstClientDJBConfig currentConfigLocked(NvstClientDJBChangeReason reason) const
+    {
+        NvstClientDJBConfig config = {};
+        config.reason = reason;
+        config.mode = m_config.mode;
+        config.minDepthUs = m_stats.effectiveMinDepthUs;
+        config.maxDepthUs = m_stats.effectiveMaxDepthUs;
+        config.force = m_requested.force;
+        return config;
+    }
+
+    NvstResult send(const NvstClientDJBConfig& config)
+    {
+        if (!m_config.setRuntimeParamProc || !m_config.client)
+        {
+            return NVST_R_SUCCESS;
+        }
+        NvstClientRuntimeParam param = {};
+        param.paramId = NVST_RUNTIME_PARAM_ADJB_CONFIG;
+        param.djbConfig = config;
+        const NvstResult result = m_config.setRuntimeParamProc(m_config.client, &param);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.configsSent;
+        return result;
+    }
+
+    NvstAdjbEngineConfig m_config;
+    mutable std::mutex m_mutex;
+    NvstClientDJBConfig m_requested = {};
+    int64_t m_baselineUs = 0;
+    double m_estimateUs = 0.0;
+    double m_spreadUs = 0.0;
+    NvstHistogram m_depthUs;
+    NvstAdjbEngineStats m_stats = {};
+};
@@ -0,0 +1,298 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file FrameAligner.h
+/// Client-side grouping of frames from several video streams by frameTimestampUs.
+///
+/// Counterpart of NvstMultiStreamScheduler: frames captured on the same
+/// server tick carry the same NvstVideoDecodeUnit::frameTimestampUs, and are
+/// released to the renderer together.
+
+#pragma once
+
+#include "../common/SharedTypes.h"
+#include "../common/VideoDecodeUnit.h"
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// Receive a group of frames that belong to the same instant.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] frameTimestampUs Timestamp of the group (of its first frame).
+/// \param[in] frames One entry per stream index; NULL for streams missing from a partial group.
+/// \param[in] streamMask Bit i is set if frames[i] is valid.
+typedef void (*NVST_ALIGNED_FRAMES_PROC)(
+    void* context,
+    uint64_t frameTimestampUs,
+    void* const frames[VIDEO_STREAM_MAX_COUNT],
+    uint32_t streamMask);
+
+/// Take back a frame that will never be released as part of a group.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] streamIndex Stream the frame belongs to.
+/// \param[in] frameTimestampUs Timestamp of the frame.
+/// \param[in] frame Frame as passed to submit().
+typedef void (*NVST_DISCARD_FRAME_PROC)(void* context, uint16_t streamIndex, uint64_t frameTimestampUs, void* frame);
+
+/// Configuration of NvstMultiStreamFrameAligner.
+/// \ingroup Video
+typedef struct NvstFrameAlignerConfig_t
+{
+    /// Bit i set for every stream index that takes part in a group.
+    uint32_t streamMask;
+    /// Frames whose timestamps differ by at most this much belong to the same group.
+    uint64_t toleranceUs;
+    /// An incomplete group is released partially once its first frame waited this long
+    /// (see poll()), so a lost frame on one stream doesn't stall the others.
+    uint64_t maxWaitUs;
+    /// Maximum number of incomplete groups; the oldest one is discarded beyond that.
+    uint32_t maxPendingGroups;
+    /// Called with every complete or partial group.
+    NVST_ALIGNED_FRAMES_PROC alignedProc;
+    /// Called for every frame that is dropped. May be NULL if frames need no release.
+    NVST_DISCARD_FRAME_PROC discardProc;
+    /// Passed to both procs.
+    void* context;
+} NvstFrameAlignerConfig;
+
+/// Counters of an NvstMultiStreamFrameAligner.
+/// \ingroup Video
+typedef struct NvstFrameAlignerStats_t
+{
+    /// Groups released with a frame for every stream in streamMask.
+    uint64_t completeGroups;
+    /// Groups released by poll() with some frames missing.
+    uint64_t partialGroups;
+    /// Frames handed to discardProc.
+    uint64_t discardedFrames;
+    /// Frames among them that were no newer than the last released group.
+    uint64_t lateFrames;
+} NvstFrameAlignerStats;
+
+/// Groups decoded (or still encoded) frames of several streams by timestamp.
+///
+/// A group is released as soon as every stream in streamMask contributed a
+/// frame. Older incomplete groups are then discarded, and so are frames arriving
+/// later that are no newer than the last released group, because presenting
+/// them would go back in time. Frames are opaque pointers, so
+/// the aligner works equally for VDUs, decoded pictures or textures.
+/// Thread safe; the procs are invoked without the internal lock held, from the
+/// thread calling submit() or poll().
+/// \ingroup Video
+class NvstMultiStreamFrameAligner
+{
+public:
+    explicit NvstMultiStreamFrameAligner(const NvstFrameAlignerConfig& config)
+        : m_config(config)
+    {
+        m_config.streamMask &= (1u << VIDEO_STREAM_MAX_COUNT) - 1;
+        if (m_config.maxPendingGroups == 0)
+        {
+            m_config.maxPendingGroups = 1;
+        }
+    }
+
+    /// Discards everything still pending.
+    ~NvstMultiStreamFrameAligner() { flush(); }
+
+    NvstMultiStreamFrameAligner(const NvstMultiStreamFrameAligner&) = delete;
+    NvstMultiStreamFrameAligner& operator=(const NvstMultiStreamFrameAligner&) = delete;
+
+    /// Add a frame.
+    /// \param[in] streamIndex Stream of the frame (NvstVideoDecodeUnit::streamIndex).
+    /// \param[in] frameTimestampUs NvstVideoDecodeUnit::frameTimestampUs of the frame.
+    /// \param[in] frame Opaque frame handle, returned through alignedProc or discardProc.
+    /// \param[in] nowUs Current time, used for the maxWaitUs deadline.
+    /// \return false if streamIndex isn't part of streamMask; the frame is not taken in that case.
+    /// A frame no newer than the last released group is taken and discarded.
+    bool submit(uint16_t streamIndex, uint64_t frameTimestampUs, void* frame, uint64_t nowUs)
+    {
+        if (streamIndex >= VIDEO_STREAM_MAX_COUNT || !(m_config.streamMask & (1u << streamIndex)))
+        {
+            return false;
+        }
+        Actions actions;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_hasReleased && frameTimestampUs <= m_lastReleasedUs + m_config.toleranceUs)
+            {
+                actions.discard(streamIndex, frameTimestampUs, frame);
+                ++m_stats.discardedFrames;
+                ++m_stats.lateFrames;
+            }
+            else
+            {
+                size_t index = 0;
+                while (index < m_groups.size() && m_groups[index].timestampUs + m_config.toleranceUs < frameTimestampUs)
+                {
+                    ++index;
+                }
+                if (index == m_groups.size() || m_groups[index].timestampUs > frameTimestampUs + m_config.toleranceUs)
+                {
+                    Group group = {};
+                    group.timestampUs = frameTimestampUs;
+                    group.firstArrivalUs = nowUs;
+                    m_groups.insert(m_groups.begin() + static_cast<std::ptrdiff_t>(index), group);
+                }
+                Group& group = m_groups[index];
+                if (group.mask & (1u << streamIndex))
+                {
+                    // Duplicate timestamp on one stream: keep the newest frame.
+                    actions.discard(streamIndex, group.timestampUs, group.frames[streamIndex]);
+                }
+                group.frames[streamIndex] = frame;
+                group.mask |= 1u << streamIndex;
+
+                if (group.mask == m_config.streamMask)
+                {
+                    for (size_t older = 0; older < index; ++older)
+                    {
+                        discardGroup(m_groups[older], actions);
+                    }
+                    actions.release.push_back(group);
+                    markReleased(group.timestampUs);
+                    m_groups.erase(m_groups.begin(), m_groups.begin() + static_cast<std::ptrdiff_t>(index) + 1);
+                    ++m_stats.completeGroups;
+                }
+                while (m_groups.size() > m_config.maxPendingGroups)
+                {
+                    discardGroup(m_groups.front(), actions);
+                    m_groups.erase(m_groups.begin());
+                }
+                m_stats.discardedFrames += actions.discarded.size();
+            }
+        }
+        run(actions);
+        return true;
+    }
+
+    /// Release incomplete groups whose first frame waited longer than maxWaitUs.
+    /// Call periodically, e.g. once per display refresh.
+    void poll(uint64_t nowUs)
+    {
+        Actions actions;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            // nowUs may be earlier than an arrival passed to submit(); such a group hasn't waited yet.
+            while (!m_groups.empty() && nowUs >= m_groups.front().firstArrivalUs &&
+                   nowUs - m_groups.front().firstArrivalUs >= m_config.maxWaitUs)
+            {
+                actions.release.push_back(m_groups.front());
+                markReleased(m_groups.front().timestampUs);
+                m_groups.erase(m_groups.begin());
+                ++m_stats.partialGroups;
+            }
+        }
+        run(actions);
+    }
+
+    /// Discard every pending frame, e.g. when the stream restarts.
+    /// Timestamps may start over afterwards.
+    void flush()
+    {
+        Actions actions;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_hasReleased = false;
+            for (Group& group : m_groups)
+            {
+                discardGroup(group, actions);
+            }
+            m_groups.clear();
+            m_stats.discardedFrames += actions.discarded.size();
+        }
+        run(actions);
+    }
+
+    NvstFrameAlignerStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    struct Group
+    {
+        uint64_t timestampUs;
+        uint64_t firstArrivalUs;
+        uint32_t mask;
+        void* frames[VIDEO_STREAM_MAX_COUNT];
+    };
+
+    struct Discarded
+    {
+        uint16_t streamIndex;
+        uint64_t timestampUs;
+        void* frame;
+    };
+
+    /// Callbacks collected under the lock and run after it is released.
+    struct Actions
+    {
+        std::vector<Group> release;
+        std::vector<Discarded> discarded;
+
+        void discard(uint16_t streamIndex, uint64_t timestampUs, void* frame)
+        {
+            Discarded entry = {streamIndex, timestampUs, frame};
+            discarded.push_back(entry);
+        }
+    };
+
+    void markReleased(uint64_t timestampUs)
+    {
+        if (!m_hasReleased || timestampUs > m_lastReleasedUs)
+        {
+            m_lastReleasedUs = timestampUs;
+        }
+        m_hasReleased = true;
+    }
+
+    static void discardGroup(const Group& group, Actions& actions)
+    {
+        for (uint16_t i = 0; i < VIDEO_STREAM_MAX_COUNT; ++i)
+        {
+            if (group.mask & (1u << i))
+            {
+                actions.discard(i, group.timestampUs, group.frames[i]);
+            }
+        }
+    }
+
+    void run(const Actions& actions) const
+    {
+        if (m_config.discardProc)
+        {
+            for (const Discarded& entry : actions.discarded)
+            {
+                m_config.discardProc(m_config.context, entry.streamIndex, entry.timestampUs, entry.frame);
+            }
+        }
+        if (m_config.alignedProc)
+        {
+            for (const Group& group : actions.release)
+            {
+                m_config.alignedProc(m_config.context, group.timestampUs, group.frames, group.mask);
+            }
+        }
+    }
+
+    NvstFrameAlignerConfig m_config;
+    mutable std::mutex m_mutex;
+    /// Incomplete groups, oldest timestamp first.
+    std::vector<Group> m_groups;
+    /// Timestamp of the newest released group.
+    uint64_t m_lastReleasedUs = 0;
+    bool m_hasReleased = false;
+    NvstFrameAlignerStats m_stats = {};
+};
@@ -0,0 +1,499 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file FrameLifecycleTracker.h
+/// Per-frame decode/render/present state reporting with batched nvstUpdateStats calls.
+///
+/// NvstClientVideoFrameStats::state has to be reported for every frame after
+/// decoding and after rendering. NvstFrameLifecycleTracker hands out an RAII
+/// NvstTrackedFrame per frame: its transitions are queued lock-free from the
+/// decoder and render threads, and a single flusher forwards them to the SDK
+/// in order. A frame that goes out of scope without completing its lifecycle
+/// reports the matching failure or skip state, so no frame is left in flight.
+
+#pragma once
+
+#include "StreamClient.h"
+#include "../common/Histogram.h"
+#include "../common/VideoDecodeUnit.h"
+
+#include <nvsc/TimeUtils.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// Lifecycle stages measured by NvstFrameLifecycleTracker.
+/// \ingroup Video
+typedef enum NvstFrameStage_t
+{
+    /// begin() until decoded().
+    NVST_FRAME_STAGE_DECODE = 0,
+    /// decoded() until renderStarted(), i.e. waiting in the render queue.
+    /// Empty if renderStarted() is never called.
+    NVST_FRAME_STAGE_RENDER_QUEUE = 1,
+    /// renderStarted() until rendered(), or decoded() until rendered() without renderStarted().
+    NVST_FRAME_STAGE_RENDER = 2,
+    /// rendered() until presented().
+    NVST_FRAME_STAGE_PRESENT = 3,
+    /// begin() until the last reported transition.
+    NVST_FRAME_STAGE_TOTAL = 4,
+    NVST_FRAME_STAGE_COUNT = 5,
+} NvstFrameStage;
+
+/// Configuration of NvstFrameLifecycleTracker.
+/// \ingroup Video
+typedef struct NvstFrameLifecycleTrackerConfig_t
+{
+    /// Client the states are reported to.
+    NvstClient client;
+    /// Function used to report states. Defaults to nvstUpdateStats.
+    CLIENT_UPDATE_STATS updateStatsProc;
+    /// Number of queued transitions; rounded up to a power of two.
+    uint32_t capacity;
+    /// The flusher thread forwards queued transitions this often. The SDK time-stamps
+    /// transitions on arrival, so keep this well below a frame interval.
+    /// 0 disables the thread; call flush() instead, e.g. once per rendered frame.
+    uint32_t flushIntervalUs;
+    /// Fill NvstClientVideoFrameStats::eventTime with the transition time in milliseconds
+    /// on the nvstGetTimeNs() clock, so the batching delay can be accounted for.
+    bool fillEventTime;
+} NvstFrameLifecycleTrackerConfig;
+
+/// Default configuration: 256 queued transitions, flushed every millisecond.
+static inline void nvstFrameLifecycleTrackerGetDefaultConfig(NvstFrameLifecycleTrackerConfig* config)
+{
+    config->client = NULL;
+    config->updateStatsProc = nvstUpdateStats;
+    config->capacity = 256;
+    config->flushIntervalUs = 1000;
+    config->fillEventTime = false;
+}
+
+/// Counters of an NvstFrameLifecycleTracker.
+/// \ingroup Video
+typedef struct NvstFrameLifecycleTrackerStats_t
+{
+    /// Transitions queued.
+    uint64_t transitions;
+    /// Transitions forwarded to nvstUpdateStats.
+    uint64_t reported;
+    /// Flushes that forwarded at least one transition.
+    uint64_t batches;
+    /// Transitions whose producer found the queue full and had to drain it itself.
+    uint64_t overflows;
+    /// Frames destroyed before their lifecycle was complete.
+    uint64_t abandonedFrames;
+} NvstFrameLifecycleTrackerStats;
+
+class NvstFrameLifecycleTracker;
+
+/// Lifecycle of one frame, obtained from NvstFrameLifecycleTracker::begin().
+///
+/// Call decoded(), then rendered() and optionally presented(). Going out of
+/// scope reports NVST_FS_DECODE_FAILED if the frame was never decoded, and
+/// NVST_FS_RENDER_SKIPPED if it was decoded but never rendered.
+/// Movable, so it can travel with the frame from the decoder to the render thread.
+/// \ingroup Video
+class NvstTrackedFrame
+{
+public:
+    NvstTrackedFrame() = default;
+
+    NvstTrackedFrame(NvstTrackedFrame&& other) noexcept { *this = std::move(other); }
+
+    NvstTrackedFrame& operator=(NvstTrackedFrame&& other) noexcept
+    {
+        if (this != &other)
+        {
+            finish();
+            m_tracker = other.m_tracker;
+            m_streamIndex = other.m_streamIndex;
+            m_frameNumber = other.m_frameNumber;
+            m_frameSize = other.m_frameSize;
+            m_state = other.m_state;
+            m_beginNs = other.m_beginNs;
+            m_lastNs = other.m_lastNs;
+            other.m_tracker = nullptr;
+        }
+        return *this;
+    }
+
+    NvstTrackedFrame(const NvstTrackedFrame&) = delete;
+    NvstTrackedFrame& operator=(const NvstTrackedFrame&) = delete;
+
+    ~NvstTrackedFrame() { finish(); }
+
+    /// Report the decode result: NVST_FS_DECODE_COMPLETED or NVST_FS_DECODE_FAILED.
+    /// A failure ends the lifecycle and is flushed at once, so the SDK can start error recovery.
+    inline void decoded(bool success);
+
+    /// Report that the decoder skipped the frame (NVST_FS_DECODE_SKIPPED or _NO_INVALIDATION). Ends the lifecycle.
+    inline void skipped(bool requestInvalidation);
+
+    /// Report NVST_FS_RENDER_STARTED. Optional; when called, the render stage and the
+    /// NVST_FS_RENDER_COMPLETED processing time exclude the time spent queued before rendering.
+    inline void renderStarted();
+
+    /// Report NVST_FS_RENDER_COMPLETED.
+    inline void rendered();
+
+    /// Report NVST_FS_PRESENT_COMPLETED. Ends the lifecycle.
+    /// \param[in] displayLatencyMs Latency to report along with the state, if known.
+    inline void presented(uint64_t displayLatencyMs = 0);
+
+    /// Report NVST_FS_RENDER_SKIPPED, e.g. when a newer frame replaced this one. Ends the lifecycle.
+    inline void renderSkipped();
+
+    /// \return The last reported state.
+    NvstVideoFrameState state() const { return m_state; }
+
+    /// \return true while the frame still needs to report a transition.
+    bool isActive() const { return m_tracker != nullptr; }
+
+private:
+    friend class NvstFrameLifecycleTracker;
+
+    inline void transition(NvstVideoFrameState state, NvstFrameStage stage, uint64_t displayLatencyMs, bool last);
+    inline void finish();
+
+    NvstFrameLifecycleTracker* m_tracker = nullptr;
+    uint16_t m_streamIndex = 0;
+    uint32_t m_frameNumber = 0;
+    uint32_t m_frameSize = 0;
+    NvstVideoFrameState m_state = NVST_FS_DECODE_NONE;
+    int64_t m_beginNs = 0;
+    int64_t m_lastNs = 0;
+};
+
+/// Queues frame state transitions from any thread and reports them to the SDK in batches.
+///
+/// Queuing a transition is a few stores into a bounded lock-free
+/// multi-producer ring. Transitions are forwarded in queue order, so the
+/// states of a frame always reach the SDK in lifecycle order. Only when the
+/// ring is full does a producer wait, draining the queue itself.
+/// \ingroup Video
+class NvstFrameLifecycleTracker
+{
+public:
+    explicit NvstFrameLifecycleTracker(const NvstFrameLifecycleTrackerConfig& config)
+        : m_config(config)
+    {
+        if (!m_config.updateStatsProc)
+        {
+            m_config.updateStatsProc = nvstUpdateStats;
+        }
+        uint32_t size = 2;
+        while (size < m_config.capacity)
+        {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots.reset(new Slot[size]);
+        for (uint32_t i = 0; i < size; ++i)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        if (m_config.flushIntervalUs)
+        {
+            m_thread = std::thread(&NvstFrameLifecycleTracker::flushLoop, this);
+        }
+    }
+
+    /// Stops the flusher and reports whatever is still queued.
+    ~NvstFrameLifecycleTracker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stop = true;
+        }
+        m_wakeCondition.notify_one();
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+        flush();
+    }
+
+    NvstFrameLifecycleTracker(const NvstFrameLifecycleTracker&) = delete;
+    NvstFrameLifecycleTracker& operator=(const NvstFrameLifecycleTracker&) = delete;
+
+    /// Start tracking a frame handed to the decoder.
+    /// \param[in] vdu Decode unit of the frame (the first slice, for multi-slice frames).
+    NvstTrackedFrame begin(const NvstVideoDecodeUnit* vdu)
+    {
+        return begin(vdu->streamIndex, vdu->frameNumber, vdu->streamSizeBytes);
+    }
+
+    /// Start tracking a frame handed to the decoder.
+    NvstTrackedFrame begin(uint16_t streamIndex, uint32_t frameNumber, uint32_t frameSize)
+    {
+        NvstTrackedFrame frame;
+        frame.m_tracker = this;
+        frame.m_streamIndex = streamIndex;
+        frame.m_frameNumber = frameNumber;
+        frame.m_frameSize = frameSize;
+        frame.m_state = NVST_FS_DECODE_ONGOING;
+        frame.m_beginNs = nvstGetTimeNs();
+        frame.m_lastNs = frame.m_beginNs;
+        return frame;
+    }
+
+    /// Forward every queued transition to the SDK.
+    /// Safe to call from any thread; concurrent callers return at once while another flush runs.
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(m_flushMutex, std::try_to_lock);
+        if (lock.owns_lock())
+        {
+            drain();
+        }
+    }
+
+    /// Latency of a lifecycle stage, in microseconds.
+    const NvstHistogram& stageHistogram(NvstFrameStage stage) const { return m_stageUs[stage]; }
+
+    NvstFrameLifecycleTrackerStats getStats() const
+    {
+        NvstFrameLifecycleTrackerStats stats;
+        stats.transitions = m_transitions.load(std::memory_order_relaxed);
+        stats.reported = m_reported.load(std::memory_order_relaxed);
+        stats.batches = m_batches.load(std::memory_order_relaxed);
+        stats.overflows = m_overflows.load(std::memory_order_relaxed);
+        stats.abandonedFrames = m_abandoned.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    friend class NvstTrackedFrame;
+
+    struct Slot
+    {
+        std::atomic<uint64_t> sequence{0};
+        NvstClientUpdateStats stats;
+    };
+
+    void enqueue(const NvstClientVideoFrameStats& frameStats, bool urgent)
+    {
+        m_transitions.fetch_add(1, std::memory_order_relaxed);
+        uint64_t tail = m_tail.load(std::memory_order_relaxed);
+        bool waited = false;
+        for (;;)
+        {
+            Slot& slot = m_slots[tail & m_mask];
+            const uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const int64_t distance = static_cast<int64_t>(sequence - tail);
+            if (distance == 0)
+            {
+                if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                {
+                    slot.stats.statsId = NVST_UPDATE_STATS_VIDEO_FRAME;
+                    slot.stats.videoFrameStats = frameStats;
+                    slot.sequence.store(tail + 1, std::memory_order_release);
+                    break;
+                }
+            }
+            else if (distance < 0)
+            {
+                // Full: drain the queue on this thread. Reporting directly instead
+                // could overtake an earlier queued state of the same frame.
+                if (!waited)
+                {
+                    m_overflows.fetch_add(1, std::memory_order_relaxed);
+                    waited = true;
+                }
+                std::unique_lock<std::mutex> lock(m_flushMutex);
+                drain();
+                lock.unlock();
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+            else
+            {
+                tail = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+        if (urgent)
+        {
+            if (m_thread.joinable())
+            {
+                m_wakeCondition.notify_one();
+            }
+            else
+            {
+                flush();
+            }
+        }
+    }
+
+    /// Forward queued transitions; m_flushMutex must be held.
+    void drain()
+    {
+        uint64_t count = 0;
+        NvstClientUpdateStats stats;
+        for (;;)
+        {
+            Slot& slot = m_slots[m_head & m_mask];
+            if (slot.sequence.load(std::memory_order_acquire) != m_head + 1)
+            {
+                break;
+            }
+            stats = slot.stats;
+            slot.sequence.store(m_head + m_mask + 1, std::memory_order_release);
+            ++m_head;
+            report(stats);
+            ++count;
+        }
+        if (count)
+        {
+            m_reported.fetch_add(count, std::memory_order_relaxed);
+            m_batches.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    void report(NvstClientUpdateStats& stats)
+    {
+        if (m_config.client)
+        {
+            m_config.updateStatsProc(m_config.client, &stats);
+        }
+    }
+
+    void flushLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        while (!m_stop)
+        {
+            m_wakeCondition.wait_for(lock, std::chrono::microseconds(m_config.flushIntervalUs));
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    NvstFrameLifecycleTrackerConfig m_config;
+    uint32_t m_mask = 0;
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<uint64_t> m_tail{0};
+    alignas(64) uint64_t m_head = 0;
+    std::mutex m_flushMutex;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    bool m_stop = false;
+    std::thread m_thread;
+
+    NvstHistogram m_stageUs[NVST_FRAME_STAGE_COUNT];
+    std::atomic<uint64_t> m_transitions{0};
+    std::atomic<uint64_t> m_reported{0};
+    std::atomic<uint64_t> m_batches{0};
+    std::atomic<uint64_t> m_overflows{0};
+    std::atomic<uint64_t> m_abandoned{0};
+};
+
+inline void NvstTrackedFrame::transition(
+    NvstVideoFrameState state,
+    NvstFrameStage stage,
+    uint64_t displayLatencyMs,
+    bool last)
+{
+    if (!m_tracker)
+    {
+        return;
+    }
+    const int64_t nowNs = nvstGetTimeNs();
+    const int64_t stageNs = nowNs - m_lastNs;
+    NvstClientVideoFrameStats stats = {};
+    stats.streamIndex = m_streamIndex;
+    stats.frameNumber = m_frameNumber;
+    stats.state = state;
+    stats.processTimeMs = static_cast<double>(stageNs) / 1e6;
+    stats.frameSize = m_frameSize;
+    stats.displayLatencyMs = displayLatencyMs;
+    if (m_tracker->m_config.fillEventTime)
+    {
+        stats.eventTime = static_cast<long double>(nowNs) / 1e6L;
+    }
+    if (stage != NVST_FRAME_STAGE_COUNT)
+    {
+        m_tracker->m_stageUs[stage].record(static_cast<uint64_t>(stageNs) / 1000);
+        m_lastNs = nowNs;
+    }
+    if (last)
+    {
+        m_tracker->m_stageUs[NVST_FRAME_STAGE_TOTAL].record(static_cast<uint64_t>(nowNs - m_beginNs) / 1000);
+    }
+    m_state = state;
+    m_tracker->enqueue(stats, state == NVST_FS_DECODE_FAILED);
+    if (last)
+    {
+        m_tracker = nullptr;
+    }
+}
+
+inline void NvstTrackedFrame::decoded(bool success)
+{
+    transition(success ? NVST_FS_DECODE_COMPLETED : NVST_FS_DECODE_FAILED, NVST_FRAME_STAGE_DECODE, 0, !success);
+}
+
+inline void NvstTrackedFrame::skipped(bool requestInvalidation)
+{
+    transition(requestInvalidation ? NVST_FS_DECODE_SKIPPED : NVST_FS_DECODE_SKIPPED_NO_INVALIDATION,
+               NVST_FRAME_STAGE_DECODE, 0, true);
+}
+
+inline void NvstTrackedFrame::renderStarted()
+{
+    transition(NVST_FS_RENDER_STARTED, NVST_FRAME_STAGE_RENDER_QUEUE, 0, false);
+}
+
+inline void NvstTrackedFrame::rendered()
+{
+    transition(NVST_FS_RENDER_COMPLETED, NVST_FRAME_STAGE_RENDER, 0, false);
+}
+
+inline void NvstTrackedFrame::presented(uint64_t displayLatencyMs)
+{
+    transition(NVST_FS_PRESENT_COMPLETED, NVST_FRAME_STAGE_PRESENT, displayLatencyMs, true);
+}
+
+inline void NvstTrackedFrame::renderSkipped()
+{
+    transition(NVST_FS_RENDER_SKIPPED, NVST_FRAME_STAGE_COUNT, 0, true);
+}
+
+inline void NvstTrackedFrame::finish()
+{
+    if (!m_tracker)
+    {
+        return;
+    }
+    // A rendered frame that was never confirmed as presented needs no further state.
+    if (m_state == NVST_FS_RENDER_COMPLETED)
+    {
+        m_tracker->m_stageUs[NVST_FRAME_STAGE_TOTAL].record(static_cast<uint64_t>(m_lastNs - m_beginNs) / 1000);
+        m_tracker = nullptr;
+        return;
+    }
+    m_tracker->m_abandoned.fetch_add(1, std::memory_order_relaxed);
+    if (m_state == NVST_FS_DECODE_ONGOING)
+    {
+        decoded(false);
+    }
+    else
+    {
+        renderSkipped();
+    }
+}
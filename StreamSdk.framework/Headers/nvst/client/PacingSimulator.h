@@ -0,0 +1,419 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file PacingSimulator.h
+/// Offline frame pacing simulation and PID parameter search.
+///
+/// Frame pacing closes a loop between the client's render queue and the server's
+/// capture cadence: the client measures how long frames wait for vsync, and a
+/// PID controller (NvscFramePacing::pid) stretches or shrinks the server frame
+/// time so that the wait converges to the target queue time.
+///
+/// NvstPacingSimulator replays recorded traces through a model of that loop:
+/// per-frame network transit and render times, and display vsync intervals.
+/// It scores the run by stutter (vsyncs without a new frame), added latency
+/// (time frames wait for their vsync) and drops. NvstPacingTuner evaluates a grid
+/// of PID parameters on all cores and reports the best one.
+///
+/// The controller is a reference model with the semantics documented for the Pid
+/// settings; the SDK's internal controller is not part of these headers.
+
+#pragma once
+
+#include "../common/Histogram.h"
+#include "../common/QuantileEstimator.h"
+
+#include <nvsc/DefineDefaultConfigs_auto.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <thread>
+#include <vector>
+
+/// PID parameters, with the units of the Pid settings struct.
+/// \ingroup Video
+typedef struct NvstPacingPidParams_t
+{
+    /// Proportional gain x1000.
+    uint32_t kP;
+    /// Integral gain x1000.
+    uint32_t kI;
+    /// Limit of the integral term x1000.
+    uint32_t kL;
+    /// Nominal server frame time.
+    uint32_t targetFrameTimeUs;
+    /// Range of the frame time the controller may request.
+    uint32_t minTargetFrameTimeUs;
+    uint32_t maxTargetFrameTimeUs;
+    /// Largest deviation from targetFrameTimeUs, in per mille.
+    uint32_t allowedDeviation;
+    /// Target queue time; 0 derives it from the arrival jitter.
+    uint32_t targetQueueTimeUs;
+} NvstPacingPidParams;
+
+/// Default parameters: the defaults of the Pid settings for 60 Hz.
+static inline void nvstPacingPidGetDefaultParams(NvstPacingPidParams* params)
+{
+    params->kP = DEFAULT_FRAME_PACING_PID_KP;
+    params->kI = DEFAULT_FRAME_PACING_PID_KI;
+    params->kL = DEFAULT_FRAME_PACING_PID_KL;
+    params->targetFrameTimeUs = DEFAULT_TARGET_FRAME_TIME_US;
+    params->minTargetFrameTimeUs = DEFAULT_MIN_TARGET_FRAME_TIME_US;
+    params->maxTargetFrameTimeUs = DEFAULT_MAX_TARGET_FRAME_TIME_US;
+    params->allowedDeviation = DEFAULT_ALLOWED_DEVIATION;
+    params->targetQueueTimeUs = 0;
+}
+
+/// Write parameters in the form of the Pid settings.
+static inline void nvstPacingPidPrint(FILE* file, const NvstPacingPidParams& params)
+{
+    fprintf(file,
+            "kP=%u\nkI=%u\nkL=%u\ntargetFrameTimeUs=%u\nminTargetFrameTimeUs=%u\nmaxTargetFrameTimeUs=%u\n"
+            "allowedDeviation=%u\ntargetQueueTimeUs=%u\n",
+            params.kP, params.kI, params.kL, params.targetFrameTimeUs, params.minTargetFrameTimeUs,
+            params.maxTargetFrameTimeUs, params.allowedDeviation, params.targetQueueTimeUs);
+}
+
+/// Recorded behavior to replay. Each array is cycled if the simulation runs longer.
+/// \ingroup Video
+typedef struct NvstPacingTrace_t
+{
+    /// Network transit per frame: arrival minus capture, e.g. arrivalTimeUs - timeStampUs
+    /// of the records of an NvstBitstreamReader. Only differences matter.
+    const uint32_t* transitUs;
+    uint32_t transitCount;
+    /// Client decode plus render time per frame; NULL or a zero count for none.
+    const uint32_t* renderUs;
+    uint32_t renderCount;
+    /// Display vsync intervals; NULL or a zero count uses the nominal frame time.
+    const uint32_t* vsyncIntervalUs;
+    uint32_t vsyncCount;
+} NvstPacingTrace;
+
+/// Configuration of NvstPacingSimulator.
+/// \ingroup Video
+typedef struct NvstPacingSimulatorConfig_t
+{
+    /// Frames to simulate.
+    uint32_t frames;
+    /// Frames at the start that are not scored while the loop settles.
+    uint32_t warmupFrames;
+    /// NvscFramePacing::queueSmoothingHistoryN.
+    uint32_t queueSmoothingHistoryN;
+    /// NvscFramePacing::frameDropThresholdMultipleX1000.
+    uint32_t frameDropThresholdMultipleX1000;
+    /// Adaptive target queue time: jitter quantile x1000 and limits
+    /// (NvscFramePacingJitterHistory quantileX1000, minAdvanceUs, maxAdvanceUs).
+    uint32_t jitterQuantileX1000;
+    uint32_t minAdvanceUs;
+    uint32_t maxAdvanceUs;
+    /// Score weights: per percent of stuttering vsyncs, per millisecond of mean added
+    /// latency, and per percent of dropped frames.
+    double stutterWeight;
+    double latencyWeight;
+    double dropWeight;
+} NvstPacingSimulatorConfig;
+
+/// Default configuration: 10 minutes at 60 fps with the frame pacing defaults; a percent of
+/// stutter weighs as much as 10 ms of latency.
+static inline void nvstPacingSimulatorGetDefaultConfig(NvstPacingSimulatorConfig* config)
+{
+    config->frames = 36000;
+    config->warmupFrames = 600;
+    config->queueSmoothingHistoryN = DEFAULT_QUEUE_SMOOTHING_HISTORY_N;
+    config->frameDropThresholdMultipleX1000 = DEFAULT_FRAME_DROP_THRESHOLD_MULTIPLE_X1000;
+    config->jitterQuantileX1000 = DEFAULT_JITTER_HISTORY_QUANTILE_X1000;
+    config->minAdvanceUs = DEFAULT_JITTER_HISTORY_MIN_ADVANCE;
+    config->maxAdvanceUs = DEFAULT_JITTER_HISTORY_MAX_ADVANCE;
+    config->stutterWeight = 10.0;
+    config->latencyWeight = 1.0;
+    config->dropWeight = 10.0;
+}
+
+/// Outcome of a simulation.
+/// \ingroup Video
+typedef struct NvstPacingScore_t
+{
+    /// Weighted sum of the metrics below; lower is better.
+    double score;
+    /// Percent of scored vsyncs that repeated the previous frame.
+    double stutterPercent;
+    /// Mean time presented frames waited between arrival and their vsync.
+    double meanLatencyUs;
+    /// 99th percentile of that wait.
+    double p99LatencyUs;
+    /// Percent of scored frames dropped from the queue.
+    double dropPercent;
+    /// Mean server frame time requested by the controller.
+    double meanFrameTimeUs;
+} NvstPacingScore;
+
+/// Replays a trace through the pacing loop for one set of PID parameters.
+/// \ingroup Video
+class NvstPacingSimulator
+{
+public:
+    NvstPacingSimulator(const NvstPacingSimulatorConfig& config, const NvstPacingTrace& trace)
+        : m_config(config)
+        , m_trace(trace)
+    {
+    }
+
+    /// Run the simulation. Thread-safe; runs share nothing but the trace.
+    NvstPacingScore run(const NvstPacingPidParams& pid) const
+    {
+        NvstPacingScore score = {};
+        if (!m_trace.transitUs || !m_trace.transitCount || !m_config.frames)
+        {
+            return score;
+        }
+        const double kP = pid.kP / 1000.0;
+        const double kI = pid.kI / 1000.0;
+        const double kL = pid.kL / 1000.0;
+        const double nominalUs = pid.targetFrameTimeUs;
+        const double maxDeviation = pid.allowedDeviation / 1000.0;
+        const double smoothing = 2.0 / (m_config.queueSmoothingHistoryN + 1.0);
+
+        NvstQuantileEstimatorConfig jitterConfig;
+        nvstQuantileEstimatorGetDefaultConfig(&jitterConfig);
+        jitterConfig.mode = NVST_QUANTILE_ESTIMATOR_P2;
+        jitterConfig.quantile = m_config.jitterQuantileX1000 / 1000.0;
+        NvstQuantileEstimator jitter(jitterConfig);
+        uint32_t minTransitUs = UINT32_MAX;
+
+        struct Queued
+        {
+            uint32_t index;
+            double arrivalUs;
+            double readyUs;
+        };
+        std::deque<Queued> queue;
+        NvstHistogram latency;
+
+        double frameTimeUs = nominalUs;
+        double captureUs = 0.0;
+        double lastArrivalUs = 0.0;
+        double vsyncUs = 0.0;
+        double smoothedQueueUs = -1.0;
+        double integral = 0.0;
+        double latencySumUs = 0.0;
+        double frameTimeSumUs = 0.0;
+        uint64_t scoredVsyncs = 0;
+        uint64_t stutters = 0;
+        uint64_t presented = 0;
+        uint64_t scoredPresented = 0;
+        uint64_t drops = 0;
+        uint32_t captured = 0;
+        uint32_t vsyncIndex = 0;
+        bool started = false;
+
+        while (captured < m_config.frames || !queue.empty())
+        {
+            vsyncUs += m_trace.vsyncIntervalUs && m_trace.vsyncCount
+                ? m_trace.vsyncIntervalUs[vsyncIndex++ % m_trace.vsyncCount]
+                : nominalUs;
+
+            // Frames the server captured and the network delivered by this vsync.
+            while (captured < m_config.frames)
+            {
+                const uint32_t transitUs = m_trace.transitUs[captured % m_trace.transitCount];
+                const double arrivalUs = std::max(captureUs + transitUs, lastArrivalUs);
+                if (arrivalUs > vsyncUs)
+                {
+                    break;
+                }
+                const uint32_t renderUs =
+                    m_trace.renderUs && m_trace.renderCount ? m_trace.renderUs[captured % m_trace.renderCount] : 0;
+                queue.push_back({captured, arrivalUs, arrivalUs + renderUs});
+                minTransitUs = std::min(minTransitUs, transitUs);
+                jitter.add(static_cast<double>(transitUs - minTransitUs));
+                lastArrivalUs = arrivalUs;
+                captureUs += frameTimeUs;
+                frameTimeSumUs += captured >= m_config.warmupFrames ? frameTimeUs : 0.0;
+                ++captured;
+            }
+
+            double targetQueueUs = pid.targetQueueTimeUs;
+            if (!targetQueueUs)
+            {
+                targetQueueUs = std::min<double>(std::max<double>(jitter.estimate(), m_config.minAdvanceUs),
+                                                 m_config.maxAdvanceUs);
+            }
+            const double dropThresholdUs = targetQueueUs * m_config.frameDropThresholdMultipleX1000 / 1000.0;
+
+            // Frames waiting beyond the threshold give way to newer ready ones.
+            while (queue.size() > 1 && queue[1].readyUs <= vsyncUs && vsyncUs - queue.front().arrivalUs > dropThresholdUs)
+            {
+                drops += queue.front().index >= m_config.warmupFrames ? 1 : 0;
+                queue.pop_front();
+            }
+
+            const bool scored = captured > m_config.warmupFrames;
+            if (queue.empty() || queue.front().readyUs > vsyncUs)
+            {
+                if (started && scored && captured < m_config.frames)
+                {
+                    ++stutters;
+                }
+                scoredVsyncs += started && scored && captured < m_config.frames ? 1 : 0;
+                continue;
+            }
+            started = true;
+            scoredVsyncs += scored && captured < m_config.frames ? 1 : 0;
+            const Queued frame = queue.front();
+            queue.pop_front();
+            const double queuedUs = vsyncUs - frame.arrivalUs;
+            ++presented;
+            if (frame.index >= m_config.warmupFrames)
+            {
+                ++scoredPresented;
+                latencySumUs += queuedUs;
+                latency.record(static_cast<uint64_t>(queuedUs));
+            }
+
+            // PID on the smoothed queue time, normalized to the nominal frame time.
+            smoothedQueueUs = smoothedQueueUs < 0 ? queuedUs : smoothedQueueUs + smoothing * (queuedUs - smoothedQueueUs);
+            const double error = (smoothedQueueUs - targetQueueUs) / nominalUs;
+            integral = std::min(std::max(integral + error, -kL), kL);
+            const double deviation = std::min(std::max(kP * error + kI * integral, -maxDeviation), maxDeviation);
+            frameTimeUs = std::min<double>(std::max<double>(nominalUs * (1.0 + deviation), pid.minTargetFrameTimeUs),
+                                           pid.maxTargetFrameTimeUs);
+        }
+
+        const uint32_t scoredFrames = m_config.frames > m_config.warmupFrames ? m_config.frames - m_config.warmupFrames : 0;
+        score.stutterPercent = scoredVsyncs ? 100.0 * stutters / scoredVsyncs : 0.0;
+        score.meanLatencyUs = scoredPresented ? latencySumUs / scoredPresented : 0.0;
+        score.p99LatencyUs = static_cast<double>(latency.valueAtQuantile(0.99));
+        score.dropPercent = scoredFrames ? 100.0 * drops / scoredFrames : 0.0;
+        score.meanFrameTimeUs = scoredFrames ? frameTimeSumUs / scoredFrames : 0.0;
+        score.score = m_config.stutterWeight * score.stutterPercent + m_config.latencyWeight * score.meanLatencyUs / 1000.0 +
+            m_config.dropWeight * score.dropPercent;
+        return score;
+    }
+
+private:
+    NvstPacingSimulatorConfig m_config;
+    NvstPacingTrace m_trace;
+};
+
+/// Candidate values of the PID search; every combination is simulated.
+/// \ingroup Video
+typedef struct NvstPacingSearchSpace_t
+{
+    const uint32_t* kP;
+    uint32_t kPCount;
+    const uint32_t* kI;
+    uint32_t kICount;
+    const uint32_t* kL;
+    uint32_t kLCount;
+    /// NULL keeps the base parameters' targetQueueTimeUs.
+    const uint32_t* targetQueueTimeUs;
+    uint32_t targetQueueTimeCount;
+} NvstPacingSearchSpace;
+
+/// Result of one candidate.
+typedef struct NvstPacingCandidate_t
+{
+    NvstPacingPidParams params;
+    NvstPacingScore score;
+} NvstPacingCandidate;
+
+/// Grid search over PID parameters, evaluated in parallel.
+/// \ingroup Video
+class NvstPacingTuner
+{
+public:
+    /// \param[in] simulator Simulator with the trace to tune for.
+    /// \param[in] threads Worker threads; 0 uses every core.
+    explicit NvstPacingTuner(const NvstPacingSimulator& simulator, uint32_t threads = 0)
+        : m_simulator(simulator)
+        , m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+    {
+    }
+
+    /// Simulate every combination of the search space on top of the base parameters.
+    /// \return All candidates, best (lowest score) first.
+    std::vector<NvstPacingCandidate> search(const NvstPacingPidParams& base, const NvstPacingSearchSpace& space) const
+    {
+        std::vector<NvstPacingCandidate> candidates;
+        const uint32_t queueCount = space.targetQueueTimeUs ? space.targetQueueTimeCount : 1;
+        for (uint32_t p = 0; p < space.kPCount; ++p)
+        {
+            for (uint32_t i = 0; i < space.kICount; ++i)
+            {
+                for (uint32_t l = 0; l < space.kLCount; ++l)
+                {
+                    for (uint32_t q = 0; q < queueCount; ++q)
+                    {
+                        NvstPacingCandidate candidate = {};
+                        candidate.params = base;
+                        candidate.params.kP = space.kP[p];
+                        candidate.params.kI = space.kI[i];
+                        candidate.params.kL = space.kL[l];
+                        if (space.targetQueueTimeUs)
+                        {
+                            candidate.params.targetQueueTimeUs = space.targetQueueTimeUs[q];
+                        }
+                        candidates.push_back(candidate);
+                    }
+                }
+            }
+        }
+
+        // Workers take candidates off a shared counter; each writes only its own slots.
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> workers;
+        const uint32_t threads = static_cast<uint32_t>(std::min<size_t>(m_threads, candidates.size()));
+        for (uint32_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&] {
+                for (size_t index = next++; index < candidates.size(); index = next++)
+                {
+                    candidates[index].score = m_simulator.run(candidates[index].params);
+                }
+            });
+        }
+        for (std::thread& worker : workers)
+        {
+            worker.join();
+        }
+        std::stable_sort(candidates.begin(), candidates.end(),
+                         [](const NvstPacingCandidate& a, const NvstPacingCandidate& b) {
+                             return a.score.score < b.score.score;
+                         });
+        return candidates;
+    }
+
+    /// Search and write the best parameters and their score.
+    /// \return The best candidate; zeroed if the search space is empty.
+    NvstPacingCandidate searchAndPrint(FILE* file, const NvstPacingPidParams& base, const NvstPacingSearchSpace& space) const
+    {
+        const std::vector<NvstPacingCandidate> candidates = search(base, space);
+        if (candidates.empty())
+        {
+            return NvstPacingCandidate();
+        }
+        const NvstPacingCandidate& best = candidates.front();
+        fprintf(file, "# score %.3f: stutter %.2f%%, latency mean %.0f us p99 %.0f us, drops %.2f%% (%zu candidates)\n",
+                best.score.score, best.score.stutterPercent, best.score.meanLatencyUs, best.score.p99LatencyUs,
+                best.score.dropPercent, candidates.size());
+        nvstPacingPidPrint(file, best.params);
+        return best;
+    }
+
+private:
+    const NvstPacingSimulator& m_simulator;
+    uint32_t m_threads;
+};
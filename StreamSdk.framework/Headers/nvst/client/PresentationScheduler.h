@@ -0,0 +1,508 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file PresentationScheduler.h
+/// Reference presentation queue for timestamp based and adaptive queue rendering.
+///
+/// Decoded frames are submit()ted as they come out of the decoder, and onVsync()
+/// is called once per display refresh. The scheduler picks the frame to present,
+/// drops the ones that are no longer useful, and reports NVST_FS_RENDER_STARTED,
+/// NVST_FS_RENDER_COMPLETED and NVST_FS_RENDER_SKIPPED to the SDK. The queue
+/// targets come from NvstClientFramePacingStats, see updatePacing().
+///
+/// All times are passed in by the caller in microseconds on one clock, so the
+/// scheduler can be driven headless by NvstVirtualVsyncClock.
+
+#pragma once
+
+#include "StreamClient.h"
+#include "../common/Histogram.h"
+#include "../common/VideoDecodeUnit.h"
+
+#include <nvsc/TimeUtils.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/// How NvstPresentationScheduler picks frames.
+/// \ingroup Video
+typedef enum NvstPresentationMode_t
+{
+    /// Present the newest decoded frame at every vsync, drop the rest.
+    NVST_PRESENTATION_MODE_LATEST = 0,
+    /// enableTimestampRender: present a frame at the vsync closest to its server timestamp
+    /// mapped to the client clock, plus targetQueueTimeUs.
+    NVST_PRESENTATION_MODE_TIMESTAMP = 1,
+    /// enableAdaptiveQRender: present frames in order, one per vsync, keeping about
+    /// targetQueueTimeUs of them queued and dropping the ones queued beyond frameDropThresholdUs.
+    NVST_PRESENTATION_MODE_ADAPTIVE_QUEUE = 2,
+} NvstPresentationMode;
+
+/// Platform bits of the enableTimestampRender and enableAdaptiveQRender settings.
+enum
+{
+    NVST_RENDER_PLATFORM_WINDOWS = 1 << 2,
+    NVST_RENDER_PLATFORM_MACOS = 1 << 3,
+    NVST_RENDER_PLATFORM_LINUX = 1 << 4,
+    NVST_RENDER_PLATFORM_ANDROID = 1 << 5,
+    NVST_RENDER_PLATFORM_IOS = 1 << 6,
+};
+
+/// Interpret one of the per-platform render settings: 0 disables, 1 enables everywhere,
+/// any other value is a bit field of NVST_RENDER_PLATFORM_*.
+static inline bool nvstIsRenderSettingEnabled(uint16_t setting, uint16_t platformBit)
+{
+    return setting == 1 || (setting > 1 && (setting & platformBit) != 0);
+}
+
+/// Select the mode from NvscVideoSettings::enableTimestampRender and enableAdaptiveQRender;
+/// adaptive queue rendering takes precedence.
+static inline NvstPresentationMode nvstPresentationModeFromSettings(
+    uint16_t enableTimestampRender,
+    uint16_t enableAdaptiveQRender,
+    uint16_t platformBit)
+{
+    if (nvstIsRenderSettingEnabled(enableAdaptiveQRender, platformBit))
+    {
+        return NVST_PRESENTATION_MODE_ADAPTIVE_QUEUE;
+    }
+    if (nvstIsRenderSettingEnabled(enableTimestampRender, platformBit))
+    {
+        return NVST_PRESENTATION_MODE_TIMESTAMP;
+    }
+    return NVST_PRESENTATION_MODE_LATEST;
+}
+
+/// Present a frame.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] frame Frame as passed to submit().
+/// \param[in] vsyncUs Vsync the frame is presented at.
+typedef void (*NVST_PRESENT_FRAME_PROC)(void* context, void* frame, uint64_t vsyncUs);
+
+/// Take back a frame that will not be presented.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] frame Frame as passed to submit().
+typedef void (*NVST_DROP_FRAME_PROC)(void* context, void* frame);
+
+/// Configuration of NvstPresentationScheduler.
+/// \ingroup Video
+typedef struct NvstPresentationSchedulerConfig_t
+{
+    NvstPresentationMode mode;
+    /// Display refresh interval.
+    uint32_t vsyncIntervalUs;
+    /// Initial targets until updatePacing() is called.
+    uint32_t targetQueueTimeUs;
+    uint32_t frameDropThresholdUs;
+    /// TIMESTAMP mode maps server timestamps to the client clock by the smallest
+    /// arrival - timestamp difference seen. The estimate is allowed to rise by this much
+    /// per frame so it follows clock drift and route changes.
+    uint32_t offsetRelaxUsPerFrame;
+    /// Most frames held; the oldest is dropped beyond that.
+    uint32_t maxQueuedFrames;
+    /// Called with the frame selected at a vsync.
+    NVST_PRESENT_FRAME_PROC presentProc;
+    /// Called with every dropped frame. May be NULL if frames need no release.
+    NVST_DROP_FRAME_PROC dropProc;
+    /// Passed to both procs.
+    void* context;
+    /// Client the states are reported to; reporting is skipped while it is NULL.
+    NvstClient client;
+    /// Function used to report states. Defaults to nvstUpdateStats.
+    CLIENT_UPDATE_STATS updateStatsProc;
+} NvstPresentationSchedulerConfig;
+
+/// Default configuration: latest-frame mode at 60 Hz with 8 ms queue target and 50 ms drop threshold.
+static inline void nvstPresentationSchedulerGetDefaultConfig(NvstPresentationSchedulerConfig* config)
+{
+    config->mode = NVST_PRESENTATION_MODE_LATEST;
+    config->vsyncIntervalUs = 16667;
+    config->targetQueueTimeUs = 8000;
+    config->frameDropThresholdUs = 50000;
+    config->offsetRelaxUsPerFrame = 10;
+    config->maxQueuedFrames = 16;
+    config->presentProc = NULL;
+    config->dropProc = NULL;
+    config->context = NULL;
+    config->client = NULL;
+    config->updateStatsProc = nvstUpdateStats;
+}
+
+/// Counters of an NvstPresentationScheduler.
+/// \ingroup Video
+typedef struct NvstPresentationSchedulerStats_t
+{
+    /// Frames submitted.
+    uint64_t submitted;
+    /// Frames handed to presentProc.
+    uint64_t presented;
+    /// Frames dropped because a newer one was due at the same vsync.
+    uint64_t droppedSuperseded;
+    /// Frames dropped because they were queued longer than frameDropThresholdUs.
+    uint64_t droppedLate;
+    /// Frames dropped because the queue was full.
+    uint64_t droppedOverflow;
+    /// Vsyncs at which no frame was presented although frames had been presented before.
+    uint64_t repeatedVsyncs;
+} NvstPresentationSchedulerStats;
+
+/// Decides per vsync which decoded frame to present.
+///
+/// submit() and onVsync() may be called from different threads; the procs are called
+/// from onVsync(), submit() and flush() without internal locks held.
+/// \ingroup Video
+class NvstPresentationScheduler
+{
+public:
+    explicit NvstPresentationScheduler(const NvstPresentationSchedulerConfig& config)
+        : m_config(config)
+    {
+        m_targetQueueTimeUs = config.targetQueueTimeUs;
+        m_frameDropThresholdUs = config.frameDropThresholdUs;
+        if (!m_config.maxQueuedFrames)
+        {
+            m_config.maxQueuedFrames = 1;
+        }
+    }
+
+    ~NvstPresentationScheduler() { flush(); }
+
+    NvstPresentationScheduler(const NvstPresentationScheduler&) = delete;
+    NvstPresentationScheduler& operator=(const NvstPresentationScheduler&) = delete;
+
+    /// Take over the targets the SDK publishes, e.g. polled through nvstGetStats()
+    /// with NVST_GET_STATS_FRAME_PACING about once a second.
+    void updatePacing(const NvstClientFramePacingStats& pacing)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_targetQueueTimeUs = pacing.targetQueueTimeUs;
+        if (pacing.frameDropThresholdUs)
+        {
+            m_frameDropThresholdUs = pacing.frameDropThresholdUs;
+        }
+    }
+
+    /// Change the display refresh interval, e.g. after a mode change.
+    void setVsyncInterval(uint32_t vsyncIntervalUs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_config.vsyncIntervalUs = vsyncIntervalUs;
+    }
+
+    /// Queue a decoded frame.
+    /// \param[in] vdu Decode unit the frame came from; frameNumber, streamIndex,
+    /// timeStampUs and streamSizeBytes are used.
+    /// \param[in] frame Application handle passed to the procs.
+    /// \param[in] arrivalUs Time the frame finished decoding.
+    void submit(const NvstVideoDecodeUnit& vdu, void* frame, uint64_t arrivalUs)
+    {
+        Frame queued;
+        queued.frame = frame;
+        queued.frameNumber = vdu.frameNumber;
+        queued.streamIndex = vdu.streamIndex;
+        queued.frameSize = static_cast<uint32_t>(vdu.streamSizeBytes);
+        queued.timestampUs = vdu.timeStampUs;
+        queued.arrivalUs = arrivalUs;
+
+        Frame overflow;
+        bool overflowed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            const int64_t offset = static_cast<int64_t>(arrivalUs) - static_cast<int64_t>(vdu.timeStampUs);
+            if (!m_haveOffset || offset < m_offsetUs)
+            {
+                m_offsetUs = offset;
+                m_haveOffset = true;
+            }
+            else
+            {
+                m_offsetUs += m_config.offsetRelaxUsPerFrame;
+            }
+            if (m_queue.size() >= m_config.maxQueuedFrames)
+            {
+                overflow = m_queue.front();
+                m_queue.pop_front();
+                overflowed = true;
+                ++m_stats.droppedOverflow;
+            }
+            m_queue.push_back(queued);
+            ++m_stats.submitted;
+        }
+        if (overflowed)
+        {
+            drop(overflow);
+        }
+    }
+
+    /// Present at most one frame for this vsync and drop the frames that became useless.
+    /// \param[in] vsyncUs Time of the vsync.
+    /// \return true if a frame was presented.
+    bool onVsync(uint64_t vsyncUs)
+    {
+        std::vector<Frame> dropped;
+        Frame presented;
+        bool present = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            present = selectLocked(vsyncUs, &presented, &dropped);
+            if (present)
+            {
+                ++m_stats.presented;
+                m_presentedAny = true;
+                m_queueTimeUs.record(vsyncUs > presented.arrivalUs ? vsyncUs - presented.arrivalUs : 0);
+            }
+            else if (m_presentedAny)
+            {
+                ++m_stats.repeatedVsyncs;
+            }
+        }
+        for (const Frame& frame : dropped)
+        {
+            drop(frame);
+        }
+        if (present)
+        {
+            report(presented, NVST_FS_RENDER_STARTED, 0, 0);
+            const int64_t beginNs = nvstGetTimeNs();
+            if (m_config.presentProc)
+            {
+                m_config.presentProc(m_config.context, presented.frame, vsyncUs);
+            }
+            const double processTimeMs = static_cast<double>(nvstGetTimeNs() - beginNs) / 1e6;
+            const uint64_t latencyUs = vsyncUs > presented.arrivalUs ? vsyncUs - presented.arrivalUs : 0;
+            report(presented, NVST_FS_RENDER_COMPLETED, processTimeMs, latencyUs / 1000);
+        }
+        return present;
+    }
+
+    /// Drop every queued frame, e.g. when the stream stops.
+    void flush()
+    {
+        std::deque<Frame> queue;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            queue.swap(m_queue);
+        }
+        for (const Frame& frame : queue)
+        {
+            drop(frame);
+        }
+    }
+
+    /// \return Number of frames waiting.
+    size_t queuedFrames() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_queue.size();
+    }
+
+    /// Time from submit() to the presenting vsync of presented frames, in microseconds.
+    /// Read it from the thread calling onVsync().
+    const NvstHistogram& queueTimeHistogram() const { return m_queueTimeUs; }
+
+    NvstPresentationSchedulerStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    struct Frame
+    {
+        void* frame = nullptr;
+        uint32_t frameNumber = 0;
+        uint16_t streamIndex = 0;
+        uint32_t frameSize = 0;
+        uint64_t timestampUs = 0;
+        uint64_t arrivalUs = 0;
+    };
+
+    bool selectLocked(uint64_t vsyncUs, Frame* presented, std::vector<Frame>* dropped)
+    {
+        if (m_queue.empty())
+        {
+            return false;
+        }
+        const uint64_t halfVsyncUs = m_config.vsyncIntervalUs / 2;
+        size_t pick = m_queue.size();
+        switch (m_config.mode)
+        {
+        case NVST_PRESENTATION_MODE_LATEST:
+            pick = m_queue.size() - 1;
+            break;
+        case NVST_PRESENTATION_MODE_TIMESTAMP:
+            // Newest frame due by the middle of the coming refresh interval.
+            for (size_t i = 0; i < m_queue.size(); ++i)
+            {
+                const int64_t dueUs = static_cast<int64_t>(m_queue[i].timestampUs) + m_offsetUs + m_targetQueueTimeUs;
+                if (dueUs <= static_cast<int64_t>(vsyncUs + halfVsyncUs))
+                {
+                    pick = i;
+                }
+            }
+            break;
+        case NVST_PRESENTATION_MODE_ADAPTIVE_QUEUE:
+        {
+            // Catch up past frames queued too long as long as newer ones exist.
+            size_t first = 0;
+            while (first + 1 < m_queue.size() && queuedUs(m_queue[first], vsyncUs) > m_frameDropThresholdUs)
+            {
+                ++first;
+            }
+            // Hold a lone frame until it has been queued for the target time; with a backlog
+            // the queue already absorbs the arrival jitter.
+            if (first + 1 < m_queue.size() || queuedUs(m_queue[first], vsyncUs) + halfVsyncUs >= m_targetQueueTimeUs)
+            {
+                pick = first;
+            }
+            else if (first)
+            {
+                // Late frames are dropped even when the newest one isn't due yet.
+                takeDropped(first, &m_stats.droppedLate, dropped);
+            }
+            break;
+        }
+        }
+        if (pick == m_queue.size())
+        {
+            return false;
+        }
+        // Everything older than the pick is superseded or late.
+        for (size_t i = 0; i < pick; ++i)
+        {
+            if (queuedUs(m_queue.front(), vsyncUs) > m_frameDropThresholdUs)
+            {
+                ++m_stats.droppedLate;
+            }
+            else
+            {
+                ++m_stats.droppedSuperseded;
+            }
+            dropped->push_back(m_queue.front());
+            m_queue.pop_front();
+        }
+        *presented = m_queue.front();
+        m_queue.pop_front();
+        return true;
+    }
+
+    void takeDropped(size_t count, uint64_t* counter, std::vector<Frame>* dropped)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            dropped->push_back(m_queue.front());
+            m_queue.pop_front();
+            ++*counter;
+        }
+    }
+
+    static uint64_t queuedUs(const Frame& frame, uint64_t nowUs)
+    {
+        return nowUs > frame.arrivalUs ? nowUs - frame.arrivalUs : 0;
+    }
+
+    void drop(const Frame& frame)
+    {
+        report(frame, NVST_FS_RENDER_SKIPPED, 0, 0);
+        if (m_config.dropProc)
+        {
+            m_config.dropProc(m_config.context, frame.frame);
+        }
+    }
+
+    void report(const Frame& frame, NvstVideoFrameState state, double processTimeMs, uint64_t displayLatencyMs)
+    {
+        if (!m_config.updateStatsProc || !m_config.client)
+        {
+            return;
+        }
+        NvstClientUpdateStats update = {};
+        update.statsId = NVST_UPDATE_STATS_VIDEO_FRAME;
+        NvstClientVideoFrameStats& stats = update.videoFrameStats;
+        stats.streamIndex = frame.streamIndex;
+        stats.frameNumber = frame.frameNumber;
+        stats.state = state;
+        stats.processTimeMs = processTimeMs;
+        stats.frameSize = frame.frameSize;
+        stats.displayLatencyMs = displayLatencyMs;
+        m_config.updateStatsProc(m_config.client, &update);
+    }
+
+    NvstPresentationSchedulerConfig m_config;
+    mutable std::mutex m_mutex;
+    std::deque<Frame> m_queue;
+    uint32_t m_targetQueueTimeUs;
+    uint32_t m_frameDropThresholdUs;
+    int64_t m_offsetUs = 0;
+    bool m_haveOffset = false;
+    bool m_presentedAny = false;
+    NvstHistogram m_queueTimeUs;
+    NvstPresentationSchedulerStats m_stats = {};
+};
+
+/// Headless vsync source for driving NvstPresentationScheduler in tests and simulations.
+///
+/// Produces vsync times on a virtual clock with optional deterministic jitter,
+/// without sleeping. Call setInterval() to model a display whose rate differs
+/// from the stream's.
+/// \ingroup Video
+class NvstVirtualVsyncClock
+{
+public:
+    /// \param[in] intervalUs Nominal refresh interval.
+    /// \param[in] startUs Time of the first vsync.
+    /// \param[in] jitterUs Each vsync is displaced by up to +-jitterUs.
+    /// \param[in] seed Seed of the jitter sequence.
+    NvstVirtualVsyncClock(uint32_t intervalUs, uint64_t startUs = 0, uint32_t jitterUs = 0, uint64_t seed = 1)
+        : m_intervalUs(intervalUs)
+        , m_nominalUs(startUs)
+        , m_jitterUs(jitterUs)
+        , m_state(seed)
+    {
+    }
+
+    /// \return Time of the next vsync; advances the clock by one interval.
+    uint64_t next()
+    {
+        uint64_t vsyncUs = m_nominalUs;
+        if (m_jitterUs)
+        {
+            const int64_t offset = static_cast<int64_t>(random() % (2ull * m_jitterUs + 1)) - m_jitterUs;
+            vsyncUs = static_cast<uint64_t>(static_cast<int64_t>(vsyncUs) + offset);
+        }
+        m_nominalUs += m_intervalUs;
+        return vsyncUs;
+    }
+
+    /// \return Nominal time of the vsync next() returns next.
+    uint64_t peek() const { return m_nominalUs; }
+
+    /// Change the interval from the next vsync on.
+    void setInterval(uint32_t intervalUs) { m_intervalUs = intervalUs; }
+
+private:
+    uint64_t random()
+    {
+        // splitmix64
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    uint32_t m_intervalUs;
+    uint64_t m_nominalUs;
+    uint32_t m_jitterUs;
+    uint64_t m_state;
+};
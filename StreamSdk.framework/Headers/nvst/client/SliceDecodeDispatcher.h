@@ -0,0 +1,344 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file SliceDecodeDispatcher.h
+/// Parallel decoding of multi-slice frames as their slices arrive.
+///
+/// With NvstClientVideoQosSetting::videoSliceDecodeMultithreaded the server
+/// encodes slicesPerFrame independently decodable slices, and the SDK hands
+/// each one over as an NVST_VU_SLICE decode unit. NvstSliceDecodeDispatcher
+/// fans the slices out to a worker pool while the rest of the frame is still
+/// being received, tracks completion per frame, and reports the frame through
+/// nvstUpdateStats once its last slice is decoded.
+
+#pragma once
+
+#include "StreamClient.h"
+#include "../common/VideoDecodeUnit.h"
+
+#include <nvsc/TimeUtils.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Decode one slice (or one whole frame for NVST_VU_FRAME units).
+/// Called on a worker thread; slices of the same frame may be decoded concurrently.
+/// The dispatcher releases the VDU after this returns.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] vdu Unit to decode.
+/// \return true if the unit was decoded successfully.
+typedef bool (*NVST_DECODE_SLICE_PROC)(void* context, const NvstVideoDecodeUnit* vdu);
+
+/// Notification that every slice of a frame has been decoded (or the frame failed).
+/// Called on a worker thread after the stats were reported, e.g. to queue the frame for rendering.
+typedef void (*NVST_FRAME_DECODED_PROC)(void* context, uint16_t streamIndex, uint32_t frameNumber, bool success);
+
+/// Configuration of NvstSliceDecodeDispatcher.
+/// \ingroup Video
+typedef struct NvstSliceDecodeDispatcherConfig_t
+{
+    /// Number of decode threads; normally NvstClientVideoQosSetting::slicesPerFrame.
+    uint32_t workerCount;
+    /// Decodes a single unit. Required.
+    NVST_DECODE_SLICE_PROC decodeProc;
+    /// Optional completion notification.
+    NVST_FRAME_DECODED_PROC frameDecodedProc;
+    /// Passed to decodeProc and frameDecodedProc.
+    void* context;
+    /// Client the frame states are reported to. NULL disables reporting.
+    NvstClient client;
+    /// Function used to report frame states. Defaults to nvstUpdateStats.
+    CLIENT_UPDATE_STATS updateStatsProc;
+    /// A frame with no slice queued or decoding fails once this long has passed since its first
+    /// slice arrived. 0 waits until a newer frame of the stream completes.
+    uint32_t sliceTimeoutMs;
+} NvstSliceDecodeDispatcherConfig;
+
+/// Counters of an NvstSliceDecodeDispatcher.
+/// \ingroup Video
+typedef struct NvstSliceDecodeDispatcherStats_t
+{
+    /// Units handed to decodeProc.
+    uint64_t unitsDecoded;
+    /// Frames reported as NVST_FS_DECODE_COMPLETED.
+    uint64_t framesCompleted;
+    /// Frames reported as NVST_FS_DECODE_FAILED, because a slice failed or was never received.
+    uint64_t framesFailed;
+    /// Units rejected because their frame was already reported.
+    uint64_t lateUnits;
+} NvstSliceDecodeDispatcherStats;
+
+/// Worker pool decoding the slices of a frame in parallel.
+///
+/// submit() only queues the unit, so it is cheap enough to call from
+/// DECODE_VU_PROC / onVideoReceived directly. Frames complete in any order.
+/// Once a newer frame of a stream has completed, an older frame still missing
+/// slices is reported as failed as soon as none of its received slices is queued
+/// or decoding, since the missing ones were lost; sliceTimeoutMs fails such
+/// frames earlier. Every frame is reported once: units of a frame that was
+/// already reported, or older than the newest reported frame of its stream
+/// without having been seen, are rejected.
+/// \ingroup Video
+class NvstSliceDecodeDispatcher
+{
+public:
+    explicit NvstSliceDecodeDispatcher(const NvstSliceDecodeDispatcherConfig& config)
+        : m_config(config)
+    {
+        if (!m_config.updateStatsProc)
+        {
+            m_config.updateStatsProc = nvstUpdateStats;
+        }
+        const uint32_t workers = m_config.workerCount ? m_config.workerCount : 1;
+        for (uint32_t i = 0; i < workers; ++i)
+        {
+            m_workers.emplace_back(&NvstSliceDecodeDispatcher::workerLoop, this);
+        }
+    }
+
+    /// Finishes the queued units, then stops the workers. Frames still missing slices are not reported.
+    ~NvstSliceDecodeDispatcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_condition.notify_all();
+        for (std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    NvstSliceDecodeDispatcher(const NvstSliceDecodeDispatcher&) = delete;
+    NvstSliceDecodeDispatcher& operator=(const NvstSliceDecodeDispatcher&) = delete;
+
+    /// Queue a unit for decoding and take ownership of it.
+    /// \return false if the unit is NULL, malformed (no slices, slice index out of range) or
+    /// belongs to a frame that was already reported; it is released.
+    bool submit(const NvstVideoDecodeUnit* vdu)
+    {
+        if (!vdu)
+        {
+            return false;
+        }
+        const bool isSlice = vdu->vduType == NVST_VU_SLICE;
+        const uint32_t slices = isSlice ? vdu->slicesInFrame : 1;
+        if (!m_config.decodeProc || slices == 0 || (isSlice && vdu->sliceIndex >= slices))
+        {
+            release(vdu);
+            return false;
+        }
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            const Key key(vdu->streamIndex, vdu->frameNumber);
+            std::map<Key, Frame>::iterator it = m_frames.find(key);
+            if (it == m_frames.end())
+            {
+                std::map<uint16_t, uint32_t>::const_iterator reported = m_lastReported.find(key.first);
+                if (reported != m_lastReported.end() && key.second <= reported->second)
+                {
+                    ++m_stats.lateUnits;
+                    lock.unlock();
+                    release(vdu);
+                    return false;
+                }
+                Frame frame;
+                frame.slices = slices;
+                frame.firstArrivalNs = nvstGetTimeNs();
+                it = m_frames.insert(std::make_pair(key, frame)).first;
+            }
+            ++it->second.inFlight;
+            m_queue.push_back(vdu);
+        }
+        m_condition.notify_one();
+        return true;
+    }
+
+    NvstSliceDecodeDispatcherStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    /// (streamIndex, frameNumber); frame numbers of a stream increase monotonically.
+    typedef std::pair<uint16_t, uint32_t> Key;
+
+    struct Frame
+    {
+        /// Slices of the frame, received or not.
+        uint32_t slices = 0;
+        /// Slices decoded or failed.
+        uint32_t finished = 0;
+        /// Slices queued or decoding.
+        uint32_t inFlight = 0;
+        uint32_t sizeBytes = 0;
+        bool failed = false;
+        /// A newer frame of the stream completed, so slices still missing were lost.
+        bool superseded = false;
+        int64_t firstArrivalNs = 0;
+    };
+
+    struct Report
+    {
+        Key key;
+        bool success;
+        double processTimeMs;
+        uint32_t sizeBytes;
+    };
+
+    static void release(const NvstVideoDecodeUnit* vdu)
+    {
+        if (vdu->releaseProc)
+        {
+            vdu->releaseProc(vdu);
+        }
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_condition.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+            {
+                return;
+            }
+            const NvstVideoDecodeUnit* vdu = m_queue.front();
+            m_queue.pop_front();
+            lock.unlock();
+
+            const Key key(vdu->streamIndex, vdu->frameNumber);
+            const uint32_t sizeBytes = vdu->streamSizeBytes;
+            const bool success = m_config.decodeProc(m_config.context, vdu);
+            release(vdu);
+
+            lock.lock();
+            ++m_stats.unitsDecoded;
+            std::vector<Report> reports;
+            collectReports(key, success, sizeBytes, reports);
+            lock.unlock();
+
+            for (const Report& report : reports)
+            {
+                notify(report);
+            }
+            lock.lock();
+        }
+    }
+
+    /// Account a finished unit; gathers the frames that are now complete or can no longer complete.
+    void collectReports(const Key& key, bool success, uint32_t sizeBytes, std::vector<Report>& reports)
+    {
+        const int64_t nowNs = nvstGetTimeNs();
+        std::map<Key, Frame>::iterator it = m_frames.find(key);
+        if (it != m_frames.end())
+        {
+            Frame& frame = it->second;
+            frame.sizeBytes += sizeBytes;
+            frame.failed = frame.failed || !success;
+            ++frame.finished;
+            --frame.inFlight;
+            if (frame.finished >= frame.slices)
+            {
+                // Older frames of the same stream won't receive their missing slices anymore.
+                for (std::map<Key, Frame>::iterator older = m_frames.lower_bound(Key(key.first, 0)); older != it;
+                     ++older)
+                {
+                    older->second.superseded = true;
+                }
+                reportLocked(it, !frame.failed, nowNs, reports);
+            }
+        }
+
+        const int64_t timeoutNs = static_cast<int64_t>(m_config.sliceTimeoutMs) * 1000000;
+        for (std::map<Key, Frame>::iterator frame = m_frames.begin(); frame != m_frames.end();)
+        {
+            const bool idle = frame->second.inFlight == 0;
+            const bool expired = timeoutNs && nowNs - frame->second.firstArrivalNs > timeoutNs;
+            if (idle && (frame->second.superseded || expired))
+            {
+                frame = reportLocked(frame, false, nowNs, reports);
+            }
+            else
+            {
+                ++frame;
+            }
+        }
+    }
+
+    /// Queue the report of a frame and forget it.
+    std::map<Key, Frame>::iterator reportLocked(std::map<Key, Frame>::iterator frame, bool success, int64_t nowNs,
+                                                std::vector<Report>& reports)
+    {
+        const Key key = frame->first;
+        const double processTimeMs = static_cast<double>(nowNs - frame->second.firstArrivalNs) / 1e6;
+        Report report = {key, success, processTimeMs, frame->second.sizeBytes};
+        reports.push_back(report);
+        ++(success ? m_stats.framesCompleted : m_stats.framesFailed);
+        std::map<uint16_t, uint32_t>::iterator reported = m_lastReported.find(key.first);
+        if (reported == m_lastReported.end())
+        {
+            m_lastReported.insert(std::make_pair(key.first, key.second));
+        }
+        else if (key.second > reported->second)
+        {
+            reported->second = key.second;
+        }
+        return m_frames.erase(frame);
+    }
+
+    void notify(const Report& report)
+    {
+        if (m_config.client)
+        {
+            NvstClientUpdateStats stats = {};
+            stats.statsId = NVST_UPDATE_STATS_VIDEO_FRAME;
+            stats.videoFrameStats.streamIndex = report.key.first;
+            stats.videoFrameStats.frameNumber = report.key.second;
+            stats.videoFrameStats.state = report.success ? NVST_FS_DECODE_COMPLETED : NVST_FS_DECODE_FAILED;
+            stats.videoFrameStats.processTimeMs = report.processTimeMs;
+            stats.videoFrameStats.frameSize = report.sizeBytes;
+            m_config.updateStatsProc(m_config.client, &stats);
+        }
+        if (m_config.frameDecodedProc)
+        {
+            m_config.frameDecodedProc(m_config.context, report.key.first, report.key.second, report.success);
+        }
+    }
+
+    NvstSliceDecodeDispatcherConfig m_config;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<const NvstVideoDecodeUnit*> m_queue;
+    /// Frames with slices in flight or still to arrive.
+    std::map<Key, Frame> m_frames;
+    /// Newest reported frame number per stream.
+    std::map<uint16_t, uint32_t> m_lastReported;
+    NvstSliceDecodeDispatcherStats m_stats = {};
+    bool m_stop = false;
+    std::vector<std::thread> m_workers;
+};
+
+/// DECODE_VU_PROC that submits to the NvstSliceDecodeDispatcher given as userData.
+static inline void nvstSliceDecodeDispatcherDecodeProc(void* userData, const NvstVideoDecodeUnit* vdu)
+{
+    static_cast<NvstSliceDecodeDispatcher*>(userData)->submit(vdu);
+}
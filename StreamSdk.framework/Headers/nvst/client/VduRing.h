@@ -0,0 +1,290 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file VduRing.h
+/// Handoff of decode units from the SDK receive thread to a decoder thread.
+///
+/// onVideoReceived and DECODE_VU_PROC run on an SDK network thread; any
+/// blocking there stalls packet reception. NvstVduRing takes ownership of the
+/// VDU in a wait-free push, and the decoder thread pops it, sleeping on a
+/// futex (Linux) or a condition variable (elsewhere) while the ring is empty.
+/// The VDU's releaseProc is deferred until the decoder is done with it.
+
+#pragma once
+
+#include "../common/StreamConfig.h"
+#include "../common/VideoDecodeUnit.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+
+#if defined(__linux__)
+#include <climits>
+#include <ctime>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+/// Counters of an NvstVduRing.
+/// \ingroup Video
+typedef struct NvstVduRingStats_t
+{
+    /// VDUs accepted by push().
+    uint64_t pushed;
+    /// VDUs returned by pop().
+    uint64_t popped;
+    /// VDUs released immediately because the ring was full.
+    uint64_t overflows;
+    /// Times the producer had to wake a sleeping consumer.
+    uint64_t wakeups;
+    /// Largest number of VDUs queued at once.
+    uint32_t highWatermark;
+} NvstVduRingStats;
+
+/// Bounded single-producer single-consumer ring of decode units.
+///
+/// push() never blocks and never makes a system call unless the consumer is
+/// asleep. When the ring is full the incoming VDU is released at once and
+/// counted as an overflow; the decoder should then expect a broken reference
+/// chain until the next I-frame, exactly as with network loss.
+/// \note push() must be called from one thread at a time (one ring per video
+/// stream), and pop() from one decoder thread.
+/// \ingroup Video
+class NvstVduRing
+{
+public:
+    /// \param[in] capacity Maximum number of queued VDUs; rounded up to a power of two.
+    explicit NvstVduRing(uint32_t capacity = 64)
+    {
+        uint32_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots.reset(new const NvstVideoDecodeUnit*[size]());
+    }
+
+    /// Releases every VDU still queued.
+    ~NvstVduRing()
+    {
+        const NvstVideoDecodeUnit* vdu;
+        while ((vdu = tryPop()) != nullptr)
+        {
+            release(vdu);
+        }
+    }
+
+    NvstVduRing(const NvstVduRing&) = delete;
+    NvstVduRing& operator=(const NvstVduRing&) = delete;
+
+    /// Take ownership of a VDU. Called from the SDK receive thread; never blocks.
+    /// \return false if the ring was full or closed; the VDU has been released in that case.
+    bool push(const NvstVideoDecodeUnit* vdu)
+    {
+        const uint32_t tail = m_tail.load(std::memory_order_relaxed);
+        if (m_closed.load(std::memory_order_relaxed) || tail - m_cachedHead > m_mask)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (m_closed.load(std::memory_order_relaxed) || tail - m_cachedHead > m_mask)
+            {
+                m_overflows.fetch_add(1, std::memory_order_relaxed);
+                release(vdu);
+                return false;
+            }
+        }
+        m_slots[tail & m_mask] = vdu;
+        m_tail.store(tail + 1, std::memory_order_release);
+        m_pushed.fetch_add(1, std::memory_order_relaxed);
+
+        // The cached head lags the consumer, so its depth is only an upper bound; refresh it
+        // before raising the watermark.
+        const uint32_t watermark = m_highWatermark.load(std::memory_order_relaxed);
+        if (tail + 1 - m_cachedHead > watermark)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            const uint32_t depth = tail + 1 - m_cachedHead;
+            if (depth > watermark)
+            {
+                m_highWatermark.store(depth, std::memory_order_relaxed);
+            }
+        }
+        wakeConsumer();
+        return true;
+    }
+
+    /// Take the oldest VDU without waiting.
+    /// \return The VDU, now owned by the caller, or NULL if the ring is empty.
+    const NvstVideoDecodeUnit* tryPop()
+    {
+        const uint32_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+        {
+            return nullptr;
+        }
+        const NvstVideoDecodeUnit* vdu = m_slots[head & m_mask];
+        m_head.store(head + 1, std::memory_order_release);
+        m_popped.fetch_add(1, std::memory_order_relaxed);
+        return vdu;
+    }
+
+    /// Take the oldest VDU, waiting up to timeoutUs for one to arrive.
+    /// \return The VDU, now owned by the caller (hand it to release() when done),
+    /// or NULL on timeout or once the ring is closed and drained.
+    const NvstVideoDecodeUnit* pop(uint64_t timeoutUs)
+    {
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + std::chrono::microseconds(timeoutUs);
+        for (;;)
+        {
+            const uint32_t sequence = m_sequence.load(std::memory_order_acquire);
+            const NvstVideoDecodeUnit* vdu = tryPop();
+            if (vdu || m_closed.load(std::memory_order_acquire))
+            {
+                return vdu;
+            }
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+            if (now >= deadline)
+            {
+                return nullptr;
+            }
+
+            m_consumerWaiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_sequence.load(std::memory_order_relaxed) == sequence)
+            {
+                waitForSequence(sequence, deadline - now);
+            }
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /// Hand a VDU back to the SDK through its releaseProc.
+    static void release(const NvstVideoDecodeUnit* vdu)
+    {
+        if (vdu && vdu->releaseProc)
+        {
+            vdu->releaseProc(vdu);
+        }
+    }
+
+    /// Reject further pushes and wake the consumer. VDUs already queued can still be popped.
+    void close()
+    {
+        m_closed.store(true, std::memory_order_release);
+        m_sequence.fetch_add(1, std::memory_order_release);
+        wake();
+    }
+
+    /// \return Number of VDUs currently queued.
+    uint32_t size() const
+    {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+    NvstVduRingStats getStats() const
+    {
+        NvstVduRingStats stats;
+        stats.pushed = m_pushed.load(std::memory_order_relaxed);
+        stats.popped = m_popped.load(std::memory_order_relaxed);
+        stats.overflows = m_overflows.load(std::memory_order_relaxed);
+        stats.wakeups = m_wakeups.load(std::memory_order_relaxed);
+        stats.highWatermark = m_highWatermark.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    void wakeConsumer()
+    {
+        m_sequence.fetch_add(1, std::memory_order_release);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_consumerWaiting.load(std::memory_order_relaxed))
+        {
+            m_wakeups.fetch_add(1, std::memory_order_relaxed);
+            wake();
+        }
+    }
+
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex needs a plain 32-bit word");
+
+    void waitForSequence(uint32_t sequence, std::chrono::steady_clock::duration timeout)
+    {
+        const int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+        struct timespec relative;
+        relative.tv_sec = static_cast<time_t>(ns / 1000000000);
+        relative.tv_nsec = static_cast<long>(ns % 1000000000);
+        syscall(SYS_futex, futexWord(), FUTEX_WAIT_PRIVATE, sequence, &relative, nullptr, 0);
+    }
+
+    void wake() { syscall(SYS_futex, futexWord(), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0); }
+
+    uint32_t* futexWord() { return reinterpret_cast<uint32_t*>(&m_sequence); }
+#else
+    void waitForSequence(uint32_t sequence, std::chrono::steady_clock::duration timeout)
+    {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wakeCondition.wait_for(
+            lock, timeout, [&] { return m_sequence.load(std::memory_order_relaxed) != sequence; });
+    }
+
+    void wake()
+    {
+        // Taking the mutex orders the notification after the consumer's predicate check.
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+        }
+        m_wakeCondition.notify_all();
+    }
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+#endif
+
+    uint32_t m_mask = 0;
+    std::unique_ptr<const NvstVideoDecodeUnit*[]> m_slots;
+
+    // Consumer side.
+    alignas(64) std::atomic<uint32_t> m_head{0};
+
+    // Producer side.
+    alignas(64) std::atomic<uint32_t> m_tail{0};
+    uint32_t m_cachedHead = 0;
+
+    alignas(64) std::atomic<uint32_t> m_sequence{0};
+    std::atomic<bool> m_consumerWaiting{false};
+    std::atomic<bool> m_closed{false};
+
+    std::atomic<uint64_t> m_pushed{0};
+    std::atomic<uint64_t> m_popped{0};
+    std::atomic<uint64_t> m_overflows{0};
+    std::atomic<uint64_t> m_wakeups{0};
+    std::atomic<uint32_t> m_highWatermark{0};
+};
+
+/// DECODE_VU_PROC that pushes into the NvstVduRing given as userData.
+static inline void nvstVduRingDecodeProc(void* userData, const NvstVideoDecodeUnit* vdu)
+{
+    static_cast<NvstVduRing*>(userData)->push(vdu);
+}
+
+/// NvstVideoReceiverStreamConfig::onVideoReceived that pushes into the NvstVduRing given as context.
+static inline void nvstVduRingOnVideoReceived(void* context, NvstStreamConnection, const NvstVideoDecodeUnit* vdu)
+{
+    static_cast<NvstVduRing*>(context)->push(vdu);
+}
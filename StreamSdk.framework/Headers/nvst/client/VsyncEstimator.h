@@ -0,0 +1,388 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file VsyncEstimator.h
+/// Phase-locked estimation of the display vsync interval from present timestamps.
+///
+/// Present timestamps are noisy, and presents skip vsyncs when frames are late,
+/// so the interval between two of them says little about the display. The
+/// estimator tracks the phase (time of a vsync) and interval of the display with
+/// a two-state Kalman filter: each present is attributed to the nearest predicted
+/// vsync, and the difference to the prediction corrects both states. Presents
+/// too far from any predicted vsync are discarded; a run of them relocks on the
+/// new timing, e.g. after a display mode change.
+///
+/// Once locked, the interval is reported through NVST_RUNTIME_PARAM_VSYNC_INTERVAL
+/// whenever it moves by more than a threshold. The same estimate suits
+/// nvstVirtualVsyncSetActualStreamingIntervals(). nextVsyncUs() and
+/// onFrameArrival() expose the phase, so pacing can aim frame arrival just
+/// before the vsync that presents the frame.
+
+#pragma once
+
+#include "StreamClient.h"
+#include "../common/Histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <mutex>
+
+/// Configuration of NvstVsyncEstimator.
+/// \ingroup Video
+typedef struct NvstVsyncEstimatorConfig_t
+{
+    /// Interval assumed until the estimate converges, e.g. the refresh rate the display reports.
+    uint32_t nominalIntervalUs;
+    /// Range of plausible intervals.
+    uint32_t minIntervalUs;
+    uint32_t maxIntervalUs;
+    /// Standard deviation of the present timestamp noise.
+    uint32_t measurementNoiseUs;
+    /// Standard deviation of the random walk of the vsync phase and interval per vsync.
+    uint32_t phaseNoiseUs;
+    uint32_t intervalNoiseNs;
+    /// Presents further than this percentage of the interval from the predicted vsync are outliers.
+    uint32_t outlierGatePercent;
+    /// Consecutive outliers after which the estimator relocks on the current timing.
+    uint32_t relockAfterOutliers;
+    /// The estimate is locked once its interval standard deviation is below this.
+    uint32_t lockStdDevNs;
+    /// A locked interval is reported when it differs from the last report by this much.
+    uint32_t reportThresholdUs;
+    /// Minimum time between reports.
+    uint32_t minReportIntervalMs;
+    /// Stream the interval is reported for.
+    uint16_t streamIndex;
+    /// Client reports are sent to; NULL disables sending.
+    NvstClient client;
+    /// Function used to send them. Defaults to nvstSetRuntimeParam; NULL disables sending.
+    SET_RUNTIME_PARAM setRuntimeParamProc;
+} NvstVsyncEstimatorConfig;
+
+/// Default configuration: 60 Hz nominal, 24 to 250 Hz range, 500 us timestamp noise.
+static inline void nvstVsyncEstimatorGetDefaultConfig(NvstVsyncEstimatorConfig* config)
+{
+    config->nominalIntervalUs = 16667;
+    config->minIntervalUs = 4000;
+    config->maxIntervalUs = 41667;
+    config->measurementNoiseUs = 500;
+    config->phaseNoiseUs = 2;
+    config->intervalNoiseNs = 5;
+    config->outlierGatePercent = 30;
+    config->relockAfterOutliers = 8;
+    config->lockStdDevNs = 500;
+    config->reportThresholdUs = 2;
+    config->minReportIntervalMs = 1000;
+    config->streamIndex = 0;
+    config->client = NULL;
+    config->setRuntimeParamProc = nvstSetRuntimeParam;
+}
+
+/// Current estimate of an NvstVsyncEstimator.
+/// \ingroup Video
+typedef struct NvstVsyncEstimate_t
+{
+    /// Estimated interval.
+    double intervalUs;
+    /// Standard deviation of the interval estimate.
+    double intervalStdDevUs;
+    /// Estimated time of the vsync of the last accepted present.
+    uint64_t lastVsyncUs;
+    /// Whether the estimate is locked.
+    bool locked;
+} NvstVsyncEstimate;
+
+/// Counters of an NvstVsyncEstimator.
+/// \ingroup Video
+typedef struct NvstVsyncEstimatorStats_t
+{
+    /// Presents seen.
+    uint64_t presents;
+    /// Presents discarded as outliers.
+    uint64_t outliers;
+    /// Relocks after a run of outliers.
+    uint64_t relocks;
+    /// Vsyncs without a present, i.e. repeated frames.
+    uint64_t skippedVsyncs;
+    /// Intervals sent through setRuntimeParamProc.
+    uint64_t reportsSent;
+    /// Interval of the last report.
+    uint32_t reportedIntervalUs;
+    /// Difference of the last accepted present to its predicted vsync.
+    int32_t phaseErrorUs;
+    /// RMS of that difference.
+    uint32_t phaseJitterUs;
+    /// Mean time from frame arrival to the next vsync, see onFrameArrival().
+    uint32_t arrivalLeadUs;
+} NvstVsyncEstimatorStats;
+
+/// Kalman phase and interval tracking of the display vsync.
+///
+/// onPresent() and the accessors may be called from different threads.
+/// \ingroup Video
+class NvstVsyncEstimator
+{
+public:
+    explicit NvstVsyncEstimator(const NvstVsyncEstimatorConfig& config)
+        : m_config(config)
+    {
+        if (!m_config.nominalIntervalUs)
+        {
+            m_config.nominalIntervalUs = 16667;
+        }
+        if (m_config.maxIntervalUs < m_config.minIntervalUs)
+        {
+            m_config.maxIntervalUs = m_config.minIntervalUs;
+        }
+    }
+
+    NvstVsyncEstimator(const NvstVsyncEstimator&) = delete;
+    NvstVsyncEstimator& operator=(const NvstVsyncEstimator&) = delete;
+
+    /// Account for a present and report the interval if it changed meaningfully.
+    /// \param[in] presentUs Time the frame was presented, e.g. from the swap chain statistics.
+    /// \return Result of setRuntimeParamProc, or NVST_R_SUCCESS if nothing was sent.
+    NvstResult onPresent(uint64_t presentUs)
+    {
+        uint32_t reportUs = 0;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.presents;
+            if (!m_initialized || presentUs < m_originUs)
+            {
+                // The nominal interval may be off by a fraction of a percent, e.g. 59.94 Hz for 60 Hz.
+                lockOnLocked(presentUs, m_config.nominalIntervalUs, m_config.nominalIntervalUs / 100.0);
+                return NVST_R_SUCCESS;
+            }
+            if (!trackLocked(static_cast<double>(presentUs - m_originUs)))
+            {
+                return NVST_R_SUCCESS;
+            }
+            reportUs = pendingReportLocked(presentUs);
+        }
+        return reportUs ? send(reportUs) : NVST_R_SUCCESS;
+    }
+
+    /// Time since a frame arrived until the vsync that can first present it; tracked in the stats.
+    /// \param[in] arrivalUs Time the frame was ready to present.
+    /// \return Lead of the arrival, or 0 before the first present.
+    uint32_t onFrameArrival(uint64_t arrivalUs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_initialized)
+        {
+            return 0;
+        }
+        const uint64_t leadUs = nextVsyncLocked(arrivalUs) - arrivalUs;
+        m_leadUs.record(leadUs);
+        m_meanLeadUs += (static_cast<double>(leadUs) - m_meanLeadUs) / 64.0;
+        m_stats.arrivalLeadUs = static_cast<uint32_t>(m_meanLeadUs);
+        return static_cast<uint32_t>(leadUs);
+    }
+
+    /// \return First predicted vsync at or after timeUs, or timeUs before the first present.
+    uint64_t nextVsyncUs(uint64_t timeUs) const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_initialized ? nextVsyncLocked(timeUs) : timeUs;
+    }
+
+    NvstVsyncEstimate getEstimate() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        NvstVsyncEstimate estimate = {};
+        estimate.intervalUs = m_intervalUs;
+        estimate.intervalStdDevUs = std::sqrt(m_p11);
+        estimate.lastVsyncUs = m_originUs + static_cast<uint64_t>(std::max(m_phaseUs, 0.0));
+        estimate.locked = m_locked;
+        return estimate;
+    }
+
+    /// Restart from a new nominal interval, e.g. after the display mode changed.
+    void reset(uint32_t nominalIntervalUs)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_config.nominalIntervalUs = nominalIntervalUs ? nominalIntervalUs : m_config.nominalIntervalUs;
+        m_initialized = false;
+        m_locked = false;
+    }
+
+    /// Arrival lead of every frame, in microseconds. Read it from the thread calling onFrameArrival().
+    const NvstHistogram& arrivalLeadHistogram() const { return m_leadUs; }
+
+    NvstVsyncEstimatorStats getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+private:
+    void lockOnLocked(uint64_t presentUs, double intervalUs, double intervalSpreadUs)
+    {
+        const double noiseUs = m_config.measurementNoiseUs;
+        m_originUs = presentUs;
+        m_phaseUs = 0.0;
+        m_intervalUs = intervalUs;
+        m_p00 = noiseUs * noiseUs;
+        m_p01 = 0.0;
+        m_p11 = intervalSpreadUs * intervalSpreadUs;
+        m_acceptedPresents = 0;
+        m_outlierRun = 0;
+        m_outlierRate = 0.0;
+        m_lastPresentUs = 0.0;
+        m_deltaCount = 0;
+        m_initialized = true;
+        m_locked = false;
+    }
+
+    /// \return True if the present was accepted.
+    bool trackLocked(double timeUs)
+    {
+        m_deltasUs[m_deltaCount++ % kDeltaHistory] = timeUs - m_lastPresentUs;
+        m_lastPresentUs = timeUs;
+
+        // Predict over the elapsed vsyncs: phase += n * interval, with process noise per vsync.
+        const double n = std::floor((timeUs - m_phaseUs) / m_intervalUs + 0.5);
+        const double phaseNoiseUs = m_config.phaseNoiseUs;
+        const double intervalNoiseUs = m_config.intervalNoiseNs / 1000.0;
+        const double predictedUs = m_phaseUs + n * m_intervalUs;
+        const double p00 = m_p00 + 2.0 * n * m_p01 + n * n * m_p11 + n * phaseNoiseUs * phaseNoiseUs;
+        const double p01 = m_p01 + n * m_p11;
+        const double p11 = m_p11 + n * intervalNoiseUs * intervalNoiseUs;
+
+        const double errorUs = timeUs - predictedUs;
+        const bool outlier = n < 1.0 || std::fabs(errorUs) > m_intervalUs * m_config.outlierGatePercent / 100.0;
+        m_outlierRate += ((outlier ? 1.0 : 0.0) - m_outlierRate) / 16.0;
+        if (outlier)
+        {
+            ++m_stats.outliers;
+            // A run of outliers is a new timing; a steady share of them is a multiple of the
+            // refresh rate locked onto a subharmonic.
+            if (++m_outlierRun >= m_config.relockAfterOutliers || m_outlierRate > 0.4)
+            {
+                relockLocked(timeUs);
+            }
+            return false;
+        }
+        m_outlierRun = 0;
+
+        const double noiseUs = m_config.measurementNoiseUs;
+        const double innovationVariance = p00 + noiseUs * noiseUs;
+        const double gainPhase = p00 / innovationVariance;
+        const double gainInterval = p01 / innovationVariance;
+        m_phaseUs = predictedUs + gainPhase * errorUs;
+        m_intervalUs = std::min<double>(std::max<double>(m_intervalUs + gainInterval * errorUs, m_config.minIntervalUs),
+                                        m_config.maxIntervalUs);
+        m_p00 = (1.0 - gainPhase) * p00;
+        m_p01 = (1.0 - gainPhase) * p01;
+        m_p11 = p11 - gainInterval * p01;
+
+        m_stats.skippedVsyncs += static_cast<uint64_t>(n) - 1;
+        m_stats.phaseErrorUs = static_cast<int32_t>(errorUs);
+        m_phaseVarianceUs += (errorUs * errorUs - m_phaseVarianceUs) / 64.0;
+        m_stats.phaseJitterUs = static_cast<uint32_t>(std::sqrt(m_phaseVarianceUs));
+        ++m_acceptedPresents;
+        // A handful of presents are needed before the covariance means anything.
+        m_locked = m_acceptedPresents >= 8 && std::sqrt(m_p11) * 1000.0 < m_config.lockStdDevNs;
+        return true;
+    }
+
+    void relockLocked(double timeUs)
+    {
+        // Restart from the median of the recent present intervals, most of which are one vsync.
+        ++m_stats.relocks;
+        double intervalUs = m_intervalUs;
+        const uint32_t count = m_deltaCount < kDeltaHistory ? m_deltaCount : kDeltaHistory;
+        if (count >= kDeltaHistory / 2)
+        {
+            double deltasUs[kDeltaHistory];
+            std::copy(m_deltasUs, m_deltasUs + count, deltasUs);
+            std::nth_element(deltasUs, deltasUs + count / 2, deltasUs + count);
+            if (deltasUs[count / 2] >= m_config.minIntervalUs && deltasUs[count / 2] <= m_config.maxIntervalUs)
+            {
+                intervalUs = deltasUs[count / 2];
+            }
+        }
+        lockOnLocked(m_originUs + static_cast<uint64_t>(timeUs), intervalUs,
+                     std::max(intervalUs / 100.0, static_cast<double>(m_config.measurementNoiseUs)));
+    }
+
+    /// \return Interval to report, or 0 if it didn't change meaningfully.
+    uint32_t pendingReportLocked(uint64_t presentUs)
+    {
+        if (!m_locked)
+        {
+            return 0;
+        }
+        const uint32_t intervalUs = static_cast<uint32_t>(m_intervalUs + 0.5);
+        if (m_stats.reportsSent)
+        {
+            const uint32_t changeUs = intervalUs > m_stats.reportedIntervalUs ? intervalUs - m_stats.reportedIntervalUs
+                                                                             : m_stats.reportedIntervalUs - intervalUs;
+            if (changeUs < m_config.reportThresholdUs ||
+                presentUs < m_lastReportUs + m_config.minReportIntervalMs * 1000ull)
+            {
+                return 0;
+            }
+        }
+        m_lastReportUs = presentUs;
+        m_stats.reportedIntervalUs = intervalUs;
+        ++m_stats.reportsSent;
+        return intervalUs;
+    }
+
+    uint64_t nextVsyncLocked(uint64_t timeUs) const
+    {
+        const double offsetUs = static_cast<double>(timeUs) - static_cast<double>(m_originUs) - m_phaseUs;
+        const double vsyncs = std::max(std::ceil(offsetUs / m_intervalUs), 0.0);
+        const double vsyncUs = static_cast<double>(m_originUs) + m_phaseUs + vsyncs * m_intervalUs;
+        return std::max(timeUs, static_cast<uint64_t>(std::ceil(vsyncUs)));
+    }
+
+    NvstResult send(uint32_t intervalUs)
+    {
+        if (!m_config.setRuntimeParamProc || !m_config.client)
+        {
+            return NVST_R_SUCCESS;
+        }
+        NvstClientRuntimeParam param = {};
+        param.paramId = NVST_RUNTIME_PARAM_VSYNC_INTERVAL;
+        param.vsyncInterval.streamIndex = m_config.streamIndex;
+        param.vsyncInterval.intervalUs = intervalUs;
+        return m_config.setRuntimeParamProc(m_config.client, &param);
+    }
+
+    static const uint32_t kDeltaHistory = 16;
+
+    NvstVsyncEstimatorConfig m_config;
+    mutable std::mutex m_mutex;
+    bool m_initialized = false;
+    bool m_locked = false;
+    uint64_t m_originUs = 0;
+    double m_phaseUs = 0.0;
+    double m_intervalUs = 0.0;
+    double m_p00 = 0.0;
+    double m_p01 = 0.0;
+    double m_p11 = 0.0;
+    double m_phaseVarianceUs = 0.0;
+    double m_meanLeadUs = 0.0;
+    uint32_t m_acceptedPresents = 0;
+    uint32_t m_outlierRun = 0;
+    double m_outlierRate = 0.0;
+    double m_lastPresentUs = 0.0;
+    double m_deltasUs[kDeltaHistory] = {};
+    uint32_t m_deltaCount = 0;
+    uint64_t m_lastReportUs = 0;
+    NvstHistogram m_leadUs;
+    NvstVsyncEstimatorStats m_stats = {};
+};
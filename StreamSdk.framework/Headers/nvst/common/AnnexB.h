@@ -0,0 +1,650 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file AnnexB.h
+/// H.264/H.265 Annex-B bitstream scanning and NAL unit header parsing.
+///
+/// Everything here works in place on the caller's buffer; nothing is copied,
+/// except by NvstParameterSetTracker, which keeps the last parameter sets seen.
+/// Start codes are searched 16 bytes at a time with SSE2 or NEON where available.
+
+#pragma once
+
+#include <nvst/common/StreamData.h>
+#include <nvst/common/VideoDecodeUnit.h>
+#include <nvst/common/VideoFormat.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NVST_ANNEXB_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NVST_ANNEXB_NEON 1
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+/// Location and header of a single NAL unit inside an Annex-B buffer.
+/// Offsets are 32-bit, so the buffer must be smaller than 4 GiB.
+/// \ingroup VideoData
+typedef struct NvstNalUnit_t
+{
+    /// Offset of the start code (including a leading zero_byte, if any).
+    uint32_t offset;
+    /// Offset of the first byte of the NAL unit header.
+    uint32_t headerOffset;
+    /// Size in bytes from headerOffset up to the next start code or the end of the buffer,
+    /// with trailing zero bytes removed.
+    uint32_t size;
+    /// nal_unit_type (H.264: 5 bits, H.265: 6 bits).
+    uint8_t type;
+    /// Start code length (3 or 4).
+    uint8_t startCodeLength;
+    /// H.264 nal_ref_idc, or H.265 nuh_temporal_id_plus1.
+    uint8_t refIdc;
+    /// True if this is a VCL NAL unit that starts a new picture
+    /// (first_mb_in_slice == 0 / first_slice_segment_in_pic_flag == 1).
+    bool firstSliceOfPicture;
+} NvstNalUnit;
+
+/// H.264 NAL unit types used by the helpers below.
+enum
+{
+    NVST_H264_NAL_SLICE = 1,
+    NVST_H264_NAL_IDR = 5,
+    NVST_H264_NAL_SEI = 6,
+    NVST_H264_NAL_SPS = 7,
+    NVST_H264_NAL_PPS = 8,
+    NVST_H264_NAL_AUD = 9,
+};
+
+/// H.265 NAL unit types used by the helpers below.
+enum
+{
+    NVST_H265_NAL_BLA_W_LP = 16,
+    NVST_H265_NAL_CRA = 21,
+    NVST_H265_NAL_RSV_IRAP_23 = 23,
+    NVST_H265_NAL_VPS = 32,
+    NVST_H265_NAL_SPS = 33,
+    NVST_H265_NAL_PPS = 34,
+    NVST_H265_NAL_AUD = 35,
+    NVST_H265_NAL_PREFIX_SEI = 39,
+};
+
+/// Find the next 00 00 01 start code at or after \p from, one byte at a time.
+/// Reference for nvstAnnexBFindStartCode(), which returns the same offsets.
+/// \return Offset of the first 00 byte of the three byte start code, or \p size if there is none.
+static inline size_t nvstAnnexBFindStartCodeScalar(const uint8_t* data, size_t size, size_t from)
+{
+    // Look at every third byte: a start code always has a zero there or one/two bytes later,
+    // so bytes that are > 1 let us skip ahead by three.
+    size_t i = from + 2;
+    while (i < size)
+    {
+        if (data[i] > 1)
+        {
+            i += 3;
+        }
+        else if (data[i] == 1)
+        {
+            if (data[i - 1] == 0 && data[i - 2] == 0)
+            {
+                return i - 2;
+            }
+            i += 3;
+        }
+        else
+        {
+            ++i;
+        }
+    }
+    return size;
+}
+
+namespace nvst_annexb
+{
+/// \return Index of the lowest set bit of a non-zero mask.
+static inline uint32_t lowestBit(uint64_t mask)
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(mask));
+#endif
+}
+} // namespace nvst_annexb
+
+/// Find the next 00 00 01 start code at or after \p from.
+///
+/// Blocks of 64 bytes without a 01 byte, which is rare in slice data, are
+/// skipped with one vector test. Other blocks compare 16 candidate positions
+/// per step against all three start code bytes using overlapping unaligned
+/// loads. The last few bytes, which would need a load past the end of the
+/// buffer, are left to the scalar search.
+/// \return Offset of the first 00 byte of the three byte start code, or \p size if there is none.
+static inline size_t nvstAnnexBFindStartCode(const uint8_t* data, size_t size, size_t from)
+{
+    size_t i = from;
+#if defined(NVST_ANNEXB_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    while (i + 18 <= size)
+    {
+        if (i + 66 <= size)
+        {
+            const __m128i* p = reinterpret_cast<const __m128i*>(data + i + 2);
+            const __m128i ones = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p), one), _mm_cmpeq_epi8(_mm_loadu_si128(p + 1), one)),
+                _mm_or_si128(_mm_cmpeq_epi8(_mm_loadu_si128(p + 2), one), _mm_cmpeq_epi8(_mm_loadu_si128(p + 3), one)));
+            if (!_mm_movemask_epi8(ones))
+            {
+                i += 64;
+                continue;
+            }
+        }
+        for (const size_t blockEnd = i + 64; i < blockEnd && i + 18 <= size; i += 16)
+        {
+            const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+            const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+            const __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 2));
+            const __m128i hit = _mm_and_si128(
+                _mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)), _mm_cmpeq_epi8(b2, one));
+            const uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+            if (mask)
+            {
+                return i + nvst_annexb::lowestBit(mask);
+            }
+        }
+    }
+#elif defined(NVST_ANNEXB_NEON)
+    const uint8x16_t zero = vdupq_n_u8(0);
+    const uint8x16_t one = vdupq_n_u8(1);
+    // Narrow a byte mask to four bits per byte, the NEON equivalent of a movemask.
+    const auto bitMask = [](uint8x16_t bytes) {
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(bytes), 4)), 0);
+    };
+    while (i + 18 <= size)
+    {
+        if (i + 66 <= size)
+        {
+            const uint8_t* p = data + i + 2;
+            const uint8x16_t ones = vorrq_u8(vorrq_u8(vceqq_u8(vld1q_u8(p), one), vceqq_u8(vld1q_u8(p + 16), one)),
+                                             vorrq_u8(vceqq_u8(vld1q_u8(p + 32), one), vceqq_u8(vld1q_u8(p + 48), one)));
+            if (!bitMask(ones))
+            {
+                i += 64;
+                continue;
+            }
+        }
+        for (const size_t blockEnd = i + 64; i < blockEnd && i + 18 <= size; i += 16)
+        {
+            // Zero exactly where b0 == 0, b1 == 0 and b2 == 1.
+            const uint8x16_t miss = vorrq_u8(vorrq_u8(vld1q_u8(data + i), vld1q_u8(data + i + 1)),
+                                             veorq_u8(vld1q_u8(data + i + 2), one));
+            const uint64_t mask = bitMask(vceqq_u8(miss, zero));
+            if (mask)
+            {
+                return i + nvst_annexb::lowestBit(mask) / 4;
+            }
+        }
+    }
+#endif
+    return nvstAnnexBFindStartCodeScalar(data, size, i);
+}
+
+/// Minimal RBSP bit reader for the first few header fields of a NAL unit.
+/// Skips emulation prevention bytes transparently; reads past the end yield zeros.
+class NvstRbspReader
+{
+public:
+    NvstRbspReader(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    uint32_t readBit()
+    {
+        if (m_bit == 0)
+        {
+            if (m_pos >= m_size)
+            {
+                return 0;
+            }
+            if (m_zeros >= 2 && m_data[m_pos] == 3)
+            {
+                ++m_pos;
+                m_zeros = 0;
+                if (m_pos >= m_size)
+                {
+                    return 0;
+                }
+            }
+            m_current = m_data[m_pos];
+            m_zeros = m_current == 0 ? m_zeros + 1 : 0;
+            ++m_pos;
+            m_bit = 8;
+        }
+        --m_bit;
+        return (m_current >> m_bit) & 1;
+    }
+
+    uint32_t readBits(uint32_t count)
+    {
+        uint32_t value = 0;
+        while (count--)
+        {
+            value = (value << 1) | readBit();
+        }
+        return value;
+    }
+
+    /// Returned by readUe() for codes longer than 32 bits, e.g. all-zero or truncated data.
+    static const uint32_t kInvalidUe = UINT32_MAX;
+
+    /// Unsigned Exp-Golomb code.
+    /// \return The value, or kInvalidUe if the code doesn't fit in 32 bits.
+    uint32_t readUe()
+    {
+        uint32_t leadingZeros = 0;
+        while (readBit() == 0)
+        {
+            if (++leadingZeros > 31)
+            {
+                return kInvalidUe;
+            }
+        }
+        if (leadingZeros == 0)
+        {
+            return 0;
+        }
+        return ((1u << leadingZeros) - 1) + readBits(leadingZeros);
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    uint32_t m_bit = 0;
+    uint32_t m_zeros = 0;
+    uint8_t m_current = 0;
+};
+
+/// \return true for NAL units that carry slice data.
+static inline bool nvstNalIsVcl(NvstVideoFormat format, uint8_t type)
+{
+    return format == NVST_VF_H264 ? (type >= 1 && type <= 5) : type < 32;
+}
+
+/// \return true for NAL units that start a random access point (IDR, or IRAP for H.265).
+static inline bool nvstNalIsRandomAccess(NvstVideoFormat format, uint8_t type)
+{
+    return format == NVST_VF_H264 ? type == NVST_H264_NAL_IDR
+                                  : type >= NVST_H265_NAL_BLA_W_LP && type <= NVST_H265_NAL_RSV_IRAP_23;
+}
+
+/// \return true for NAL units of pictures a decoder can start from: IDR, and for H.265 also BLA.
+/// Unlike CRA, these are never followed by leading pictures that reference earlier ones.
+static inline bool nvstNalIsDecoderRefresh(NvstVideoFormat format, uint8_t type)
+{
+    return format == NVST_VF_H264 ? type == NVST_H264_NAL_IDR
+                                  : type >= NVST_H265_NAL_BLA_W_LP && type < NVST_H265_NAL_CRA;
+}
+
+/// \return true for SPS, PPS and (H.265) VPS NAL units.
+static inline bool nvstNalIsParameterSet(NvstVideoFormat format, uint8_t type)
+{
+    return format == NVST_VF_H264 ? (type == NVST_H264_NAL_SPS || type == NVST_H264_NAL_PPS)
+                                  : (type >= NVST_H265_NAL_VPS && type <= NVST_H265_NAL_PPS);
+}
+
+/// \return true for NAL units that, when seen after a VCL NAL unit,
+/// begin a new access unit (AUD, parameter sets, prefix SEI).
+static inline bool nvstNalStartsAccessUnit(NvstVideoFormat format, uint8_t type)
+{
+    if (format == NVST_VF_H264)
+    {
+        return type == NVST_H264_NAL_AUD || type == NVST_H264_NAL_SEI || type == NVST_H264_NAL_SPS ||
+            type == NVST_H264_NAL_PPS || (type >= 14 && type <= 18);
+    }
+    return (type >= NVST_H265_NAL_VPS && type <= NVST_H265_NAL_AUD) || type == NVST_H265_NAL_PREFIX_SEI ||
+        (type >= 41 && type <= 44) || (type >= 48 && type <= 55);
+}
+
+/// Parse the NAL unit header located at \p header.
+/// \param[in] format Codec of the bitstream.
+/// \param[in] header First byte of the NAL unit header.
+/// \param[in] size Number of bytes available from header.
+/// \param[in,out] nal Receives type, refIdc and firstSliceOfPicture.
+/// \return false if the header is truncated or has forbidden_zero_bit set.
+static inline bool nvstParseNalHeader(NvstVideoFormat format, const uint8_t* header, size_t size, NvstNalUnit* nal)
+{
+    const size_t headerSize = format == NVST_VF_H264 ? 1 : 2;
+    if (size < headerSize || (header[0] & 0x80))
+    {
+        return false;
+    }
+    if (format == NVST_VF_H264)
+    {
+        nal->type = header[0] & 0x1F;
+        nal->refIdc = (header[0] >> 5) & 0x3;
+    }
+    else
+    {
+        nal->type = (header[0] >> 1) & 0x3F;
+        nal->refIdc = header[1] & 0x7;
+    }
+    // first_mb_in_slice == 0 is coded as a single '1' bit, and
+    // first_slice_segment_in_pic_flag is the first bit of the slice header.
+    nal->firstSliceOfPicture =
+        nvstNalIsVcl(format, nal->type) && size > headerSize && (header[headerSize] & 0x80) != 0;
+    return true;
+}
+
+/// Classify a picture made of the given NAL types as an NvstEncodedFrameType.
+///
+/// For H.264 the first slice header is consulted so that non-IDR pictures
+/// made only of I slices are reported as I-frames too.
+/// \param[in] format Codec of the bitstream.
+/// \param[in] firstSlice Header of the first VCL NAL unit of the picture.
+/// \param[in] firstSliceSize Bytes available from firstSlice.
+/// \param[in] hasRandomAccess Whether any NAL unit in the picture is IDR/IRAP.
+static inline NvstEncodedFrameType nvstClassifyPicture(
+    NvstVideoFormat format,
+    const uint8_t* firstSlice,
+    size_t firstSliceSize,
+    bool hasRandomAccess)
+{
+    if (hasRandomAccess)
+    {
+        return NVST_EFT_I_FRAME;
+    }
+    if (!firstSlice)
+    {
+        return NVST_EFT_NONE;
+    }
+    if (format == NVST_VF_H264 && firstSliceSize > 1)
+    {
+        NvstRbspReader reader(firstSlice + 1, firstSliceSize - 1);
+        reader.readUe(); // first_mb_in_slice
+        const uint32_t sliceType = reader.readUe();
+        // 2 = I, 4 = SI, plus 5 when all slices of the picture share the type.
+        if (sliceType != NvstRbspReader::kInvalidUe && (sliceType % 5 == 2 || sliceType % 5 == 4))
+        {
+            return NVST_EFT_I_FRAME;
+        }
+    }
+    return NVST_EFT_P_FRAME;
+}
+
+/// Walk every NAL unit in an Annex-B buffer.
+/// \param[in] format Codec of the bitstream.
+/// \param[in] data Buffer beginning with (or containing) a start code.
+/// \param[in] size Size of the buffer; buffers larger than UINT32_MAX are rejected (see NvstNalUnit).
+/// \param[in] callback Called as callback(const NvstNalUnit&) for each NAL unit;
+/// return false from it to stop early.
+/// \return Number of NAL units visited.
+template <typename Callback>
+static inline size_t nvstForEachNalUnit(NvstVideoFormat format, const uint8_t* data, size_t size, Callback callback)
+{
+    size_t count = 0;
+    if (static_cast<uint64_t>(size) > UINT32_MAX)
+    {
+        return count;
+    }
+    size_t start = nvstAnnexBFindStartCode(data, size, 0);
+    while (start < size)
+    {
+        const size_t header = start + 3;
+        const size_t next = nvstAnnexBFindStartCode(data, size, header);
+        size_t end = next;
+        // Trailing zeros belong to the next four byte start code or are trailing_zero_8bits.
+        while (end > header && data[end - 1] == 0)
+        {
+            --end;
+        }
+
+        NvstNalUnit nal = {};
+        nal.startCodeLength = (start > 0 && data[start - 1] == 0) ? 4 : 3;
+        nal.offset = static_cast<uint32_t>(start - (nal.startCodeLength - 3));
+        nal.headerOffset = static_cast<uint32_t>(header);
+        nal.size = static_cast<uint32_t>(end - header);
+        if (nvstParseNalHeader(format, data + header, end - header, &nal))
+        {
+            ++count;
+            if (!callback(static_cast<const NvstNalUnit&>(nal)))
+            {
+                break;
+            }
+        }
+        start = next;
+    }
+    return count;
+}
+
+/// Maximum number of NAL units recorded by NvstNalIndex.
+#define NVST_NAL_INDEX_MAX_UNITS 32
+
+/// NAL unit index of a single decode unit, pointing into its streamBuffer.
+/// \ingroup VideoData
+typedef struct NvstNalIndex_t
+{
+    /// The first \p count NAL units of the buffer.
+    NvstNalUnit units[NVST_NAL_INDEX_MAX_UNITS];
+    /// Number of valid entries in units.
+    uint32_t count;
+    /// Number of NAL units in the buffer; larger than count if the index was truncated.
+    uint32_t totalCount;
+    /// Number of VCL NAL units (slices).
+    uint32_t sliceCount;
+    /// Index into units of the first VCL NAL unit, or -1 if there is none among them.
+    int32_t firstSlice;
+    /// An IDR/IRAP NAL unit is present.
+    bool hasRandomAccess;
+    /// An IDR (H.265: IDR or BLA) NAL unit is present, so decoding can start at this unit.
+    bool hasDecoderRefresh;
+    /// An SPS, PPS or VPS NAL unit is present.
+    bool hasParameterSets;
+    /// Picture type as classified by nvstClassifyPicture().
+    NvstEncodedFrameType frameType;
+} NvstNalIndex;
+
+/// Index every NAL unit of an Annex-B buffer.
+/// \param[in] format Codec of the bitstream.
+/// \param[in] data Annex-B buffer.
+/// \param[in] size Size of the buffer.
+/// \param[out] index Receives the NAL units and a summary of the buffer.
+/// \return Number of NAL units in the buffer.
+static inline uint32_t nvstIndexNalUnits(NvstVideoFormat format, const uint8_t* data, size_t size, NvstNalIndex* index)
+{
+    index->count = 0;
+    index->totalCount = 0;
+    index->sliceCount = 0;
+    index->firstSlice = -1;
+    index->hasRandomAccess = false;
+    index->hasDecoderRefresh = false;
+    index->hasParameterSets = false;
+    nvstForEachNalUnit(format, data, size, [&](const NvstNalUnit& nal) {
+        const bool vcl = nvstNalIsVcl(format, nal.type);
+        if (index->count < NVST_NAL_INDEX_MAX_UNITS)
+        {
+            if (vcl && index->firstSlice < 0)
+            {
+                index->firstSlice = static_cast<int32_t>(index->count);
+            }
+            index->units[index->count++] = nal;
+        }
+        ++index->totalCount;
+        index->sliceCount += vcl ? 1 : 0;
+        index->hasRandomAccess = index->hasRandomAccess || nvstNalIsRandomAccess(format, nal.type);
+        index->hasDecoderRefresh = index->hasDecoderRefresh || nvstNalIsDecoderRefresh(format, nal.type);
+        index->hasParameterSets = index->hasParameterSets || nvstNalIsParameterSet(format, nal.type);
+        return true;
+    });
+    const NvstNalUnit* first = index->firstSlice >= 0 ? &index->units[index->firstSlice] : nullptr;
+    index->frameType =
+        nvstClassifyPicture(format, first ? data + first->headerOffset : nullptr, first ? first->size : 0,
+                            index->hasRandomAccess);
+    return index->totalCount;
+}
+
+/// Index the NAL units of a decode unit's streamBuffer.
+/// \see nvstIndexNalUnits
+static inline uint32_t nvstIndexVideoDecodeUnit(
+    NvstVideoFormat format,
+    const NvstVideoDecodeUnit* vdu,
+    NvstNalIndex* index)
+{
+    return nvstIndexNalUnits(format, static_cast<const uint8_t*>(vdu->streamBuffer), vdu->streamSizeBytes, index);
+}
+
+/// Detects new or modified parameter sets, which require the decoder to be reconfigured.
+///
+/// Parameter sets are keyed by NAL type and their own id (seq_parameter_set_id,
+/// pic_parameter_set_id, vps_video_parameter_set_id), so a stream that merely
+/// repeats its SPS/PPS with every IDR doesn't trigger a reconfiguration.
+/// A copy of the last version of each parameter set is kept for the comparison.
+/// \ingroup VideoData
+class NvstParameterSetTracker
+{
+public:
+    explicit NvstParameterSetTracker(NvstVideoFormat format)
+        : m_format(format)
+    {
+    }
+
+    /// Compare the parameter sets of an indexed buffer against the ones seen before.
+    /// \param[in] data Buffer passed to nvstIndexNalUnits().
+    /// \param[in] index Its index.
+    /// \return true if any parameter set is new or differs from the previous one with the same id.
+    bool update(const uint8_t* data, const NvstNalIndex& index)
+    {
+        bool changed = false;
+        if (index.hasParameterSets)
+        {
+            for (uint32_t i = 0; i < index.count; ++i)
+            {
+                const NvstNalUnit& nal = index.units[i];
+                if (nvstNalIsParameterSet(m_format, nal.type))
+                {
+                    changed = update(data + nal.headerOffset, nal) || changed;
+                }
+            }
+        }
+        return changed;
+    }
+
+    /// Compare a single parameter set NAL unit.
+    /// \param[in] header First byte of the NAL unit header.
+    /// \param[in] nal Its entry from the index.
+    /// \return true if it is new or differs from the previous one with the same id.
+    bool update(const uint8_t* header, const NvstNalUnit& nal)
+    {
+        const uint32_t key = (static_cast<uint32_t>(nal.type) << 16) | parameterSetId(header, nal);
+        std::vector<uint8_t>& stored = m_sets[key];
+        if (stored.size() == nal.size && std::memcmp(stored.data(), header, nal.size) == 0)
+        {
+            return false;
+        }
+        stored.assign(header, header + nal.size);
+        ++m_changes;
+        return true;
+    }
+
+    /// \return Number of parameter sets that were new or changed so far.
+    uint64_t changeCount() const { return m_changes; }
+
+    /// Forget every parameter set, e.g. after the decoder was recreated.
+    void reset()
+    {
+        m_sets.clear();
+        m_changes = 0;
+    }
+
+private:
+    uint32_t parameterSetId(const uint8_t* header, const NvstNalUnit& nal) const
+    {
+        const uint32_t headerSize = m_format == NVST_VF_H264 ? 1 : 2;
+        if (nal.size <= headerSize)
+        {
+            return 0;
+        }
+        NvstRbspReader reader(header + headerSize, nal.size - headerSize);
+        if (m_format == NVST_VF_H264)
+        {
+            if (nal.type == NVST_H264_NAL_SPS)
+            {
+                reader.readBits(24); // profile_idc, constraint flags, level_idc
+            }
+            return reader.readUe();
+        }
+        switch (nal.type)
+        {
+        case NVST_H265_NAL_VPS:
+            return reader.readBits(4);
+        case NVST_H265_NAL_SPS:
+        {
+            reader.readBits(4); // sps_video_parameter_set_id
+            const uint32_t maxSubLayersMinus1 = reader.readBits(3);
+            reader.readBits(1); // sps_temporal_id_nesting_flag
+            skipProfileTierLevel(reader, maxSubLayersMinus1);
+            return reader.readUe();
+        }
+        default:
+            return reader.readUe();
+        }
+    }
+
+    static void skipProfileTierLevel(NvstRbspReader& reader, uint32_t maxSubLayersMinus1)
+    {
+        // General profile (88 bits) and general_level_idc.
+        reader.readBits(32);
+        reader.readBits(32);
+        reader.readBits(32);
+        uint32_t subLayerFlags[8] = {};
+        for (uint32_t i = 0; i < maxSubLayersMinus1; ++i)
+        {
+            subLayerFlags[i] = reader.readBits(2);
+        }
+        if (maxSubLayersMinus1 > 0)
+        {
+            reader.readBits(2 * (8 - maxSubLayersMinus1)); // reserved_zero_2bits
+        }
+        for (uint32_t i = 0; i < maxSubLayersMinus1; ++i)
+        {
+            if (subLayerFlags[i] & 2)
+            {
+                reader.readBits(32); // sub-layer profile (88 bits)
+                reader.readBits(32);
+                reader.readBits(24);
+            }
+            if (subLayerFlags[i] & 1)
+            {
+                reader.readBits(8); // sub_layer_level_idc
+            }
+        }
+    }
+
+    NvstVideoFormat m_format;
+    /// Last version of each parameter set, keyed by (nal type << 16) | id.
+    std::map<uint32_t, std::vector<uint8_t>> m_sets;
+    uint64_t m_changes = 0;
+};
@@ -0,0 +1,365 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file FrameMetadata.h
+/// Typed per-frame metadata in a type-length-value layout.
+///
+/// The server attaches a block to a frame through NvstGraphicsSurface::metadata
+/// and the client receives it verbatim as NvstVideoDecodeUnit::genericMetadata.
+/// NvstFrameMetadataWriter builds a block, nvstFrameMetadataAttachToSurface()
+/// hands it to the surface, and NvstFrameMetadataView reads it in place on the
+/// client without copying.
+///
+/// Layout, little endian, every entry starting on a 4 byte boundary:
+/// - header: 'N', 'M', uint8 version (NVST_FRAME_METADATA_VERSION), uint8 reserved
+/// - entries: uint16 type (NvstFrameMetadataType), uint16 length, length value bytes, zero padding
+///
+/// The layout itself allows blocks of up to 64 KB, but both per-frame carriers,
+/// NvstGraphicsSurface::metadataSize and NvstVideoDecodeUnit::genericMetadataSize,
+/// are uint8_t, so a block attached to a frame is limited to
+/// NVST_FRAME_METADATA_MAX_ATTACHED_SIZE bytes. A pose, camera intrinsics and a short
+/// annotation fit comfortably. Larger blocks can be carried over an application channel
+/// and read with the same view.
+
+#pragma once
+
+#include <nvst/common/Result.h>
+#include <nvst/common/StreamData.h>
+#include <nvst/common/VideoDecodeUnit.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/// Version of the block layout.
+#define NVST_FRAME_METADATA_VERSION 1
+/// Size of the block header in bytes.
+#define NVST_FRAME_METADATA_HEADER_SIZE 4
+/// Size of an entry header in bytes.
+#define NVST_FRAME_METADATA_ENTRY_HEADER_SIZE 4
+/// Largest block that can be attached to a single frame.
+#define NVST_FRAME_METADATA_MAX_ATTACHED_SIZE 255
+
+/// Entry types. Values from NVST_FRAME_METADATA_USER up are free for applications.
+typedef enum NvstFrameMetadataType_t
+{
+    NVST_FRAME_METADATA_NONE = 0,
+    /// NvstFrameMetadataPose.
+    NVST_FRAME_METADATA_POSE = 1,
+    /// NvstFrameMetadataCameraIntrinsics.
+    NVST_FRAME_METADATA_CAMERA_INTRINSICS = 2,
+    /// UTF-8 text, not NUL terminated.
+    NVST_FRAME_METADATA_ANNOTATION = 3,
+    /// Untyped bytes, e.g. metadata produced before this layout was adopted.
+    NVST_FRAME_METADATA_RAW = 4,
+    /// First application defined type.
+    NVST_FRAME_METADATA_USER = 0x8000,
+} NvstFrameMetadataType;
+
+#pragma pack(push, 1)
+/// Head pose the frame was rendered for.
+typedef struct NvstFrameMetadataPose_t
+{
+    /// Time the pose was sampled or predicted for, in microseconds.
+    uint64_t timestampUs;
+    /// Position x, y, z in meters.
+    float position[3];
+    /// Orientation quaternion x, y, z, w.
+    float orientation[4];
+} NvstFrameMetadataPose;
+
+/// Pinhole camera intrinsics of the rendered view.
+typedef struct NvstFrameMetadataCameraIntrinsics_t
+{
+    /// Focal lengths in pixels.
+    float fx;
+    float fy;
+    /// Principal point in pixels.
+    float cx;
+    float cy;
+    /// Image size in pixels the values refer to.
+    uint16_t width;
+    uint16_t height;
+} NvstFrameMetadataCameraIntrinsics;
+#pragma pack(pop)
+
+/// One entry of a block; value points into the block.
+typedef struct NvstFrameMetadataEntry_t
+{
+    uint16_t type;
+    uint16_t length;
+    const void* value;
+} NvstFrameMetadataEntry;
+
+/// Builds a block into a caller provided buffer.
+/// \ingroup VideoData
+class NvstFrameMetadataWriter
+{
+public:
+    /// \param[in] buffer Storage for the block; must outlive any surface the block is attached to.
+    /// \param[in] capacity Size of buffer, at most 64 KB is used.
+    NvstFrameMetadataWriter(void* buffer, size_t capacity)
+        : m_buffer(static_cast<uint8_t*>(buffer))
+        , m_capacity(capacity < 0x10000 ? capacity : 0x10000)
+    {
+        reset();
+    }
+
+    /// Drop all entries.
+    void reset()
+    {
+        m_size = 0;
+        if (m_capacity >= NVST_FRAME_METADATA_HEADER_SIZE)
+        {
+            m_buffer[0] = 'N';
+            m_buffer[1] = 'M';
+            m_buffer[2] = NVST_FRAME_METADATA_VERSION;
+            m_buffer[3] = 0;
+            m_size = NVST_FRAME_METADATA_HEADER_SIZE;
+        }
+    }
+
+    /// Append an entry.
+    /// \retval NVST_R_INVALID_PARAM if the value is larger than 64 KB or null with a nonzero size
+    /// \retval NVST_R_FRAME_DROPPED if the entry doesn't fit; the block is unchanged
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult add(uint16_t type, const void* value, size_t length)
+    {
+        if (length > 0xFFFF || (!value && length))
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+        const size_t padded = (length + 3) & ~static_cast<size_t>(3);
+        if (!m_size || m_size + NVST_FRAME_METADATA_ENTRY_HEADER_SIZE + padded > m_capacity)
+        {
+            return NVST_R_FRAME_DROPPED;
+        }
+        uint8_t* entry = m_buffer + m_size;
+        entry[0] = static_cast<uint8_t>(type);
+        entry[1] = static_cast<uint8_t>(type >> 8);
+        entry[2] = static_cast<uint8_t>(length);
+        entry[3] = static_cast<uint8_t>(length >> 8);
+        if (length)
+        {
+            std::memcpy(entry + NVST_FRAME_METADATA_ENTRY_HEADER_SIZE, value, length);
+        }
+        std::memset(entry + NVST_FRAME_METADATA_ENTRY_HEADER_SIZE + length, 0, padded - length);
+        m_size += NVST_FRAME_METADATA_ENTRY_HEADER_SIZE + padded;
+        return NVST_R_SUCCESS;
+    }
+
+    NvstResult addPose(const NvstFrameMetadataPose& pose)
+    {
+        return add(NVST_FRAME_METADATA_POSE, &pose, sizeof(pose));
+    }
+
+    NvstResult addCameraIntrinsics(const NvstFrameMetadataCameraIntrinsics& intrinsics)
+    {
+        return add(NVST_FRAME_METADATA_CAMERA_INTRINSICS, &intrinsics, sizeof(intrinsics));
+    }
+
+    NvstResult addAnnotation(const char* text, size_t length)
+    {
+        return add(NVST_FRAME_METADATA_ANNOTATION, text, length);
+    }
+
+    /// \return The block.
+    const void* data() const { return m_buffer; }
+
+    /// \return Size of the block in bytes.
+    size_t size() const { return m_size; }
+
+private:
+    uint8_t* m_buffer;
+    size_t m_capacity;
+    size_t m_size;
+};
+
+/// Reads a block in place. Entry values point into the viewed memory; for a decode unit
+/// they stay valid until its releaseProc is called.
+/// \ingroup VideoData
+class NvstFrameMetadataView
+{
+public:
+    NvstFrameMetadataView() = default;
+
+    /// View a block. Memory that doesn't start with a block header is treated as a single
+    /// NVST_FRAME_METADATA_RAW entry, so untyped metadata stays accessible.
+    NvstFrameMetadataView(const void* data, size_t size)
+        : m_data(static_cast<const uint8_t*>(data))
+        , m_size(data ? size : 0)
+    {
+        m_typed = m_size >= NVST_FRAME_METADATA_HEADER_SIZE && m_data[0] == 'N' && m_data[1] == 'M' &&
+            m_data[2] == NVST_FRAME_METADATA_VERSION;
+    }
+
+    /// View the metadata of a decode unit.
+    explicit NvstFrameMetadataView(const NvstVideoDecodeUnit& vdu)
+        : NvstFrameMetadataView(vdu.genericMetadata, vdu.genericMetadataSize)
+    {
+    }
+
+    /// \return true if the memory holds a block rather than untyped metadata.
+    bool isTyped() const { return m_typed; }
+
+    /// Iterate the entries.
+    /// \param[in,out] cursor Start with 0; advanced past the returned entry.
+    /// \param[out] entry Receives the entry.
+    /// \return false at the end or at a malformed entry.
+    bool next(size_t* cursor, NvstFrameMetadataEntry* entry) const
+    {
+        if (!m_typed)
+        {
+            if (*cursor || !m_size)
+            {
+                return false;
+            }
+            entry->type = NVST_FRAME_METADATA_RAW;
+            entry->length = static_cast<uint16_t>(m_size < 0xFFFF ? m_size : 0xFFFF);
+            entry->value = m_data;
+            *cursor = m_size;
+            return true;
+        }
+        size_t offset = *cursor ? *cursor : NVST_FRAME_METADATA_HEADER_SIZE;
+        if (offset + NVST_FRAME_METADATA_ENTRY_HEADER_SIZE > m_size)
+        {
+            return false;
+        }
+        const uint8_t* header = m_data + offset;
+        const uint16_t length = static_cast<uint16_t>(header[2] | (header[3] << 8));
+        offset += NVST_FRAME_METADATA_ENTRY_HEADER_SIZE;
+        if (offset + length > m_size)
+        {
+            return false;
+        }
+        entry->type = static_cast<uint16_t>(header[0] | (header[1] << 8));
+        entry->length = length;
+        entry->value = m_data + offset;
+        // The padding of the last entry may be cut off by the carrier.
+        const size_t padded = offset + ((length + 3u) & ~3u);
+        *cursor = padded < m_size ? padded : m_size;
+        return true;
+    }
+
+    /// Find the first entry of a type.
+    /// \retval NVST_R_NOT_FOUND if there is none
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult find(uint16_t type, NvstFrameMetadataEntry* entry) const
+    {
+        size_t cursor = 0;
+        while (next(&cursor, entry))
+        {
+            if (entry->type == type)
+            {
+                return NVST_R_SUCCESS;
+            }
+        }
+        return NVST_R_NOT_FOUND;
+    }
+
+    /// Copy out the pose. The entry may sit at any alignment inside the carrier, so
+    /// fixed-size structures are copied; they are a few dozen bytes.
+    /// \retval NVST_R_NOT_FOUND if there is no pose
+    /// \retval NVST_R_INVALID_VALUE if the entry is too short
+    NvstResult getPose(NvstFrameMetadataPose* pose) const
+    {
+        return getFixed(NVST_FRAME_METADATA_POSE, pose, sizeof(*pose));
+    }
+
+    NvstResult getCameraIntrinsics(NvstFrameMetadataCameraIntrinsics* intrinsics) const
+    {
+        return getFixed(NVST_FRAME_METADATA_CAMERA_INTRINSICS, intrinsics, sizeof(*intrinsics));
+    }
+
+    /// \param[out] text Points into the block; not NUL terminated.
+    /// \param[out] length Length of text in bytes.
+    NvstResult getAnnotation(const char** text, size_t* length) const
+    {
+        NvstFrameMetadataEntry entry;
+        const NvstResult result = find(NVST_FRAME_METADATA_ANNOTATION, &entry);
+        if (result == NVST_R_SUCCESS)
+        {
+            *text = static_cast<const char*>(entry.value);
+            *length = entry.length;
+        }
+        return result;
+    }
+
+private:
+    NvstResult getFixed(uint16_t type, void* target, size_t size) const
+    {
+        NvstFrameMetadataEntry entry;
+        const NvstResult result = find(type, &entry);
+        if (result != NVST_R_SUCCESS)
+        {
+            return result;
+        }
+        // Newer senders may append fields; older ones must provide at least the known ones.
+        if (entry.length < size)
+        {
+            return NVST_R_INVALID_VALUE;
+        }
+        std::memcpy(target, entry.value, size);
+        return NVST_R_SUCCESS;
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_typed = false;
+};
+
+/// Attach a block to a surface before handing it to the server.
+///
+/// The surface refers to the writer's buffer, which has to stay valid until the surface is released.
+/// \param[in,out] surface Surface to attach to.
+/// \param[in] writer Block to attach.
+/// \retval NVST_R_FRAME_DROPPED if the block exceeds NVST_FRAME_METADATA_MAX_ATTACHED_SIZE; nothing is attached
+/// \retval NVST_R_SUCCESS otherwise
+/// \ingroup VideoData
+static inline NvstResult nvstFrameMetadataAttachToSurface(NvstGraphicsSurface* surface,
+                                                          const NvstFrameMetadataWriter& writer)
+{
+    if (writer.size() > NVST_FRAME_METADATA_MAX_ATTACHED_SIZE)
+    {
+        return NVST_R_FRAME_DROPPED;
+    }
+    surface->metadata = const_cast<void*>(writer.data());
+    surface->metadataSize = static_cast<uint8_t>(writer.size());
+    return NVST_R_SUCCESS;
+}
+
+/// Start a block from the metadata a surface already carries.
+///
+/// A typed block is copied entry by entry; untyped metadata becomes an NVST_FRAME_METADATA_RAW entry.
+/// Further entries can be added to the writer before attaching it back to the surface.
+/// \param[in] surface Surface whose metadata to import.
+/// \param[in,out] writer Receives the entries; it is reset first, so it must not use the surface's metadata buffer.
+/// \retval NVST_R_FRAME_DROPPED if the writer's buffer is too small
+/// \retval NVST_R_SUCCESS otherwise
+/// \ingroup VideoData
+static inline NvstResult nvstFrameMetadataImportFromSurface(const NvstGraphicsSurface* surface,
+                                                            NvstFrameMetadataWriter* writer)
+{
+    writer->reset();
+    const NvstFrameMetadataView view(surface->metadata, surface->metadataSize);
+    size_t cursor = 0;
+    NvstFrameMetadataEntry entry;
+    while (view.next(&cursor, &entry))
+    {
+        const NvstResult result = writer->add(entry.type, entry.value, entry.length);
+        if (result != NVST_R_SUCCESS)
+        {
+            return result;
+        }
+    }
+    return NVST_R_SUCCESS;
+}
@@ -0,0 +1,213 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file Histogram.h
+/// Lock-free log-linear histogram for latency and queue depth statistics.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/// Summary of a histogram snapshot.
+typedef struct NvstHistogramSummary_t
+{
+    /// Number of recorded samples.
+    uint64_t count;
+    /// Smallest recorded sample.
+    uint64_t min;
+    /// Largest recorded sample.
+    uint64_t max;
+    /// Arithmetic mean of the recorded samples.
+    double mean;
+    /// Median.
+    uint64_t p50;
+    /// 90th percentile.
+    uint64_t p90;
+    /// 99th percentile.
+    uint64_t p99;
+    /// 99.9th percentile.
+    uint64_t p999;
+} NvstHistogramSummary;
+
+/// High dynamic range histogram of unsigned 64-bit samples.
+///
+/// Values below 32 get an exact bucket; larger values are bucketed by their
+/// most significant bit plus the five bits below it, which bounds the
+/// relative quantization error at about 3% over the full 64-bit range.
+/// record() is wait-free and may be called from any number of threads.
+/// Readers see a slightly racy but monotonic view, which is adequate for
+/// runtime statistics.
+class NvstHistogram
+{
+public:
+    /// Number of sub-buckets per power of two.
+    static const uint32_t kSubBuckets = 32;
+    /// Number of mantissa bits kept per sample.
+    static const uint32_t kSubBucketBits = 5;
+    /// Total number of buckets needed to cover the 64-bit range.
+    static const uint32_t kBucketCount = (64 - kSubBucketBits) * kSubBuckets + kSubBuckets;
+
+    NvstHistogram() { reset(); }
+
+    NvstHistogram(const NvstHistogram&) = delete;
+    NvstHistogram& operator=(const NvstHistogram&) = delete;
+
+    /// Record a single sample.
+    void record(uint64_t value) { recordMultiple(value, 1); }
+
+    /// Record the same sample several times.
+    void recordMultiple(uint64_t value, uint64_t count)
+    {
+        m_buckets[bucketIndex(value)].fetch_add(count, std::memory_order_relaxed);
+        m_count.fetch_add(count, std::memory_order_relaxed);
+        m_sum.fetch_add(value * count, std::memory_order_relaxed);
+
+        uint64_t current = m_min.load(std::memory_order_relaxed);
+        while (value < current && !m_min.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+        current = m_max.load(std::memory_order_relaxed);
+        while (value > current && !m_max.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    /// Clear all samples.
+    /// \note Not atomic with respect to concurrent record() calls.
+    void reset()
+    {
+        for (uint32_t i = 0; i < kBucketCount; ++i)
+        {
+            m_buckets[i].store(0, std::memory_order_relaxed);
+        }
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_min.store(UINT64_MAX, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+    /// \return Number of recorded samples.
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+
+    /// Estimate a quantile of the recorded samples.
+    /// \param[in] quantile Value in [0, 1], e.g. 0.99 for the 99th percentile.
+    /// \return The midpoint of the bucket holding the quantile, clamped to the
+    /// observed min/max, or 0 if no samples were recorded.
+    uint64_t valueAtQuantile(double quantile) const
+    {
+        const uint64_t total = count();
+        if (total == 0)
+        {
+            return 0;
+        }
+        if (quantile < 0.0)
+        {
+            quantile = 0.0;
+        }
+        if (quantile > 1.0)
+        {
+            quantile = 1.0;
+        }
+        uint64_t rank = static_cast<uint64_t>(quantile * static_cast<double>(total) + 0.5);
+        rank = rank == 0 ? 1 : rank;
+
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < kBucketCount; ++i)
+        {
+            seen += m_buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+            {
+                return clampToObserved(bucketLowerBound(i) + bucketWidth(i) / 2);
+            }
+        }
+        return m_max.load(std::memory_order_relaxed);
+    }
+
+    /// Snapshot the usual summary statistics.
+    NvstHistogramSummary summary() const
+    {
+        NvstHistogramSummary result;
+        result.count = count();
+        result.min = result.count ? m_min.load(std::memory_order_relaxed) : 0;
+        result.max = m_max.load(std::memory_order_relaxed);
+        result.mean = result.count
+            ? static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(result.count)
+            : 0.0;
+        result.p50 = valueAtQuantile(0.5);
+        result.p90 = valueAtQuantile(0.9);
+        result.p99 = valueAtQuantile(0.99);
+        result.p999 = valueAtQuantile(0.999);
+        return result;
+    }
+
+    /// Raw count stored in a bucket, for exporting the full distribution.
+    uint64_t bucketCount(uint32_t index) const { return m_buckets[index].load(std::memory_order_relaxed); }
+
+    /// Map a sample to its bucket.
+    static uint32_t bucketIndex(uint64_t value)
+    {
+        if (value < kSubBuckets)
+        {
+            return static_cast<uint32_t>(value);
+        }
+        const uint32_t msb = mostSignificantBit(value);
+        const uint32_t shift = msb - kSubBucketBits;
+        return (shift + 1) * kSubBuckets + static_cast<uint32_t>((value >> shift) & (kSubBuckets - 1));
+    }
+
+    /// Smallest value that maps to a bucket.
+    static uint64_t bucketLowerBound(uint32_t index)
+    {
+        if (index < kSubBuckets)
+        {
+            return index;
+        }
+        const uint32_t shift = index / kSubBuckets - 1;
+        return (static_cast<uint64_t>(kSubBuckets + index % kSubBuckets)) << shift;
+    }
+
+    /// Number of distinct values that map to a bucket.
+    static uint64_t bucketWidth(uint32_t index)
+    {
+        return index < kSubBuckets ? 1 : static_cast<uint64_t>(1) << (index / kSubBuckets - 1);
+    }
+
+private:
+    static uint32_t mostSignificantBit(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+#else
+        uint32_t msb = 0;
+        while (value >>= 1)
+        {
+            ++msb;
+        }
+        return msb;
+#endif
+    }
+
+    uint64_t clampToObserved(uint64_t value) const
+    {
+        const uint64_t lo = m_min.load(std::memory_order_relaxed);
+        const uint64_t hi = m_max.load(std::memory_order_relaxed);
+        return value < lo ? lo : (value > hi ? hi : value);
+    }
+
+    std::atomic<uint64_t> m_buckets[kBucketCount];
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+};
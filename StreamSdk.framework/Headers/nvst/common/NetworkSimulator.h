@@ -0,0 +1,549 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file NetworkSimulator.h
+/// Deterministic network model and in-process video QoS simulation.
+///
+/// NvstNetworkLink models a path with a bottleneck of (possibly time-varying)
+/// bandwidth, a drop-tail queue, propagation delay with jitter, random and
+/// burst (Gilbert-Elliott) loss, and reordering. Time is virtual: packets carry
+/// their send time and the link computes their fate, so a run depends only on
+/// the configuration and seed and takes as long as the arithmetic.
+///
+/// NvstQosSimulator streams video frames over such a link and closes the loop
+/// with a reference bandwidth controller configured with the units of the
+/// NvscBWEstimator, NvscVqosBandwidth and NvscFecSettings settings. It reports
+/// achieved bitrate, frame loss and frame latency, so that QoS settings can be
+/// compared on the same network conditions within seconds.
+
+#pragma once
+
+#include "Histogram.h"
+
+#include <nvsc/DefineDefaultConfigs_auto.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+/// One step of a bandwidth trace.
+/// \ingroup Video
+typedef struct NvstNetworkBandwidthStep_t
+{
+    /// Duration of the step.
+    uint32_t durationMs;
+    /// Bottleneck bandwidth during the step; 0 is an outage.
+    uint32_t kbps;
+} NvstNetworkBandwidthStep;
+
+/// Configuration of NvstNetworkLink.
+/// Loss and reorder probabilities are in percent x1000, i.e. 1000 is 1%.
+/// \ingroup Video
+typedef struct NvstNetworkLinkConfig_t
+{
+    /// Constant bottleneck bandwidth, used without a bandwidth trace.
+    uint32_t bandwidthKbps;
+    /// Recorded or synthetic bandwidth, cycled; NULL for constant bandwidth.
+    const NvstNetworkBandwidthStep* bandwidthTrace;
+    uint32_t bandwidthTraceCount;
+    /// Propagation delay after the bottleneck.
+    uint32_t baseDelayUs;
+    /// Additional uniformly distributed delay in [0, jitterUs].
+    uint32_t jitterUs;
+    /// Recorded per-packet delay after the bottleneck, cycled; replaces baseDelayUs and jitterUs.
+    const uint32_t* delayTraceUs;
+    uint32_t delayTraceCount;
+    /// Bottleneck buffer, as the longest time a packet may wait to be sent; 0 is unlimited.
+    uint32_t queueLimitUs;
+    /// Independent loss probability.
+    uint32_t lossPercentX1000;
+    /// Probability of entering and leaving the burst state per packet.
+    uint32_t burstEnterPercentX1000;
+    uint32_t burstExitPercentX1000;
+    /// Loss probability in the burst state.
+    uint32_t burstLossPercentX1000;
+    /// Probability of a packet being held back by reorderDelayUs.
+    uint32_t reorderPercentX1000;
+    uint32_t reorderDelayUs;
+    /// Seed of the loss, jitter and reorder sequences.
+    uint64_t seed;
+} NvstNetworkLinkConfig;
+
+/// Default link: 50 Mbps, 10 ms delay, 1 ms jitter, 50 ms buffer, no loss.
+static inline void nvstNetworkLinkGetDefaultConfig(NvstNetworkLinkConfig* config)
+{
+    config->bandwidthKbps = 50000;
+    config->bandwidthTrace = NULL;
+    config->bandwidthTraceCount = 0;
+    config->baseDelayUs = 10000;
+    config->jitterUs = 1000;
+    config->delayTraceUs = NULL;
+    config->delayTraceCount = 0;
+    config->queueLimitUs = 50000;
+    config->lossPercentX1000 = 0;
+    config->burstEnterPercentX1000 = 0;
+    config->burstExitPercentX1000 = 100000;
+    config->burstLossPercentX1000 = 0;
+    config->reorderPercentX1000 = 0;
+    config->reorderDelayUs = 0;
+    config->seed = 1;
+}
+
+/// Counters of NvstNetworkLink.
+typedef struct NvstNetworkLinkStats_t
+{
+    uint64_t packets;
+    uint64_t bytes;
+    /// Packets dropped because the bottleneck buffer was full.
+    uint64_t queueDrops;
+    /// Packets lost by the independent loss model.
+    uint64_t randomLosses;
+    /// Packets lost in the burst state.
+    uint64_t burstLosses;
+    /// Packets delivered out of order.
+    uint64_t reordered;
+} NvstNetworkLinkStats;
+
+/// Deterministic model of a network path.
+/// Not thread-safe; use one link per simulation.
+/// \ingroup Video
+class NvstNetworkLink
+{
+public:
+    explicit NvstNetworkLink(const NvstNetworkLinkConfig& config)
+        : m_config(config)
+        , m_state(config.seed)
+    {
+        for (uint32_t i = 0; m_config.bandwidthTrace && i < m_config.bandwidthTraceCount; ++i)
+        {
+            m_traceDurationUs += m_config.bandwidthTrace[i].durationMs * 1000ull;
+        }
+    }
+
+    NvstNetworkLink(const NvstNetworkLink&) = delete;
+    NvstNetworkLink& operator=(const NvstNetworkLink&) = delete;
+
+    /// Send a packet. Send times must not decrease.
+    /// \param[in] sendUs Virtual time the packet enters the bottleneck queue.
+    /// \param[in] bytes Packet size on the wire.
+    /// \param[out] arrivalUs Virtual time the packet is received.
+    /// \return False if the packet was dropped or lost.
+    bool send(uint64_t sendUs, uint32_t bytes, uint64_t* arrivalUs)
+    {
+        ++m_stats.packets;
+        m_stats.bytes += bytes;
+
+        // Outages hold the queue until bandwidth returns, or until the buffer overflows.
+        uint64_t departUs = std::max(sendUs, m_linkFreeUs);
+        uint32_t kbps = bandwidthAt(departUs);
+        for (uint32_t step = 0; !kbps && m_traceDurationUs && step < m_config.bandwidthTraceCount; ++step)
+        {
+            departUs = nextStepUs(departUs);
+            kbps = bandwidthAt(departUs);
+        }
+        if (!kbps || (m_config.queueLimitUs && departUs - sendUs > m_config.queueLimitUs))
+        {
+            ++m_stats.queueDrops;
+            return false;
+        }
+        m_linkFreeUs = departUs + (bytes * 8000ull + kbps - 1) / kbps;
+
+        // Losses past the bottleneck still consume its bandwidth.
+        const bool wasBurst = m_burst;
+        m_burst = chance(m_burst ? 100000 - m_config.burstExitPercentX1000 : m_config.burstEnterPercentX1000);
+        if (wasBurst && chance(m_config.burstLossPercentX1000))
+        {
+            ++m_stats.burstLosses;
+            return false;
+        }
+        if (chance(m_config.lossPercentX1000))
+        {
+            ++m_stats.randomLosses;
+            return false;
+        }
+
+        uint64_t delayUs;
+        if (m_config.delayTraceUs && m_config.delayTraceCount)
+        {
+            delayUs = m_config.delayTraceUs[m_delayIndex++ % m_config.delayTraceCount];
+        }
+        else
+        {
+            delayUs = m_config.baseDelayUs + (m_config.jitterUs ? random() % (m_config.jitterUs + 1ull) : 0);
+        }
+        uint64_t arrival = m_linkFreeUs + delayUs;
+        if (chance(m_config.reorderPercentX1000))
+        {
+            ++m_stats.reordered;
+            arrival = std::max(arrival, m_lastArrivalUs) + m_config.reorderDelayUs;
+        }
+        else
+        {
+            // The path is FIFO apart from explicit reordering.
+            arrival = std::max(arrival, m_lastArrivalUs);
+            m_lastArrivalUs = arrival;
+        }
+        *arrivalUs = arrival;
+        return true;
+    }
+
+    /// \return Bottleneck bandwidth at the given time.
+    uint32_t bandwidthAt(uint64_t timeUs) const
+    {
+        if (!m_traceDurationUs)
+        {
+            return m_config.bandwidthKbps;
+        }
+        uint64_t offsetUs = timeUs % m_traceDurationUs;
+        for (uint32_t i = 0; i < m_config.bandwidthTraceCount; ++i)
+        {
+            const uint64_t durationUs = m_config.bandwidthTrace[i].durationMs * 1000ull;
+            if (offsetUs < durationUs)
+            {
+                return m_config.bandwidthTrace[i].kbps;
+            }
+            offsetUs -= durationUs;
+        }
+        return m_config.bandwidthKbps;
+    }
+
+    const NvstNetworkLinkStats& getStats() const { return m_stats; }
+
+private:
+    uint64_t nextStepUs(uint64_t timeUs) const
+    {
+        const uint64_t cycleUs = timeUs - timeUs % m_traceDurationUs;
+        uint64_t endUs = 0;
+        for (uint32_t i = 0; i < m_config.bandwidthTraceCount; ++i)
+        {
+            endUs += m_config.bandwidthTrace[i].durationMs * 1000ull;
+            if (cycleUs + endUs > timeUs)
+            {
+                return cycleUs + endUs;
+            }
+        }
+        return cycleUs + m_traceDurationUs;
+    }
+
+    bool chance(uint32_t percentX1000) { return percentX1000 && random() % 100000 < percentX1000; }
+
+    uint64_t random()
+    {
+        // splitmix64
+        uint64_t z = (m_state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    NvstNetworkLinkConfig m_config;
+    uint64_t m_state;
+    uint64_t m_traceDurationUs = 0;
+    uint64_t m_linkFreeUs = 0;
+    uint64_t m_lastArrivalUs = 0;
+    uint64_t m_delayIndex = 0;
+    bool m_burst = false;
+    NvstNetworkLinkStats m_stats = {};
+};
+
+/// Callback invoked on every bitrate update of NvstQosSimulator.
+typedef void (*NVST_QOS_SIM_UPDATE_PROC)(void* context, uint64_t timeUs, uint32_t bitrateKbps);
+
+/// Configuration of NvstQosSimulator.
+/// \ingroup Video
+typedef struct NvstQosSimulatorConfig_t
+{
+    /// Simulated streaming time.
+    uint32_t durationMs;
+    uint32_t fps;
+    /// Packet size on the wire (DEFAULT_ENET_MTU_SIZE).
+    uint32_t packetSize;
+    /// Video bitrate range (NvscVqosBandwidth).
+    uint32_t initialBitrateKbps;
+    uint32_t minimumBitrateKbps;
+    uint32_t maximumBitrateKbps;
+    /// NvscFecSettings::repairPercent; 0 disables FEC.
+    uint32_t fecRepairPercent;
+    /// NvscBWEstimator::iirFilterFactor: one-way delay filter, new = old + (sample - old) / factor.
+    uint32_t iirFilterFactor;
+    /// NvscBWEstimator::owdSlidingWindowLengthInFrames: window of the one-way delay baseline.
+    uint32_t owdSlidingWindowLengthInFrames;
+    /// NvscBWEstimator::rateLimitRatio: on congestion, the bitrate is limited to this percentage of
+    /// the received bitrate.
+    uint32_t rateLimitRatio;
+    /// NvscBWEstimator::stepUpLimitPercent, increase limit in percent of the current bitrate.
+    uint16_t stepUpLimitPercent;
+    /// NvscBWEstimator::maxStepUpPercent, increase in percent of the initial bitrate.
+    uint8_t maxStepUpPercent;
+    /// NvscBWEstimator::stepDownPercent.
+    uint16_t stepDownPercent;
+    /// NvscBWEstimator::updatesPerSecond.
+    uint16_t updatesPerSecond;
+    /// NvscBWEstimator::fecLimitForBitrateIncrease: no increase while the percentage of frames that
+    /// needed FEC exceeds this.
+    uint8_t fecLimitForBitrateIncrease;
+    /// Percentage of unrecoverable frames per update that counts as congestion.
+    uint32_t lossThresholdPercent;
+    /// Rise of the filtered one-way delay above its baseline that counts as congestion.
+    uint32_t owdRiseThresholdUs;
+    /// Delay of feedback from client to server; the feedback path is lossless.
+    uint32_t feedbackDelayUs;
+    /// Optional bitrate timeline callback.
+    NVST_QOS_SIM_UPDATE_PROC updateProc;
+    void* context;
+} NvstQosSimulatorConfig;
+
+/// Default configuration: 60 seconds at 60 fps with the SDK's QoS defaults
+/// (DefineDefaultConfigs_auto.h), starting at the maximum bitrate. The update rate,
+/// congestion thresholds and feedback delay have no SDK setting and belong to the
+/// reference controller.
+static inline void nvstQosSimulatorGetDefaultConfig(NvstQosSimulatorConfig* config)
+{
+    config->durationMs = 60000;
+    config->fps = 60;
+    config->packetSize = DEFAULT_ENET_MTU_SIZE;
+    config->initialBitrateKbps = DEFAULT_VIDEO_QOS_BANDWIDTH_MAXIMUM_BITRATE;
+    config->minimumBitrateKbps = DEFAULT_VIDEO_QOS_BANDWIDTH_MINIMUM_BITRATE;
+    config->maximumBitrateKbps = DEFAULT_VIDEO_QOS_BANDWIDTH_MAXIMUM_BITRATE;
+    config->fecRepairPercent = DEFAULT_FEC_REPAIR_PERCENT;
+    config->iirFilterFactor = DEFAULT_NVSC_BWE_IIR_FILTER_FACTOR;
+    config->owdSlidingWindowLengthInFrames = DEFAULT_NVSC_BWE_OWD_SLIDING_WINDOW_FRAMES;
+    config->rateLimitRatio = DEFAULT_NVSC_BWE_RATE_LIMIT_RATIO;
+    config->stepUpLimitPercent = DEFAULT_QOS_BITRATE_STEP_UP_LIMIT_PERCENT;
+    config->maxStepUpPercent = DEFAULT_QOS_MAX_BITRATE_STEP_UP_PERCENT;
+    config->stepDownPercent = DEFAULT_QOS_BITRATE_STEP_DOWN_PERCENT;
+    config->updatesPerSecond = 2;
+    config->fecLimitForBitrateIncrease = DEFAULT_FEC_THRESHOLD_SKIP_BITRATE_INCREASE;
+    config->lossThresholdPercent = 1;
+    config->owdRiseThresholdUs = 10000;
+    config->feedbackDelayUs = 10000;
+    config->updateProc = NULL;
+    config->context = NULL;
+}
+
+/// Outcome of a QoS simulation.
+/// \ingroup Video
+typedef struct NvstQosSimulationResult_t
+{
+    /// Video bitrate of the frames that could be decoded.
+    double achievedBitrateKbps;
+    /// Mean bitrate requested by the controller.
+    double meanTargetBitrateKbps;
+    /// Percent of frames that could not be decoded.
+    double frameLossPercent;
+    /// Percent of packets dropped or lost on the link.
+    double packetLossPercent;
+    /// Percent of frames that lost packets but were recovered by FEC.
+    double fecRecoveredPercent;
+    /// Capture to frame completion of the decodable frames.
+    NvstHistogramSummary latencyUs;
+    uint32_t bitrateIncreases;
+    uint32_t bitrateDecreases;
+    NvstNetworkLinkStats link;
+} NvstQosSimulationResult;
+
+/// Streams video over an NvstNetworkLink with a reference bandwidth controller.
+///
+/// Frames of bitrate / fps bytes are split into packets plus FEC repair packets
+/// and sent back to back at capture time. A frame is decodable if at least its
+/// source packet count arrives (ideal erasure code) and completes with that
+/// packet. The client reports each frame once it completes or its last packet
+/// arrives; the report reaches the server feedbackDelayUs later. Every update
+/// interval, the server lowers the bitrate on frame loss or a one-way delay rise
+/// and otherwise raises it.
+/// \ingroup Video
+class NvstQosSimulator
+{
+public:
+    NvstQosSimulator(const NvstQosSimulatorConfig& config, const NvstNetworkLinkConfig& link)
+        : m_config(config)
+        , m_link(link)
+    {
+    }
+
+    /// Run the simulation. Deterministic and thread-safe; simulations share nothing.
+    NvstQosSimulationResult run() const
+    {
+        struct Report
+        {
+            uint64_t knownUs;
+            uint64_t owdUs;
+            uint32_t bytes;
+            bool decoded;
+            bool repaired;
+        };
+
+        NvstQosSimulationResult result = {};
+        if (!m_config.fps || !m_config.packetSize || !m_config.updatesPerSecond)
+        {
+            return result;
+        }
+        NvstNetworkLink link(m_link);
+        NvstHistogram latency;
+        std::deque<Report> reports;
+        std::deque<std::pair<uint64_t, uint64_t>> owdWindow;
+        std::vector<uint64_t> arrivals;
+
+        const uint64_t durationUs = m_config.durationMs * 1000ull;
+        const uint64_t updateIntervalUs = 1000000ull / m_config.updatesPerSecond;
+        uint64_t nextUpdateUs = updateIntervalUs;
+        uint32_t bitrateKbps = m_config.initialBitrateKbps;
+        double filteredOwdUs = -1.0;
+        uint64_t reportIndex = 0;
+        uint64_t frames = 0;
+        uint64_t lostFrames = 0;
+        uint64_t repairedFrames = 0;
+        uint64_t decodedBits = 0;
+        double bitrateSum = 0.0;
+
+        uint32_t windowFrames = 0;
+        uint32_t windowLost = 0;
+        uint32_t windowRepaired = 0;
+        uint64_t windowBytes = 0;
+
+        for (uint64_t frame = 0;; ++frame)
+        {
+            const uint64_t captureUs = frame * 1000000ull / m_config.fps;
+            if (captureUs >= durationUs)
+            {
+                break;
+            }
+
+            while (nextUpdateUs <= captureUs)
+            {
+                // Consume the reports that reached the server by this update.
+                while (!reports.empty() && reports.front().knownUs <= nextUpdateUs)
+                {
+                    const Report& report = reports.front();
+                    ++windowFrames;
+                    windowLost += report.decoded ? 0 : 1;
+                    windowRepaired += report.repaired ? 1 : 0;
+                    windowBytes += report.decoded ? report.bytes : 0;
+                    if (report.owdUs != UINT64_MAX)
+                    {
+                        filteredOwdUs = filteredOwdUs < 0
+                            ? report.owdUs
+                            : filteredOwdUs + (report.owdUs - filteredOwdUs) / std::max(1u, m_config.iirFilterFactor);
+                        while (!owdWindow.empty() && owdWindow.back().second >= report.owdUs)
+                        {
+                            owdWindow.pop_back();
+                        }
+                        owdWindow.emplace_back(reportIndex, report.owdUs);
+                    }
+                    while (!owdWindow.empty() &&
+                           owdWindow.front().first + std::max(1u, m_config.owdSlidingWindowLengthInFrames) <= reportIndex)
+                    {
+                        owdWindow.pop_front();
+                    }
+                    ++reportIndex;
+                    reports.pop_front();
+                }
+
+                if (windowFrames)
+                {
+                    const double riseUs = owdWindow.empty() ? 0.0 : filteredOwdUs - owdWindow.front().second;
+                    const bool lossy = windowLost * 100ull > static_cast<uint64_t>(m_config.lossThresholdPercent) * windowFrames;
+                    const uint32_t previousKbps = bitrateKbps;
+                    if (lossy || riseUs > m_config.owdRiseThresholdUs)
+                    {
+                        uint64_t kbps = static_cast<uint64_t>(bitrateKbps) * (100 - std::min<uint32_t>(m_config.stepDownPercent, 100)) / 100;
+                        const uint64_t receivedKbps = windowBytes * 8000 / updateIntervalUs;
+                        kbps = std::min(kbps, receivedKbps * m_config.rateLimitRatio / 100);
+                        bitrateKbps = static_cast<uint32_t>(std::max<uint64_t>(kbps, m_config.minimumBitrateKbps));
+                    }
+                    else if (windowRepaired * 100ull <= static_cast<uint64_t>(m_config.fecLimitForBitrateIncrease) * windowFrames)
+                    {
+                        const uint64_t step = std::min<uint64_t>(
+                            static_cast<uint64_t>(m_config.initialBitrateKbps) * m_config.maxStepUpPercent / 100,
+                            static_cast<uint64_t>(bitrateKbps) * m_config.stepUpLimitPercent / 100);
+                        bitrateKbps = static_cast<uint32_t>(std::min<uint64_t>(bitrateKbps + step, m_config.maximumBitrateKbps));
+                    }
+                    result.bitrateDecreases += bitrateKbps < previousKbps ? 1 : 0;
+                    result.bitrateIncreases += bitrateKbps > previousKbps ? 1 : 0;
+                    if (bitrateKbps != previousKbps && m_config.updateProc)
+                    {
+                        m_config.updateProc(m_config.context, nextUpdateUs, bitrateKbps);
+                    }
+                }
+                windowFrames = windowLost = windowRepaired = 0;
+                windowBytes = 0;
+                nextUpdateUs += updateIntervalUs;
+            }
+
+            const uint32_t bytes = static_cast<uint32_t>(bitrateKbps * 1000ull / 8 / m_config.fps);
+            const uint32_t sourcePackets = std::max(1u, (bytes + m_config.packetSize - 1) / m_config.packetSize);
+            const uint32_t repairPackets = (sourcePackets * m_config.fecRepairPercent + 99) / 100;
+            arrivals.clear();
+            for (uint32_t i = 0; i < sourcePackets + repairPackets; ++i)
+            {
+                uint64_t arrivalUs;
+                if (link.send(captureUs, m_config.packetSize, &arrivalUs))
+                {
+                    arrivals.push_back(arrivalUs);
+                }
+            }
+
+            Report report = {};
+            report.bytes = bytes;
+            report.decoded = arrivals.size() >= sourcePackets;
+            report.repaired = report.decoded && arrivals.size() < sourcePackets + repairPackets;
+            report.owdUs = arrivals.empty() ? UINT64_MAX : *std::min_element(arrivals.begin(), arrivals.end()) - captureUs;
+            report.knownUs = captureUs;
+            if (report.decoded)
+            {
+                std::nth_element(arrivals.begin(), arrivals.begin() + (sourcePackets - 1), arrivals.end());
+                const uint64_t completeUs = arrivals[sourcePackets - 1];
+                latency.record(completeUs - captureUs);
+                decodedBits += bytes * 8ull;
+                report.knownUs = completeUs;
+            }
+            else if (!arrivals.empty())
+            {
+                report.knownUs = *std::max_element(arrivals.begin(), arrivals.end());
+            }
+            report.knownUs += m_config.feedbackDelayUs;
+            // Reports reach the server in frame order.
+            if (!reports.empty())
+            {
+                report.knownUs = std::max(report.knownUs, reports.back().knownUs);
+            }
+            reports.push_back(report);
+
+            ++frames;
+            lostFrames += report.decoded ? 0 : 1;
+            repairedFrames += report.repaired ? 1 : 0;
+            bitrateSum += bitrateKbps;
+        }
+
+        const NvstNetworkLinkStats& stats = link.getStats();
+        result.link = stats;
+        result.latencyUs = latency.summary();
+        if (frames)
+        {
+            result.achievedBitrateKbps = decodedBits / (durationUs / 1000.0);
+            result.meanTargetBitrateKbps = bitrateSum / frames;
+            result.frameLossPercent = 100.0 * lostFrames / frames;
+            result.fecRecoveredPercent = 100.0 * repairedFrames / frames;
+        }
+        if (stats.packets)
+        {
+            result.packetLossPercent =
+                100.0 * (stats.queueDrops + stats.randomLosses + stats.burstLosses) / stats.packets;
+        }
+        return result;
+    }
+
+private:
+    NvstQosSimulatorConfig m_config;
+    NvstNetworkLinkConfig m_link;
+};
@@ -0,0 +1,822 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file QuantileEstimator.h
+/// Streaming quantile estimators for frame pacing history.
+///
+/// NvstQuantileEstimator tracks one quantile of a stream of samples, such as
+/// frame arrival jitter or render times, with one of several methods:
+/// - MOVING: stochastic approximation, the "moving quantile" of NvscFramePacingJitterHistory.
+/// - WINDOWED: the explicit quantileWindowSize / quantileWindowStep window, sorted on every step.
+///   Kept as the reference the others are measured against.
+/// - P2: the P-square algorithm of Jain and Chlamtac; five markers.
+/// - TDIGEST: merging t-digest with the arcsine scale function.
+/// - LOG_HISTOGRAM: fixed log-spaced bins with a bounded relative error.
+///
+/// All but WINDOWED use constant memory and constant amortized time per sample.
+/// P2, TDIGEST and LOG_HISTOGRAM forget old samples with a half-life, so they
+/// follow changing network conditions like the moving estimate does.
+
+#pragma once
+
+#include <nvst/common/Result.h>
+#include <nvsc/NvscClientConfig_auto.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/// Estimation modes that extend NvscFramePacingJitterEstimationMode and
+/// NvscFramePacingRenderEstimationMode, whose generated values end at 1 (NORMAL).
+#define NVST_FRAME_PACING_ESTIMATION_MODE_P2 2
+#define NVST_FRAME_PACING_ESTIMATION_MODE_TDIGEST 3
+#define NVST_FRAME_PACING_ESTIMATION_MODE_LOG_HISTOGRAM 4
+
+/// Largest supported t-digest compression.
+#define NVST_TDIGEST_MAX_COMPRESSION 400
+/// Largest number of log histogram bins.
+#define NVST_LOG_HISTOGRAM_MAX_BINS 2048
+
+/// Method used by NvstQuantileEstimator.
+/// \ingroup Video
+typedef enum NvstQuantileEstimatorMode_t
+{
+    NVST_QUANTILE_ESTIMATOR_MOVING = 0,
+    NVST_QUANTILE_ESTIMATOR_WINDOWED = 1,
+    NVST_QUANTILE_ESTIMATOR_P2 = 2,
+    NVST_QUANTILE_ESTIMATOR_TDIGEST = 3,
+    NVST_QUANTILE_ESTIMATOR_LOG_HISTOGRAM = 4,
+} NvstQuantileEstimatorMode;
+
+/// Configuration of NvstQuantileEstimator.
+/// \ingroup Video
+typedef struct NvstQuantileEstimatorConfig_t
+{
+    NvstQuantileEstimatorMode mode;
+    /// Tracked quantile in (0, 1).
+    double quantile;
+    /// MOVING: step in units of the sample spread (quantileConvergenceX10000 / 10000).
+    double convergence;
+    /// WINDOWED: samples in the window, and samples between recalculations.
+    uint32_t windowSize;
+    uint32_t windowStep;
+    /// P2, TDIGEST, LOG_HISTOGRAM: samples after which a sample counts half. 0 never forgets.
+    uint32_t halfLifeSamples;
+    /// TDIGEST: compression; more centroids are more accurate at the tails.
+    uint32_t compression;
+    /// LOG_HISTOGRAM: covered value range; samples outside are clamped. minValue must be positive.
+    double minValue;
+    double maxValue;
+    /// LOG_HISTOGRAM: relative error of the returned value.
+    double relativeError;
+} NvstQuantileEstimatorConfig;
+
+/// Default configuration: moving 99.7th percentile as in the default jitter history,
+/// and parameters for the other modes suited to values in microseconds.
+static inline void nvstQuantileEstimatorGetDefaultConfig(NvstQuantileEstimatorConfig* config)
+{
+    config->mode = NVST_QUANTILE_ESTIMATOR_MOVING;
+    config->quantile = 0.997;
+    config->convergence = 0.002;
+    config->windowSize = 3600;
+    config->windowStep = 1;
+    config->halfLifeSamples = 3600;
+    config->compression = 100;
+    config->minValue = 1.0;
+    config->maxValue = 1e6;
+    config->relativeError = 0.01;
+}
+
+/// Fill a configuration from the fields of NvscFramePacingJitterHistory or NvscFramePacingRenderHistory.
+/// \param[in] estimationMode jitterEstimationMode / renderEstimationMode, or NVST_FRAME_PACING_ESTIMATION_MODE_*.
+/// \param[in] quantileX1000 quantileX1000.
+/// \param[in] quantileConvergenceX10000 quantileConvergenceX10000.
+/// \param[in] windowSize quantileWindowSize; nonzero selects WINDOWED for the generated QUANTILE mode.
+/// \param[in] windowStep quantileWindowStep.
+/// \param[in] n n, the approximate history length; used as the half-life.
+/// \param[in,out] config Configuration to update; fields not covered by the history keep their values.
+/// \retval NVST_R_INVALID_ENUM for the gaussian NORMAL mode, which is not a quantile estimate
+/// \retval NVST_R_SUCCESS otherwise
+static inline NvstResult nvstQuantileEstimatorConfigFromHistory(
+    uint32_t estimationMode,
+    uint32_t quantileX1000,
+    uint32_t quantileConvergenceX10000,
+    uint32_t windowSize,
+    uint32_t windowStep,
+    uint32_t n,
+    NvstQuantileEstimatorConfig* config)
+{
+    switch (estimationMode)
+    {
+    case FRAME_PACING_JITTER_ESTIMATION_MODE_QUANTILE:
+        config->mode = windowSize ? NVST_QUANTILE_ESTIMATOR_WINDOWED : NVST_QUANTILE_ESTIMATOR_MOVING;
+        break;
+    case NVST_FRAME_PACING_ESTIMATION_MODE_P2:
+        config->mode = NVST_QUANTILE_ESTIMATOR_P2;
+        break;
+    case NVST_FRAME_PACING_ESTIMATION_MODE_TDIGEST:
+        config->mode = NVST_QUANTILE_ESTIMATOR_TDIGEST;
+        break;
+    case NVST_FRAME_PACING_ESTIMATION_MODE_LOG_HISTOGRAM:
+        config->mode = NVST_QUANTILE_ESTIMATOR_LOG_HISTOGRAM;
+        break;
+    default:
+        return NVST_R_INVALID_ENUM;
+    }
+    config->quantile = quantileX1000 / 1000.0;
+    config->convergence = quantileConvergenceX10000 / 10000.0;
+    config->windowSize = windowSize;
+    config->windowStep = windowStep ? windowStep : 1;
+    config->halfLifeSamples = n;
+    return NVST_R_SUCCESS;
+}
+
+namespace nvst_quantile
+{
+/// Weight growth for forward decay: weighting sample i by g^i and rescaling now and then
+/// is equivalent to halving all previous weights every halfLife samples.
+static inline double decayGrowth(uint32_t halfLifeSamples)
+{
+    return halfLifeSamples ? std::pow(2.0, 1.0 / halfLifeSamples) : 1.0;
+}
+
+/// Weights are rescaled once the next sample's weight passes this.
+static const double kRescaleWeight = 1e100;
+
+static const double kPi = 3.14159265358979323846;
+} // namespace nvst_quantile
+
+/// Stochastic approximation of a quantile with a step proportional to the sample spread.
+/// \ingroup Video
+class NvstMovingQuantile
+{
+public:
+    void init(double quantile, double convergence)
+    {
+        m_quantile = quantile;
+        m_convergence = convergence;
+        reset();
+    }
+
+    void reset()
+    {
+        m_estimate = 0.0;
+        m_spread = 0.0;
+        m_count = 0;
+    }
+
+    void add(double value)
+    {
+        if (!m_count++)
+        {
+            m_estimate = value;
+            return;
+        }
+        const double deviation = std::fabs(value - m_estimate);
+        m_spread += (deviation - m_spread) / 64.0;
+        const double step = m_spread * m_convergence;
+        m_estimate += value > m_estimate ? step * m_quantile : -step * (1.0 - m_quantile);
+    }
+
+    double estimate() const { return m_estimate; }
+    uint64_t count() const { return m_count; }
+
+private:
+    double m_quantile = 0.5;
+    double m_convergence = 0.002;
+    double m_estimate = 0.0;
+    double m_spread = 0.0;
+    uint64_t m_count = 0;
+};
+
+/// Quantile of the last windowSize samples, recalculated by sorting every windowStep samples.
+/// \ingroup Video
+class NvstWindowedQuantile
+{
+public:
+    void init(double quantile, uint32_t windowSize, uint32_t windowStep)
+    {
+        m_quantile = quantile;
+        m_window.assign(windowSize ? windowSize : 1, 0.0);
+        m_sorted.reserve(m_window.size());
+        m_step = windowStep ? windowStep : 1;
+        reset();
+    }
+
+    void reset()
+    {
+        m_next = 0;
+        m_count = 0;
+        m_sinceUpdate = 0;
+        m_estimate = 0.0;
+    }
+
+    void add(double value)
+    {
+        m_window[m_next] = value;
+        m_next = m_next + 1 == m_window.size() ? 0 : m_next + 1;
+        ++m_count;
+        if (++m_sinceUpdate >= m_step || m_count == 1)
+        {
+            m_sinceUpdate = 0;
+            // Until the window is full the samples occupy its start.
+            const size_t size = m_count < m_window.size() ? static_cast<size_t>(m_count) : m_window.size();
+            m_sorted.assign(m_window.begin(), m_window.begin() + static_cast<std::ptrdiff_t>(size));
+            std::sort(m_sorted.begin(), m_sorted.end());
+            const size_t rank = static_cast<size_t>(m_quantile * (m_sorted.size() - 1) + 0.5);
+            m_estimate = m_sorted[rank];
+        }
+    }
+
+    double estimate() const { return m_estimate; }
+    uint64_t count() const { return m_count; }
+
+private:
+    double m_quantile = 0.5;
+    std::vector<double> m_window;
+    std::vector<double> m_sorted;
+    uint32_t m_step = 1;
+    size_t m_next = 0;
+    uint64_t m_count = 0;
+    uint32_t m_sinceUpdate = 0;
+    double m_estimate = 0.0;
+};
+
+/// P-square estimate of a single quantile from five markers.
+///
+/// The algorithm has no notion of forgetting, so with a half-life two estimators run
+/// staggered: each restarts after two half-lives, and the older one answers.
+/// \ingroup Video
+class NvstP2Quantile
+{
+public:
+    void init(double quantile, uint32_t halfLifeSamples)
+    {
+        m_quantile = quantile;
+        m_halfLife = halfLifeSamples;
+        reset();
+    }
+
+    void reset()
+    {
+        m_markers[0].reset(m_quantile);
+        m_markers[1].reset(m_quantile);
+        m_count = 0;
+    }
+
+    void add(double value)
+    {
+        if (m_halfLife)
+        {
+            // The second estimator starts one half-life after the first.
+            if (m_count == m_halfLife)
+            {
+                m_markers[1].reset(m_quantile);
+            }
+            for (Markers& markers : m_markers)
+            {
+                if (markers.count >= 2ull * m_halfLife)
+                {
+                    markers.reset(m_quantile);
+                }
+            }
+            m_markers[0].add(value);
+            if (m_count >= m_halfLife)
+            {
+                m_markers[1].add(value);
+            }
+        }
+        else
+        {
+            m_markers[0].add(value);
+        }
+        ++m_count;
+    }
+
+    double estimate() const
+    {
+        const Markers& older = m_markers[1].count > m_markers[0].count ? m_markers[1] : m_markers[0];
+        return older.estimate();
+    }
+
+    uint64_t count() const { return m_count; }
+
+private:
+    struct Markers
+    {
+        double heights[5];
+        double positions[5];
+        double desired[5];
+        double increments[5];
+        double p;
+        uint64_t count;
+
+        void reset(double quantile)
+        {
+            p = quantile;
+            count = 0;
+            for (int i = 0; i < 5; ++i)
+            {
+                positions[i] = i + 1;
+                heights[i] = 0.0;
+            }
+            desired[0] = 1;
+            desired[1] = 1 + 2 * p;
+            desired[2] = 1 + 4 * p;
+            desired[3] = 3 + 2 * p;
+            desired[4] = 5;
+            increments[0] = 0;
+            increments[1] = p / 2;
+            increments[2] = p;
+            increments[3] = (1 + p) / 2;
+            increments[4] = 1;
+        }
+
+        void add(double value)
+        {
+            if (count < 5)
+            {
+                heights[count++] = value;
+                if (count == 5)
+                {
+                    std::sort(heights, heights + 5);
+                }
+                return;
+            }
+            ++count;
+            int cell;
+            if (value < heights[0])
+            {
+                heights[0] = value;
+                cell = 0;
+            }
+            else if (value >= heights[4])
+            {
+                heights[4] = value;
+                cell = 3;
+            }
+            else
+            {
+                cell = 0;
+                while (value >= heights[cell + 1])
+                {
+                    ++cell;
+                }
+            }
+            for (int i = cell + 1; i < 5; ++i)
+            {
+                positions[i] += 1;
+            }
+            for (int i = 0; i < 5; ++i)
+            {
+                desired[i] += increments[i];
+            }
+            for (int i = 1; i < 4; ++i)
+            {
+                const double d = desired[i] - positions[i];
+                if ((d >= 1 && positions[i + 1] - positions[i] > 1) || (d <= -1 && positions[i - 1] - positions[i] < -1))
+                {
+                    const int sign = d > 0 ? 1 : -1;
+                    const double parabolic = heights[i] +
+                        sign / (positions[i + 1] - positions[i - 1]) *
+                            ((positions[i] - positions[i - 1] + sign) * (heights[i + 1] - heights[i]) /
+                                 (positions[i + 1] - positions[i]) +
+                             (positions[i + 1] - positions[i] - sign) * (heights[i] - heights[i - 1]) /
+                                 (positions[i] - positions[i - 1]));
+                    if (heights[i - 1] < parabolic && parabolic < heights[i + 1])
+                    {
+                        heights[i] = parabolic;
+                    }
+                    else
+                    {
+                        heights[i] += sign * (heights[i + sign] - heights[i]) / (positions[i + sign] - positions[i]);
+                    }
+                    positions[i] += sign;
+                }
+            }
+        }
+
+        double estimate() const
+        {
+            if (count >= 5)
+            {
+                return heights[2];
+            }
+            if (!count)
+            {
+                return 0.0;
+            }
+            // Too few samples for the markers; use the exact quantile.
+            double sorted[5];
+            std::copy(heights, heights + count, sorted);
+            std::sort(sorted, sorted + count);
+            return sorted[static_cast<size_t>(p * (count - 1) + 0.5)];
+        }
+    };
+
+    double m_quantile = 0.5;
+    uint32_t m_halfLife = 0;
+    Markers m_markers[2];
+    uint64_t m_count = 0;
+};
+
+/// Merging t-digest in fixed storage.
+/// \ingroup Video
+class NvstTDigest
+{
+public:
+    void init(double quantile, uint32_t compression, uint32_t halfLifeSamples)
+    {
+        m_quantile = quantile;
+        m_compression = compression < 10 ? 10 : (compression > NVST_TDIGEST_MAX_COMPRESSION ? NVST_TDIGEST_MAX_COMPRESSION : compression);
+        m_growth = nvst_quantile::decayGrowth(halfLifeSamples);
+        reset();
+    }
+
+    void reset()
+    {
+        m_centroidCount = 0;
+        m_bufferCount = 0;
+        m_weight = 1.0;
+        m_count = 0;
+        m_min = 0.0;
+        m_max = 0.0;
+        m_estimate = 0.0;
+    }
+
+    void add(double value)
+    {
+        if (!m_count++)
+        {
+            m_min = m_max = value;
+        }
+        m_min = value < m_min ? value : m_min;
+        m_max = value > m_max ? value : m_max;
+        m_buffer[m_bufferCount].mean = value;
+        m_buffer[m_bufferCount].weight = m_weight;
+        m_weight *= m_growth;
+        if (++m_bufferCount == bufferCapacity() || m_weight > nvst_quantile::kRescaleWeight)
+        {
+            merge();
+        }
+    }
+
+    /// \return Estimate as of the last merge; samples are merged every compression samples.
+    double estimate()
+    {
+        if (!m_centroidCount && m_bufferCount)
+        {
+            merge();
+        }
+        return m_estimate;
+    }
+
+    uint64_t count() const { return m_count; }
+
+    /// \return Number of centroids after the last merge.
+    uint32_t centroidCount() const { return m_centroidCount; }
+
+private:
+    struct Centroid
+    {
+        double mean;
+        double weight;
+    };
+
+    uint32_t bufferCapacity() const { return m_compression; }
+
+    /// Scale function k1 and its inverse.
+    double k(double q) const { return m_compression / (2 * nvst_quantile::kPi) * std::asin(2 * q - 1); }
+    double q(double k) const { return (std::sin(k * 2 * nvst_quantile::kPi / m_compression) + 1) / 2; }
+
+    /// Estimate from the merged centroids.
+    double interpolate() const
+    {
+        if (!m_centroidCount)
+        {
+            return 0.0;
+        }
+        if (m_centroidCount == 1)
+        {
+            return m_centroids[0].mean;
+        }
+        double total = 0.0;
+        for (uint32_t i = 0; i < m_centroidCount; ++i)
+        {
+            total += m_centroids[i].weight;
+        }
+        const double target = m_quantile * total;
+        // Centroid i represents the weight around its center; interpolate between centers.
+        double cumulative = m_centroids[0].weight / 2;
+        if (target < cumulative)
+        {
+            return m_min + (m_centroids[0].mean - m_min) * target / cumulative;
+        }
+        for (uint32_t i = 1; i < m_centroidCount; ++i)
+        {
+            const double gap = (m_centroids[i - 1].weight + m_centroids[i].weight) / 2;
+            if (target < cumulative + gap)
+            {
+                const double t = (target - cumulative) / gap;
+                return m_centroids[i - 1].mean + t * (m_centroids[i].mean - m_centroids[i - 1].mean);
+            }
+            cumulative += gap;
+        }
+        const double last = m_centroids[m_centroidCount - 1].weight / 2;
+        const double t = last > 0 ? (target - cumulative) / last : 1.0;
+        const double mean = m_centroids[m_centroidCount - 1].mean;
+        return mean + (m_max - mean) * (t < 1.0 ? t : 1.0);
+    }
+
+    void merge()
+    {
+        std::sort(m_buffer, m_buffer + m_bufferCount,
+                  [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+        std::merge(m_centroids, m_centroids + m_centroidCount, m_buffer, m_buffer + m_bufferCount, m_scratch,
+                   [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+        const uint32_t inputs = m_centroidCount + m_bufferCount;
+        m_bufferCount = 0;
+
+        // Rescale before the forward decay weights overflow.
+        double scale = 1.0;
+        if (m_weight > nvst_quantile::kRescaleWeight)
+        {
+            scale = 1.0 / m_weight;
+            m_weight = 1.0;
+        }
+        double total = 0.0;
+        for (uint32_t i = 0; i < inputs; ++i)
+        {
+            m_scratch[i].weight *= scale;
+            total += m_scratch[i].weight;
+        }
+
+        m_centroidCount = 0;
+        Centroid current = m_scratch[0];
+        double soFar = 0.0;
+        double limit = total * q(k(0.0) + 1);
+        for (uint32_t i = 1; i < inputs; ++i)
+        {
+            const Centroid& next = m_scratch[i];
+            // The k1 bound keeps the count at the compression; the capacity check is a backstop.
+            if (soFar + current.weight + next.weight <= limit || m_centroidCount + 1 >= kCentroidCapacity)
+            {
+                current.mean += (next.mean - current.mean) * next.weight / (current.weight + next.weight);
+                current.weight += next.weight;
+            }
+            else
+            {
+                soFar += current.weight;
+                m_centroids[m_centroidCount++] = current;
+                limit = total * q(k(soFar / total) + 1);
+                current = next;
+            }
+        }
+        m_centroids[m_centroidCount++] = current;
+        m_estimate = interpolate();
+    }
+
+    double m_quantile = 0.5;
+    uint32_t m_compression = 100;
+    double m_growth = 1.0;
+    double m_weight = 1.0;
+    uint64_t m_count = 0;
+    double m_min = 0.0;
+    double m_max = 0.0;
+    double m_estimate = 0.0;
+    uint32_t m_centroidCount = 0;
+    uint32_t m_bufferCount = 0;
+    static const uint32_t kCentroidCapacity = NVST_TDIGEST_MAX_COMPRESSION + 8;
+    Centroid m_centroids[kCentroidCapacity];
+    Centroid m_buffer[NVST_TDIGEST_MAX_COMPRESSION];
+    Centroid m_scratch[2 * NVST_TDIGEST_MAX_COMPRESSION + 8];
+};
+
+/// Quantile from log-spaced bins; the value returned is within relativeError of a sample
+/// at the requested rank, as long as the samples are inside [minValue, maxValue].
+/// \ingroup Video
+class NvstLogHistogramQuantile
+{
+public:
+    void init(double quantile, double minValue, double maxValue, double relativeError, uint32_t halfLifeSamples)
+    {
+        m_quantile = quantile;
+        m_minValue = minValue > 0 ? minValue : 1.0;
+        m_maxValue = maxValue > m_minValue ? maxValue : m_minValue * 2;
+        const double gamma = 1 + 2 * (relativeError > 1e-6 ? relativeError : 1e-6);
+        m_logGamma = std::log(gamma);
+        const double bins = std::ceil(std::log(m_maxValue / m_minValue) / m_logGamma) + 1;
+        m_binCount = bins < NVST_LOG_HISTOGRAM_MAX_BINS ? static_cast<uint32_t>(bins) : NVST_LOG_HISTOGRAM_MAX_BINS;
+        // Wider bins if the range needs more than the fixed storage.
+        m_logGamma = std::log(m_maxValue / m_minValue) / (m_binCount - 1);
+        m_growth = nvst_quantile::decayGrowth(halfLifeSamples);
+        reset();
+    }
+
+    void reset()
+    {
+        std::fill(m_bins, m_bins + NVST_LOG_HISTOGRAM_MAX_BINS, 0.0);
+        m_total = 0.0;
+        m_weight = 1.0;
+        m_count = 0;
+        m_topBin = 0;
+    }
+
+    void add(double value)
+    {
+        ++m_count;
+        const double clamped = value < m_minValue ? m_minValue : (value > m_maxValue ? m_maxValue : value);
+        const uint32_t bin = static_cast<uint32_t>(std::log(clamped / m_minValue) / m_logGamma + 0.5);
+        const uint32_t index = bin < m_binCount ? bin : m_binCount - 1;
+        m_bins[index] += m_weight;
+        m_topBin = index > m_topBin ? index : m_topBin;
+        m_total += m_weight;
+        m_weight *= m_growth;
+        if (m_weight > nvst_quantile::kRescaleWeight)
+        {
+            const double scale = 1.0 / m_weight;
+            for (uint32_t i = 0; i < m_binCount; ++i)
+            {
+                m_bins[i] *= scale;
+            }
+            m_total *= scale;
+            m_weight = 1.0;
+        }
+    }
+
+    double estimate() const
+    {
+        if (!m_count)
+        {
+            return 0.0;
+        }
+        uint32_t bin = 0;
+        if (m_quantile > 0.5)
+        {
+            // Upper quantiles are reached sooner from the top.
+            const double target = (1.0 - m_quantile) * m_total;
+            double cumulative = 0.0;
+            for (bin = m_topBin; bin > 0; --bin)
+            {
+                cumulative += m_bins[bin];
+                if (cumulative > target)
+                {
+                    break;
+                }
+            }
+        }
+        else
+        {
+            const double target = m_quantile * m_total;
+            double cumulative = 0.0;
+            for (; bin + 1 < m_binCount; ++bin)
+            {
+                cumulative += m_bins[bin];
+                if (cumulative > target)
+                {
+                    break;
+                }
+            }
+        }
+        return m_minValue * std::exp(bin * m_logGamma);
+    }
+
+    uint64_t count() const { return m_count; }
+
+private:
+    double m_quantile = 0.5;
+    double m_minValue = 1.0;
+    double m_maxValue = 2.0;
+    double m_logGamma = 0.02;
+    uint32_t m_binCount = 1;
+    double m_growth = 1.0;
+    double m_weight = 1.0;
+    double m_total = 0.0;
+    uint64_t m_count = 0;
+    uint32_t m_topBin = 0;
+    double m_bins[NVST_LOG_HISTOGRAM_MAX_BINS];
+};
+
+/// One quantile of a sample stream, estimated with the configured method.
+///
+/// Only the selected estimator is allocated, once, at construction.
+/// \ingroup Video
+class NvstQuantileEstimator
+{
+public:
+    explicit NvstQuantileEstimator(const NvstQuantileEstimatorConfig& config)
+        : m_mode(config.mode)
+    {
+        const double quantile = config.quantile <= 0.0 ? 0.0 : (config.quantile >= 1.0 ? 1.0 : config.quantile);
+        switch (m_mode)
+        {
+        case NVST_QUANTILE_ESTIMATOR_WINDOWED:
+            m_windowed.reset(new NvstWindowedQuantile());
+            m_windowed->init(quantile, config.windowSize, config.windowStep);
+            break;
+        case NVST_QUANTILE_ESTIMATOR_P2:
+            m_p2.reset(new NvstP2Quantile());
+            m_p2->init(quantile, config.halfLifeSamples);
+            break;
+        case NVST_QUANTILE_ESTIMATOR_TDIGEST:
+            m_tdigest.reset(new NvstTDigest());
+            m_tdigest->init(quantile, config.compression, config.halfLifeSamples);
+            break;
+        case NVST_QUANTILE_ESTIMATOR_LOG_HISTOGRAM:
+            m_logHistogram.reset(new NvstLogHistogramQuantile());
+            m_logHistogram->init(quantile, config.minValue, config.maxValue, config.relativeError,
+                                 config.halfLifeSamples);
+            break;
+        default:
+            m_mode = NVST_QUANTILE_ESTIMATOR_MOVING;
+            m_moving.init(quantile, config.convergence);
+            break;
+        }
+    }
+
+    NvstQuantileEstimator(const NvstQuantileEstimator&) = delete;
+    NvstQuantileEstimator& operator=(const NvstQuantileEstimator&) = delete;
+
+    void add(double value)
+    {
+        switch (m_mode)
+        {
+        case NVST_QUANTILE_ESTIMATOR_WINDOWED:
+            m_windowed->add(value);
+            break;
+        case NVST_QUANTILE_ESTIMATOR_P2:
+            m_p2->add(value);
+            break;
+        case NVST_QUANTILE_ESTIMATOR_TDIGEST:
+            m_tdigest->add(value);
+            break;
+        case NVST_QUANTILE_ESTIMATOR_LOG_HISTOGRAM:
+            m_logHistogram->add(value);
+            break;
+        default:
+            m_moving.add(value);
+            break;
+        }
+    }
+
+    /// \return Current estimate; 0 before the first sample.
+    double estimate()
+    {
+        switch (m_mode)
+        {
+        case NVST_QUANTILE_ESTIMATOR_WINDOWED:
+            return m_windowed->estimate();
+        case NVST_QUANTILE_ESTIMATOR_P2:
+            return m_p2->estimate();
+        case NVST_QUANTILE_ESTIMATOR_TDIGEST:
+            return m_tdigest->estimate();
+        case NVST_QUANTILE_ESTIMATOR_LOG_HISTOGRAM:
+            return m_logHistogram->estimate();
+        default:
+            return m_moving.estimate();
+        }
+    }
+
+    void reset()
+    {
+        switch (m_mode)
+        {
+        case NVST_QUANTILE_ESTIMATOR_WINDOWED:
+            m_windowed->reset();
+            break;
+        case NVST_QUANTILE_ESTIMATOR_P2:
+            m_p2->reset();
+            break;
+        case NVST_QUANTILE_ESTIMATOR_TDIGEST:
+            m_tdigest->reset();
+            break;
+        case NVST_QUANTILE_ESTIMATOR_LOG_HISTOGRAM:
+            m_logHistogram->reset();
+            break;
+        default:
+            m_moving.reset();
+            break;
+        }
+    }
+
+    NvstQuantileEstimatorMode mode() const { return m_mode; }
+
+private:
+    NvstQuantileEstimatorMode m_mode;
+    NvstMovingQuantile m_moving;
+    std::unique_ptr<NvstWindowedQuantile> m_windowed;
+    std::unique_ptr<NvstP2Quantile> m_p2;
+    std::unique_ptr<NvstTDigest> m_tdigest;
+    std::unique_ptr<NvstLogHistogramQuantile> m_logHistogram;
+};
@@ -0,0 +1,149 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file SurfaceLayout.h
+/// Memory layout of NVST_SO_SYSMEM graphics surfaces.
+
+#pragma once
+
+#include "StreamData.h"
+#include "VideoFormat.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(__cplusplus)
+extern "C"
+{
+#endif
+
+    /// Planes of a system memory surface.
+    /// \ingroup VideoData
+    typedef struct NvstSurfacePlanes_t
+    {
+        /// Number of valid entries in data and pitch (1 for packed RGB, 2 for NV12, 3 for YCbCr420p).
+        uint32_t planeCount;
+        /// First byte of each plane.
+        uint8_t* data[3];
+        /// Row pitch of each plane in bytes.
+        uint32_t pitch[3];
+        /// Width of the useful data in pixels (NvstGraphicsSurface::dataWidth, or width if unset).
+        uint32_t width;
+        /// Height of the useful data in pixels (NvstGraphicsSurface::dataHeight, or height if unset).
+        uint32_t height;
+    } NvstSurfacePlanes;
+
+    /// Byte offsets of the channels of a 32bpp packed RGB pixel.
+    ///
+    /// Formats are word ordered, as in NVENC: NVST_SF_ARGB is a 32-bit word with
+    /// B in the lowest byte, so its memory order is B, G, R, A.
+    /// \ingroup VideoData
+    typedef struct NvstPackedRgbOffsets_t
+    {
+        uint8_t r;
+        uint8_t g;
+        uint8_t b;
+        uint8_t a;
+    } NvstPackedRgbOffsets;
+
+    /// Get the channel byte offsets of a 32bpp packed RGB format.
+    /// \return false if format isn't NVST_SF_ARGB, NVST_SF_BGRA or NVST_SF_ABGR.
+    static inline bool nvstGetPackedRgbOffsets(NvstSurfaceFormat format, NvstPackedRgbOffsets* offsets)
+    {
+        switch (format)
+        {
+        case NVST_SF_ARGB:
+            offsets->b = 0;
+            offsets->g = 1;
+            offsets->r = 2;
+            offsets->a = 3;
+            return true;
+        case NVST_SF_BGRA:
+            offsets->a = 0;
+            offsets->r = 1;
+            offsets->g = 2;
+            offsets->b = 3;
+            return true;
+        case NVST_SF_ABGR:
+            offsets->r = 0;
+            offsets->g = 1;
+            offsets->b = 2;
+            offsets->a = 3;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /// Locate the planes of a system memory surface.
+    ///
+    /// Packed RGB and NV12 use NvstGraphicsSurface::pitch for every plane;
+    /// NV12 chroma starts pitch * height bytes into the buffer.
+    /// YCbCr420p ignores pitch and stores tightly packed Y, Cb and Cr planes.
+    /// Plane offsets are derived from the allocated width/height, while the
+    /// returned width/height describe the useful data (dataWidth/dataHeight).
+    /// \param[in] surface Surface whose surface field points to system memory.
+    /// \param[in] format Format of the surface.
+    /// \param[out] planes Receives the plane pointers and pitches.
+    /// \return false if the format isn't supported on the sysmem path or the surface is empty.
+    static inline bool nvstGetSurfacePlanes(
+        const NvstGraphicsSurface* surface,
+        NvstSurfaceFormat format,
+        NvstSurfacePlanes* planes)
+    {
+        uint8_t* base = (uint8_t*)surface->surface;
+        const uint32_t allocWidth = surface->width;
+        const uint32_t allocHeight = surface->height;
+        if (!base || allocWidth == 0 || allocHeight == 0)
+        {
+            return false;
+        }
+        planes->width = surface->dataWidth ? surface->dataWidth : allocWidth;
+        planes->height = surface->dataHeight ? surface->dataHeight : allocHeight;
+        if (planes->width > allocWidth || planes->height > allocHeight)
+        {
+            return false;
+        }
+
+        switch (format)
+        {
+        case NVST_SF_ARGB:
+        case NVST_SF_BGRA:
+        case NVST_SF_ABGR:
+            planes->planeCount = 1;
+            planes->data[0] = base;
+            planes->pitch[0] = surface->pitch ? surface->pitch : allocWidth * 4;
+            return true;
+        case NVST_SF_NV12:
+            planes->planeCount = 2;
+            planes->data[0] = base;
+            planes->pitch[0] = surface->pitch ? surface->pitch : allocWidth;
+            planes->data[1] = base + (size_t)planes->pitch[0] * allocHeight;
+            planes->pitch[1] = planes->pitch[0];
+            return true;
+        case NVST_SF_YCbCr420p:
+            planes->planeCount = 3;
+            planes->data[0] = base;
+            planes->pitch[0] = allocWidth;
+            planes->data[1] = base + (size_t)allocWidth * allocHeight;
+            planes->pitch[1] = allocWidth / 2;
+            planes->data[2] = planes->data[1] + (size_t)(allocWidth / 2) * (allocHeight / 2);
+            planes->pitch[2] = allocWidth / 2;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+#if defined(__cplusplus)
+}
+#endif
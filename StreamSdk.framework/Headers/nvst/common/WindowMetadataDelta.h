@@ -0,0 +1,652 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file WindowMetadataDelta.h
+/// Frame-to-frame delta coding of NvstVideoFrameWindowMetadata.
+///
+/// A full NvstVideoFrameWindowMetadata entry is about 230 bytes, and in
+/// windowed streaming most of them are identical from one frame to the next.
+/// NvstWindowMetadataDeltaEncoder turns the window list of each frame into a
+/// compact delta against the previous one, keyed by windowHandle, that
+/// carries only the windows and fields that changed. NvstWindowMetadataCache
+/// applies the deltas on the receiving side and keeps the full list, ready to
+/// be exposed through NvstVideoDecodeUnit::windowMetadata.
+///
+/// Wire format, little endian:
+/// - header: uint8 flags (NVST_WMD_FLAG_*), uint32 sequence, uint16 operation count
+/// - operations, each starting with a uint8 NVST_WMD_OP_* code:
+///   - UPSERT: uint32 windowHandle, uint8 field mask (NVST_WMD_FIELD_*), then the masked fields in bit order
+///   - REMOVE: uint32 windowHandle
+///   - ORDER: uint16 count, count x uint32 windowHandle
+
+#pragma once
+
+#include <nvst/common/Result.h>
+#include <nvst/common/VideoDecodeUnit.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <vector>
+
+/// Delta header flags.
+enum
+{
+    /// The delta is self-contained; the receiver discards its cached windows first.
+    NVST_WMD_FLAG_KEY = 0x1,
+};
+
+/// Delta operations.
+enum
+{
+    /// Add a window, or update fields of a known one.
+    NVST_WMD_OP_UPSERT = 0,
+    /// Remove a window.
+    NVST_WMD_OP_REMOVE = 1,
+    /// Set the order of all windows; only sent if adds and removes alone don't produce it.
+    NVST_WMD_OP_ORDER = 2,
+};
+
+/// Field groups of an UPSERT operation.
+enum
+{
+    /// windowRect.
+    NVST_WMD_FIELD_RECT = 0x01,
+    /// zOrder.
+    NVST_WMD_FIELD_Z_ORDER = 0x02,
+    /// regionRectsCount and regionRects.
+    NVST_WMD_FIELD_REGION = 0x04,
+    /// layeringFlags, colorKey and alphaValue.
+    NVST_WMD_FIELD_ALPHA = 0x08,
+    /// wsStyles and wsExStyles.
+    NVST_WMD_FIELD_STYLES = 0x10,
+    /// windowCaptionLength and windowCaption.
+    NVST_WMD_FIELD_CAPTION = 0x20,
+    /// ownerHandle.
+    NVST_WMD_FIELD_OWNER = 0x40,
+    /// dwmCloaked.
+    NVST_WMD_FIELD_CLOAKED = 0x80,
+    NVST_WMD_FIELD_ALL = 0xFF,
+};
+
+namespace nvst_wmd
+{
+/// Bounds-checked little endian writer; a failed write leaves ok() false.
+class Writer
+{
+public:
+    Writer(uint8_t* data, size_t capacity)
+        : m_data(data)
+        , m_capacity(capacity)
+    {
+    }
+
+    void bytes(const void* source, size_t size)
+    {
+        if (m_size + size > m_capacity)
+        {
+            m_ok = false;
+            return;
+        }
+        if (size)
+        {
+            std::memcpy(m_data + m_size, source, size);
+        }
+        m_size += size;
+    }
+
+    void u8(uint8_t value) { bytes(&value, 1); }
+
+    void u16(uint16_t value)
+    {
+        const uint8_t le[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+        bytes(le, sizeof(le));
+    }
+
+    void u32(uint32_t value)
+    {
+        const uint8_t le[4] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+                               static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24)};
+        bytes(le, sizeof(le));
+    }
+
+    void rect(const NvstRect& r)
+    {
+        u16(static_cast<uint16_t>(r.x1));
+        u16(static_cast<uint16_t>(r.y1));
+        u16(static_cast<uint16_t>(r.x2));
+        u16(static_cast<uint16_t>(r.y2));
+    }
+
+    /// Overwrite a previously written uint16 at \p offset.
+    void patchU16(size_t offset, uint16_t value)
+    {
+        if (offset + 2 <= m_size)
+        {
+            m_data[offset] = static_cast<uint8_t>(value);
+            m_data[offset + 1] = static_cast<uint8_t>(value >> 8);
+        }
+    }
+
+    size_t size() const { return m_size; }
+    bool ok() const { return m_ok; }
+
+private:
+    uint8_t* m_data;
+    size_t m_capacity;
+    size_t m_size = 0;
+    bool m_ok = true;
+};
+
+/// Bounds-checked little endian reader; reads past the end yield zeros and leave ok() false.
+class Reader
+{
+public:
+    Reader(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    void bytes(void* target, size_t size)
+    {
+        if (m_pos + size > m_size)
+        {
+            m_ok = false;
+            std::memset(target, 0, size);
+            return;
+        }
+        std::memcpy(target, m_data + m_pos, size);
+        m_pos += size;
+    }
+
+    uint8_t u8()
+    {
+        uint8_t value;
+        bytes(&value, 1);
+        return value;
+    }
+
+    uint16_t u16()
+    {
+        uint8_t le[2];
+        bytes(le, sizeof(le));
+        return static_cast<uint16_t>(le[0] | (le[1] << 8));
+    }
+
+    uint32_t u32()
+    {
+        uint8_t le[4];
+        bytes(le, sizeof(le));
+        return static_cast<uint32_t>(le[0]) | (static_cast<uint32_t>(le[1]) << 8) |
+            (static_cast<uint32_t>(le[2]) << 16) | (static_cast<uint32_t>(le[3]) << 24);
+    }
+
+    NvstRect rect()
+    {
+        NvstRect r;
+        r.x1 = static_cast<int16_t>(u16());
+        r.y1 = static_cast<int16_t>(u16());
+        r.x2 = static_cast<int16_t>(u16());
+        r.y2 = static_cast<int16_t>(u16());
+        return r;
+    }
+
+    bool ok() const { return m_ok; }
+    bool atEnd() const { return m_pos == m_size; }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    bool m_ok = true;
+};
+
+static inline uint16_t regionCount(const NvstVideoFrameWindowMetadata& window)
+{
+    const uint16_t count = window.regionRectsCount;
+    return count < NVST_MD_MAX_REGION_RECTANGLE_COUNT ? count : static_cast<uint16_t>(NVST_MD_MAX_REGION_RECTANGLE_COUNT);
+}
+
+static inline uint16_t captionLength(const NvstVideoFrameWindowMetadata& window)
+{
+    const uint16_t length = window.windowCaptionLength;
+    return length < NVST_MD_MAX_WINDOW_CAPTION_SIZE - 1 ? length
+                                                        : static_cast<uint16_t>(NVST_MD_MAX_WINDOW_CAPTION_SIZE - 1);
+}
+
+static inline bool sameRect(const NvstRect& a, const NvstRect& b)
+{
+    return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
+}
+
+/// \return Mask of the field groups that differ between two versions of a window.
+static inline uint8_t diff(const NvstVideoFrameWindowMetadata& a, const NvstVideoFrameWindowMetadata& b)
+{
+    uint8_t mask = 0;
+    if (!sameRect(a.windowRect, b.windowRect))
+    {
+        mask |= NVST_WMD_FIELD_RECT;
+    }
+    if (a.zOrder != b.zOrder)
+    {
+        mask |= NVST_WMD_FIELD_Z_ORDER;
+    }
+    const uint16_t regions = regionCount(a);
+    if (regions != regionCount(b))
+    {
+        mask |= NVST_WMD_FIELD_REGION;
+    }
+    else
+    {
+        for (uint16_t i = 0; i < regions; ++i)
+        {
+            if (!sameRect(a.regionRects[i], b.regionRects[i]))
+            {
+                mask |= NVST_WMD_FIELD_REGION;
+                break;
+            }
+        }
+    }
+    if (a.layeringFlags != b.layeringFlags || a.colorKey != b.colorKey || a.alphaValue != b.alphaValue)
+    {
+        mask |= NVST_WMD_FIELD_ALPHA;
+    }
+    if (a.wsStyles != b.wsStyles || a.wsExStyles != b.wsExStyles)
+    {
+        mask |= NVST_WMD_FIELD_STYLES;
+    }
+    const uint16_t length = captionLength(a);
+    if (length != captionLength(b) || std::memcmp(a.windowCaption, b.windowCaption, length) != 0)
+    {
+        mask |= NVST_WMD_FIELD_CAPTION;
+    }
+    if (a.ownerHandle != b.ownerHandle)
+    {
+        mask |= NVST_WMD_FIELD_OWNER;
+    }
+    if (a.dwmCloaked != b.dwmCloaked)
+    {
+        mask |= NVST_WMD_FIELD_CLOAKED;
+    }
+    return mask;
+}
+
+static inline void writeFields(Writer& out, const NvstVideoFrameWindowMetadata& window, uint8_t mask)
+{
+    if (mask & NVST_WMD_FIELD_RECT)
+    {
+        out.rect(window.windowRect);
+    }
+    if (mask & NVST_WMD_FIELD_Z_ORDER)
+    {
+        out.u16(window.zOrder);
+    }
+    if (mask & NVST_WMD_FIELD_REGION)
+    {
+        const uint16_t regions = regionCount(window);
+        out.u8(static_cast<uint8_t>(regions));
+        for (uint16_t i = 0; i < regions; ++i)
+        {
+            out.rect(window.regionRects[i]);
+        }
+    }
+    if (mask & NVST_WMD_FIELD_ALPHA)
+    {
+        out.u8(static_cast<uint8_t>(window.layeringFlags));
+        out.u32(window.colorKey);
+        out.u8(window.alphaValue);
+    }
+    if (mask & NVST_WMD_FIELD_STYLES)
+    {
+        out.u32(window.wsStyles);
+        out.u32(window.wsExStyles);
+    }
+    if (mask & NVST_WMD_FIELD_CAPTION)
+    {
+        const uint16_t length = captionLength(window);
+        out.u8(static_cast<uint8_t>(length));
+        out.bytes(window.windowCaption, length);
+    }
+    if (mask & NVST_WMD_FIELD_OWNER)
+    {
+        out.u32(window.ownerHandle);
+    }
+    if (mask & NVST_WMD_FIELD_CLOAKED)
+    {
+        out.u32(window.dwmCloaked);
+    }
+}
+
+static inline void readFields(Reader& in, NvstVideoFrameWindowMetadata& window, uint8_t mask)
+{
+    if (mask & NVST_WMD_FIELD_RECT)
+    {
+        window.windowRect = in.rect();
+    }
+    if (mask & NVST_WMD_FIELD_Z_ORDER)
+    {
+        window.zOrder = in.u16();
+    }
+    if (mask & NVST_WMD_FIELD_REGION)
+    {
+        uint8_t regions = in.u8();
+        regions = regions < NVST_MD_MAX_REGION_RECTANGLE_COUNT ? regions
+                                                               : static_cast<uint8_t>(NVST_MD_MAX_REGION_RECTANGLE_COUNT);
+        window.regionRectsCount = regions;
+        for (uint16_t i = 0; i < regions; ++i)
+        {
+            window.regionRects[i] = in.rect();
+        }
+    }
+    if (mask & NVST_WMD_FIELD_ALPHA)
+    {
+        window.layeringFlags = in.u8() & 0x3;
+        window.colorKey = in.u32() & 0xFFFFFF;
+        window.alphaValue = in.u8();
+    }
+    if (mask & NVST_WMD_FIELD_STYLES)
+    {
+        window.wsStyles = in.u32();
+        window.wsExStyles = in.u32();
+    }
+    if (mask & NVST_WMD_FIELD_CAPTION)
+    {
+        uint8_t length = in.u8();
+        length = length < NVST_MD_MAX_WINDOW_CAPTION_SIZE ? length
+                                                          : static_cast<uint8_t>(NVST_MD_MAX_WINDOW_CAPTION_SIZE - 1);
+        in.bytes(window.windowCaption, length);
+        std::memset(window.windowCaption + length, 0, NVST_MD_MAX_WINDOW_CAPTION_SIZE - length);
+        window.windowCaptionLength = length;
+    }
+    if (mask & NVST_WMD_FIELD_OWNER)
+    {
+        window.ownerHandle = in.u32();
+    }
+    if (mask & NVST_WMD_FIELD_CLOAKED)
+    {
+        window.dwmCloaked = in.u32();
+    }
+}
+} // namespace nvst_wmd
+
+/// Sending side: turns the window list of each frame into a delta against the previous frame.
+/// \ingroup VideoData
+class NvstWindowMetadataDeltaEncoder
+{
+public:
+    /// \param[in] keyInterval Send a self-contained delta every this many frames, so a receiver
+    /// that missed one recovers without a request. 0 sends key deltas only when requested.
+    explicit NvstWindowMetadataDeltaEncoder(uint32_t keyInterval = 0)
+        : m_keyInterval(keyInterval)
+    {
+    }
+
+    /// Make the next delta self-contained, e.g. when the receiver reported a sequence gap.
+    void requestKey() { m_keyRequested = true; }
+
+    /// Upper bound of the encoded size of the next frame if it has \p count windows.
+    /// Depends on the windows of the previous frame, which may all have to be removed.
+    size_t maxEncodedSize(uint16_t count) const
+    {
+        // Header, a REMOVE per previous window, one full UPSERT per window, and an ORDER operation.
+        const size_t upsert = 1 + 4 + 1 + 8 + 2 + 1 + 8 * NVST_MD_MAX_REGION_RECTANGLE_COUNT + 6 + 8 + 1 +
+            NVST_MD_MAX_WINDOW_CAPTION_SIZE + 8;
+        return 7 + m_order.size() * 5 + count * upsert + 3 + count * 4u;
+    }
+
+    /// Encode the windows of the next frame.
+    /// \param[in] windows Window list as it would be set in NvstVideoDecodeUnit::windowMetadata.
+    /// \param[in] count Number of windows.
+    /// \param[out] out Buffer receiving the delta; maxEncodedSize(count) bytes always suffice.
+    /// \param[in] capacity Size of out.
+    /// \return Size of the delta, or 0 if it didn't fit; the encoder state is unchanged in that case.
+    size_t encode(const NvstVideoFrameWindowMetadata* windows, uint16_t count, uint8_t* out, size_t capacity)
+    {
+        const bool key = m_keyRequested || m_previous.empty() || (m_keyInterval && m_sinceKey + 1 >= m_keyInterval);
+        nvst_wmd::Writer writer(out, capacity);
+        writer.u8(key ? NVST_WMD_FLAG_KEY : 0);
+        writer.u32(m_sequence + 1);
+        const size_t countOffset = writer.size();
+        writer.u16(0);
+        uint16_t operations = 0;
+
+        // Windows that are gone.
+        std::vector<uint32_t> order;
+        if (!key)
+        {
+            for (uint32_t handle : m_order)
+            {
+                if (!contains(windows, count, handle))
+                {
+                    writer.u8(NVST_WMD_OP_REMOVE);
+                    writer.u32(handle);
+                    ++operations;
+                }
+                else
+                {
+                    order.push_back(handle);
+                }
+            }
+        }
+
+        // New and changed windows.
+        std::vector<uint32_t> current;
+        current.reserve(count);
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            const NvstVideoFrameWindowMetadata& window = windows[i];
+            // The struct is packed; copy the handle out instead of binding references to it.
+            const uint32_t handle = window.windowHandle;
+            current.push_back(handle);
+            std::map<uint32_t, NvstVideoFrameWindowMetadata>::const_iterator previous = m_previous.find(handle);
+            const bool known = !key && previous != m_previous.end();
+            const uint8_t mask = known ? nvst_wmd::diff(window, previous->second) : static_cast<uint8_t>(NVST_WMD_FIELD_ALL);
+            if (!known)
+            {
+                order.push_back(handle);
+            }
+            if (mask)
+            {
+                writer.u8(NVST_WMD_OP_UPSERT);
+                writer.u32(handle);
+                writer.u8(mask);
+                nvst_wmd::writeFields(writer, window, mask);
+                ++operations;
+            }
+        }
+
+        if (order != current)
+        {
+            writer.u8(NVST_WMD_OP_ORDER);
+            writer.u16(count);
+            for (uint32_t handle : current)
+            {
+                writer.u32(handle);
+            }
+            ++operations;
+        }
+        writer.patchU16(countOffset, operations);
+        if (!writer.ok())
+        {
+            return 0;
+        }
+
+        m_previous.clear();
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            const uint32_t handle = windows[i].windowHandle;
+            m_previous[handle] = windows[i];
+        }
+        m_order.swap(current);
+        ++m_sequence;
+        m_sinceKey = key ? 0 : m_sinceKey + 1;
+        m_keyRequested = false;
+        return writer.size();
+    }
+
+private:
+    static bool contains(const NvstVideoFrameWindowMetadata* windows, uint16_t count, uint32_t handle)
+    {
+        for (uint16_t i = 0; i < count; ++i)
+        {
+            if (windows[i].windowHandle == handle)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    uint32_t m_keyInterval;
+    uint32_t m_sinceKey = 0;
+    uint32_t m_sequence = 0;
+    bool m_keyRequested = false;
+    std::map<uint32_t, NvstVideoFrameWindowMetadata> m_previous;
+    std::vector<uint32_t> m_order;
+};
+
+/// Receiving side: applies deltas and keeps the full window list of the latest frame.
+/// \ingroup VideoData
+class NvstWindowMetadataCache
+{
+public:
+    /// Apply the delta of the next frame.
+    /// \retval NVST_R_INVALID_VALUE if the delta is malformed; the cache is unchanged
+    /// \retval NVST_R_INVALID_STATE if a delta was missed (sequence gap); ask the sender for a key delta.
+    /// The cache is unchanged and keeps rejecting deltas until a key delta arrives.
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult apply(const uint8_t* data, size_t size)
+    {
+        nvst_wmd::Reader reader(data, size);
+        const uint8_t flags = reader.u8();
+        const uint32_t sequence = reader.u32();
+        const uint16_t operations = reader.u16();
+        if (!reader.ok())
+        {
+            return NVST_R_INVALID_VALUE;
+        }
+        const bool key = (flags & NVST_WMD_FLAG_KEY) != 0;
+        if (!key && (!m_valid || sequence != m_sequence + 1))
+        {
+            m_valid = false;
+            return NVST_R_INVALID_STATE;
+        }
+
+        // Work on copies so a malformed delta leaves the cache intact.
+        std::vector<NvstVideoFrameWindowMetadata> windows;
+        if (!key)
+        {
+            windows = m_windows;
+        }
+        for (uint16_t op = 0; op < operations && reader.ok(); ++op)
+        {
+            switch (reader.u8())
+            {
+            case NVST_WMD_OP_UPSERT:
+            {
+                const uint32_t handle = reader.u32();
+                const uint8_t mask = reader.u8();
+                NvstVideoFrameWindowMetadata* window = find(windows, handle);
+                if (!window)
+                {
+                    NvstVideoFrameWindowMetadata added;
+                    std::memset(&added, 0, sizeof(added));
+                    added.windowHandle = handle;
+                    windows.push_back(added);
+                    window = &windows.back();
+                }
+                nvst_wmd::readFields(reader, *window, mask);
+                break;
+            }
+            case NVST_WMD_OP_REMOVE:
+            {
+                const uint32_t handle = reader.u32();
+                for (size_t i = 0; i < windows.size(); ++i)
+                {
+                    if (windows[i].windowHandle == handle)
+                    {
+                        windows.erase(windows.begin() + static_cast<std::ptrdiff_t>(i));
+                        break;
+                    }
+                }
+                break;
+            }
+            case NVST_WMD_OP_ORDER:
+            {
+                const uint16_t count = reader.u16();
+                std::vector<NvstVideoFrameWindowMetadata> ordered;
+                ordered.reserve(count);
+                for (uint16_t i = 0; i < count; ++i)
+                {
+                    const NvstVideoFrameWindowMetadata* window = find(windows, reader.u32());
+                    if (!window)
+                    {
+                        return NVST_R_INVALID_VALUE;
+                    }
+                    ordered.push_back(*window);
+                }
+                if (ordered.size() != windows.size())
+                {
+                    return NVST_R_INVALID_VALUE;
+                }
+                windows.swap(ordered);
+                break;
+            }
+            default:
+                return NVST_R_INVALID_VALUE;
+            }
+        }
+        if (!reader.ok() || !reader.atEnd() || windows.size() > UINT16_MAX)
+        {
+            return NVST_R_INVALID_VALUE;
+        }
+        m_windows.swap(windows);
+        m_sequence = sequence;
+        m_valid = true;
+        return NVST_R_SUCCESS;
+    }
+
+    /// \return Full window list of the last applied frame; valid until the next apply().
+    const NvstVideoFrameWindowMetadata* windows() const { return m_windows.empty() ? nullptr : m_windows.data(); }
+
+    /// \return Number of windows of the last applied frame.
+    uint16_t count() const { return static_cast<uint16_t>(m_windows.size()); }
+
+    /// \return false after a sequence gap, until a key delta is applied.
+    bool isValid() const { return m_valid; }
+
+    /// Point a decode unit's window metadata at the cached list.
+    void fill(NvstVideoDecodeUnit* vdu)
+    {
+        vdu->windowMetadataCount = count();
+        vdu->windowMetadata = m_windows.empty() ? nullptr : m_windows.data();
+    }
+
+private:
+    static NvstVideoFrameWindowMetadata* find(std::vector<NvstVideoFrameWindowMetadata>& windows, uint32_t handle)
+    {
+        for (NvstVideoFrameWindowMetadata& window : windows)
+        {
+            if (window.windowHandle == handle)
+            {
+                return &window;
+            }
+        }
+        return nullptr;
+    }
+
+    std::vector<NvstVideoFrameWindowMetadata> m_windows;
+    uint32_t m_sequence = 0;
+    bool m_valid = false;
+};
@@ -0,0 +1,520 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file ColorConvert.h
+/// CPU conversion of packed RGB system memory surfaces to NV12.
+///
+/// Used when surfaceOrigin is NVST_SO_SYSMEM and the application renders
+/// NVST_SF_ARGB, NVST_SF_BGRA or NVST_SF_ABGR, but NV12 should be handed to
+/// the encoder. Every NvstCscMode is supported. Conversion is done in Q14
+/// fixed point; the AVX2, SSE4.1 and scalar kernels produce identical output,
+/// and the fastest kernel supported by the CPU is chosen at runtime.
+///
+/// Chroma is the average of each 2x2 block (centered siting). The sRGB modes
+/// use the BT.709 matrix, since sRGB only differs from BT.709 in its transfer
+/// function, which is not applied when the input is already gamma encoded.
+
+#pragma once
+
+#include <nvst/common/StreamConfig.h>
+#include <nvst/common/SurfaceLayout.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NVST_CSC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define NVST_CSC_TARGET(isa)
+#else
+#define NVST_CSC_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+/// Conversion kernel selection.
+/// \ingroup VideoData
+typedef enum NvstCscKernel_t
+{
+    /// Fastest kernel supported by the CPU.
+    NVST_CSC_KERNEL_AUTO = 0,
+    /// Portable C++ implementation.
+    NVST_CSC_KERNEL_SCALAR = 1,
+    /// SSE4.1 kernel, 8 pixels per step.
+    NVST_CSC_KERNEL_SSE4 = 2,
+    /// AVX2 kernel, 16 pixels per step.
+    NVST_CSC_KERNEL_AVX2 = 3,
+} NvstCscKernel;
+
+/// Fixed point RGB to YCbCr coefficients, laid out per byte of a source pixel.
+/// \ingroup VideoData
+typedef struct NvstCscCoefficients_t
+{
+    /// Q14 weights of the four source bytes for Y (the alpha byte has weight 0).
+    int16_t y[4];
+    /// Q14 weights of the four source bytes for Cb.
+    int16_t cb[4];
+    /// Q14 weights of the four source bytes for Cr.
+    int16_t cr[4];
+    /// Added to the Q14 luma sum before shifting: black level plus rounding.
+    int32_t yOffset;
+    /// Added to the Q16 sum of a 2x2 chroma block before shifting: 128 plus rounding.
+    int32_t cOffset;
+} NvstCscCoefficients;
+
+/// Compute conversion coefficients.
+/// \param[in] mode Colour space of the YCbCr output.
+/// \param[in] sourceFormat Packed RGB format of the input.
+/// \param[out] coefficients Receives the coefficients.
+/// \return false if mode or sourceFormat isn't supported.
+static inline bool nvstGetCscCoefficients(
+    NvstCscMode mode,
+    NvstSurfaceFormat sourceFormat,
+    NvstCscCoefficients* coefficients)
+{
+    NvstPackedRgbOffsets offsets;
+    if (!nvstGetPackedRgbOffsets(sourceFormat, &offsets))
+    {
+        return false;
+    }
+    double kr, kb;
+    switch (mode)
+    {
+    case NVST_CSCM_LIMITED_YCBCR_BT601:
+    case NVST_CSCM_FULL_YCBCR_BT601:
+        kr = 0.299;
+        kb = 0.114;
+        break;
+    case NVST_CSCM_LIMITED_YCBCR_BT709:
+    case NVST_CSCM_FULL_YCBCR_BT709:
+    case NVST_CSCM_LIMITED_SRGB:
+    case NVST_CSCM_FULL_SRGB:
+        kr = 0.2126;
+        kb = 0.0722;
+        break;
+    case NVST_CSCM_LIMITED_YCBCR_BT2020:
+    case NVST_CSCM_FULL_YCBCR_BT2020:
+        kr = 0.2627;
+        kb = 0.0593;
+        break;
+    default:
+        return false;
+    }
+    const bool full = mode == NVST_CSCM_FULL_YCBCR_BT601 || mode == NVST_CSCM_FULL_YCBCR_BT709 ||
+        mode == NVST_CSCM_FULL_YCBCR_BT2020 || mode == NVST_CSCM_FULL_SRGB;
+    const double one = 1 << 14;
+    const double yScale = full ? 1.0 : 219.0 / 255.0;
+    const double cScale = full ? 1.0 : 224.0 / 255.0;
+
+    // Round the individual weights, then fix up green so that white maps exactly
+    // to the top of the range and grey carries no chroma.
+    const int yr = static_cast<int>(std::lround(yScale * kr * one));
+    const int yb = static_cast<int>(std::lround(yScale * kb * one));
+    const int yg = static_cast<int>(std::lround(yScale * one)) - yr - yb;
+    const int cbb = static_cast<int>(std::lround(cScale * 0.5 * one));
+    const int cbr = static_cast<int>(std::lround(-cScale * 0.5 * kr / (1.0 - kb) * one));
+    const int cbg = -cbb - cbr;
+    const int crr = cbb;
+    const int crb = static_cast<int>(std::lround(-cScale * 0.5 * kb / (1.0 - kr) * one));
+    const int crg = -crr - crb;
+
+    std::memset(coefficients, 0, sizeof(*coefficients));
+    coefficients->y[offsets.r] = static_cast<int16_t>(yr);
+    coefficients->y[offsets.g] = static_cast<int16_t>(yg);
+    coefficients->y[offsets.b] = static_cast<int16_t>(yb);
+    coefficients->cb[offsets.r] = static_cast<int16_t>(cbr);
+    coefficients->cb[offsets.g] = static_cast<int16_t>(cbg);
+    coefficients->cb[offsets.b] = static_cast<int16_t>(cbb);
+    coefficients->cr[offsets.r] = static_cast<int16_t>(crr);
+    coefficients->cr[offsets.g] = static_cast<int16_t>(crg);
+    coefficients->cr[offsets.b] = static_cast<int16_t>(crb);
+    coefficients->yOffset = ((full ? 0 : 16) << 14) + (1 << 13);
+    coefficients->cOffset = (128 << 16) + (1 << 15);
+    return true;
+}
+
+/// \return true if the kernel can run on this CPU.
+static inline bool nvstCscKernelSupported(NvstCscKernel kernel)
+{
+    switch (kernel)
+    {
+    case NVST_CSC_KERNEL_AUTO:
+    case NVST_CSC_KERNEL_SCALAR:
+        return true;
+#if defined(NVST_CSC_X86)
+#if defined(_MSC_VER) && !defined(__clang__)
+    case NVST_CSC_KERNEL_SSE4:
+    case NVST_CSC_KERNEL_AVX2:
+    {
+        int info[4];
+        __cpuid(info, 1);
+        const bool sse41 = (info[2] & (1 << 19)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (kernel == NVST_CSC_KERNEL_SSE4 || !sse41 || !osxsave || (_xgetbv(0) & 6) != 6)
+        {
+            return sse41;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+    }
+#else
+    case NVST_CSC_KERNEL_SSE4:
+        return __builtin_cpu_supports("sse4.1");
+    case NVST_CSC_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#endif
+    default:
+        return false;
+    }
+}
+
+/// \return The fastest kernel supported by this CPU.
+static inline NvstCscKernel nvstCscGetBestKernel()
+{
+    static const NvstCscKernel best = nvstCscKernelSupported(NVST_CSC_KERNEL_AVX2)
+        ? NVST_CSC_KERNEL_AVX2
+        : (nvstCscKernelSupported(NVST_CSC_KERNEL_SSE4) ? NVST_CSC_KERNEL_SSE4 : NVST_CSC_KERNEL_SCALAR);
+    return best;
+}
+
+/// \cond INTERNAL
+namespace nvst_csc
+{
+    static inline uint8_t clampToByte(int32_t value)
+    {
+        return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    /// Convert pixels [x, width) of a row pair. row1 may equal row0 for the last row of an odd height.
+    /// An odd trailing pixel is paired with itself for chroma.
+    static inline void convertRowsScalar(
+        const NvstCscCoefficients& c,
+        const uint8_t* row0,
+        const uint8_t* row1,
+        uint8_t* y0,
+        uint8_t* y1,
+        uint8_t* uv,
+        uint32_t x,
+        uint32_t width)
+    {
+        for (; x < width; x += 2)
+        {
+            const uint32_t x1 = x + 1 < width ? x + 1 : x;
+            const uint8_t* p[4] = {row0 + 4 * x, row0 + 4 * x1, row1 + 4 * x, row1 + 4 * x1};
+            int32_t sum[4] = {0, 0, 0, 0};
+            for (int i = 0; i < 4; ++i)
+            {
+                const int32_t luma =
+                    c.y[0] * p[i][0] + c.y[1] * p[i][1] + c.y[2] * p[i][2] + c.y[3] * p[i][3] + c.yOffset;
+                uint8_t* out = i < 2 ? y0 : y1;
+                const uint32_t ox = (i & 1) ? x1 : x;
+                if (out)
+                {
+                    out[ox] = clampToByte(luma >> 14);
+                }
+                for (int k = 0; k < 4; ++k)
+                {
+                    sum[k] += p[i][k];
+                }
+            }
+            const int32_t cb = c.cb[0] * sum[0] + c.cb[1] * sum[1] + c.cb[2] * sum[2] + c.cb[3] * sum[3] + c.cOffset;
+            const int32_t cr = c.cr[0] * sum[0] + c.cr[1] * sum[1] + c.cr[2] * sum[2] + c.cr[3] * sum[3] + c.cOffset;
+            uv[x] = clampToByte(cb >> 16);
+            uv[x + 1] = clampToByte(cr >> 16);
+        }
+    }
+
+#if defined(NVST_CSC_X86)
+    static inline long long packCoefficients(const int16_t (&weights)[4])
+    {
+        long long packed;
+        std::memcpy(&packed, weights, sizeof(packed));
+        return packed;
+    }
+
+    /// Luma of 4 pixels as 4 int32 (madd pairs channels, hadd completes each pixel).
+    NVST_CSC_TARGET("sse4.1")
+    static inline __m128i lumaSse(__m128i pixels, __m128i coef, __m128i offset)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coef);
+        const __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coef);
+        return _mm_srai_epi32(_mm_add_epi32(_mm_hadd_epi32(lo, hi), offset), 14);
+    }
+
+    /// Channel sums of two horizontal 2x2 blocks (8 int16: block 0 then block 1).
+    NVST_CSC_TARGET("sse4.1")
+    static inline __m128i blockSumsSse(__m128i top, __m128i bottom)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+        const __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+        return _mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_unpackhi_epi64(lo, hi));
+    }
+
+    NVST_CSC_TARGET("sse4.1")
+    static inline void convertRowsSse(
+        const NvstCscCoefficients& c,
+        const uint8_t* row0,
+        const uint8_t* row1,
+        uint8_t* y0,
+        uint8_t* y1,
+        uint8_t* uv,
+        uint32_t width)
+    {
+        const __m128i yCoef = _mm_set1_epi64x(packCoefficients(c.y));
+        const __m128i cbCoef = _mm_set1_epi64x(packCoefficients(c.cb));
+        const __m128i crCoef = _mm_set1_epi64x(packCoefficients(c.cr));
+        const __m128i yOffset = _mm_set1_epi32(c.yOffset);
+        const __m128i cOffset = _mm_set1_epi32(c.cOffset);
+
+        uint32_t x = 0;
+        for (; x + 8 <= width; x += 8)
+        {
+            const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 4 * x));
+            const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 4 * x + 16));
+            const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 4 * x));
+            const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 4 * x + 16));
+
+            const __m128i ya = _mm_packs_epi32(lumaSse(a0, yCoef, yOffset), lumaSse(a1, yCoef, yOffset));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(y0 + x), _mm_packus_epi16(ya, ya));
+            if (y1)
+            {
+                const __m128i yb = _mm_packs_epi32(lumaSse(b0, yCoef, yOffset), lumaSse(b1, yCoef, yOffset));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(y1 + x), _mm_packus_epi16(yb, yb));
+            }
+
+            const __m128i s0 = blockSumsSse(a0, b0);
+            const __m128i s1 = blockSumsSse(a1, b1);
+            const __m128i cb = _mm_srai_epi32(
+                _mm_add_epi32(_mm_hadd_epi32(_mm_madd_epi16(s0, cbCoef), _mm_madd_epi16(s1, cbCoef)), cOffset), 16);
+            const __m128i cr = _mm_srai_epi32(
+                _mm_add_epi32(_mm_hadd_epi32(_mm_madd_epi16(s0, crCoef), _mm_madd_epi16(s1, crCoef)), cOffset), 16);
+            const __m128i interleaved = _mm_packs_epi32(_mm_unpacklo_epi32(cb, cr), _mm_unpackhi_epi32(cb, cr));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(uv + x), _mm_packus_epi16(interleaved, interleaved));
+        }
+        convertRowsScalar(c, row0, row1, y0, y1, uv, x, width);
+    }
+
+    /// Luma of 16 pixels, in order.
+    NVST_CSC_TARGET("avx2")
+    static inline __m128i lumaAvx2(__m256i p0, __m256i p1, __m256i coef, __m256i offset)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        // Per 128-bit lane, hadd restores pixel order: [0..3 | 4..7].
+        const __m256i l0 = _mm256_hadd_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi8(p0, zero), coef),
+                                             _mm256_madd_epi16(_mm256_unpackhi_epi8(p0, zero), coef));
+        const __m256i l1 = _mm256_hadd_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi8(p1, zero), coef),
+                                             _mm256_madd_epi16(_mm256_unpackhi_epi8(p1, zero), coef));
+        const __m256i y0 = _mm256_srai_epi32(_mm256_add_epi32(l0, offset), 14);
+        const __m256i y1 = _mm256_srai_epi32(_mm256_add_epi32(l1, offset), 14);
+        // packs interleaves lanes: [0..3, 8..11 | 4..7, 12..15].
+        const __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(y0, y1), _MM_SHUFFLE(3, 1, 2, 0));
+        const __m256i bytes = _mm256_packus_epi16(words, words);
+        return _mm256_castsi256_si128(_mm256_permute4x64_epi64(bytes, _MM_SHUFFLE(3, 1, 2, 0)));
+    }
+
+    /// Channel sums of 2x2 blocks: [0, 1 | 2, 3] for 8 pixels per row.
+    NVST_CSC_TARGET("avx2")
+    static inline __m256i blockSumsAvx2(__m256i top, __m256i bottom)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(top, zero), _mm256_unpacklo_epi8(bottom, zero));
+        const __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(top, zero), _mm256_unpackhi_epi8(bottom, zero));
+        return _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+    }
+
+    NVST_CSC_TARGET("avx2")
+    static inline void convertRowsAvx2(
+        const NvstCscCoefficients& c,
+        const uint8_t* row0,
+        const uint8_t* row1,
+        uint8_t* y0,
+        uint8_t* y1,
+        uint8_t* uv,
+        uint32_t width)
+    {
+        const __m256i yCoef = _mm256_set1_epi64x(packCoefficients(c.y));
+        const __m256i cbCoef = _mm256_set1_epi64x(packCoefficients(c.cb));
+        const __m256i crCoef = _mm256_set1_epi64x(packCoefficients(c.cr));
+        const __m256i yOffset = _mm256_set1_epi32(c.yOffset);
+        const __m256i cOffset = _mm256_set1_epi32(c.cOffset);
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16)
+        {
+            const __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 4 * x));
+            const __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row0 + 4 * x + 32));
+            const __m256i b0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 4 * x));
+            const __m256i b1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row1 + 4 * x + 32));
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(y0 + x), lumaAvx2(a0, a1, yCoef, yOffset));
+            if (y1)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(y1 + x), lumaAvx2(b0, b1, yCoef, yOffset));
+            }
+
+            // Blocks [0, 1 | 2, 3] and [4, 5 | 6, 7]; hadd gives [0, 1, 4, 5 | 2, 3, 6, 7].
+            const __m256i s0 = blockSumsAvx2(a0, b0);
+            const __m256i s1 = blockSumsAvx2(a1, b1);
+            const __m256i cb = _mm256_srai_epi32(
+                _mm256_add_epi32(
+                    _mm256_hadd_epi32(_mm256_madd_epi16(s0, cbCoef), _mm256_madd_epi16(s1, cbCoef)), cOffset),
+                16);
+            const __m256i cr = _mm256_srai_epi32(
+                _mm256_add_epi32(
+                    _mm256_hadd_epi32(_mm256_madd_epi16(s0, crCoef), _mm256_madd_epi16(s1, crCoef)), cOffset),
+                16);
+            // Words [0, 1, 4, 5 | 2, 3, 6, 7] as (Cb, Cr) pairs, reordered to [0..3 | 4..7].
+            const __m256i words = _mm256_permute4x64_epi64(
+                _mm256_packs_epi32(_mm256_unpacklo_epi32(cb, cr), _mm256_unpackhi_epi32(cb, cr)),
+                _MM_SHUFFLE(3, 1, 2, 0));
+            const __m256i bytes = _mm256_permute4x64_epi64(_mm256_packus_epi16(words, words), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(uv + x), _mm256_castsi256_si128(bytes));
+        }
+        convertRowsScalar(c, row0, row1, y0, y1, uv, x, width);
+    }
+#endif
+} // namespace nvst_csc
+/// \endcond
+
+/// Convert a packed RGB system memory surface to NV12.
+///
+/// Converts the dataWidth x dataHeight region of the source (width x height
+/// if unset) into the top-left corner of the destination, and sets the
+/// destination's dataWidth/dataHeight to match. Frame timing, metadata and
+/// motion hints are copied; surface, context, size and pitch of the
+/// destination are left untouched.
+/// \param[in] source Source surface in sourceFormat.
+/// \param[in] sourceFormat NVST_SF_ARGB, NVST_SF_BGRA or NVST_SF_ABGR.
+/// \param[in,out] destination NV12 surface at least as large as the source data.
+/// \param[in] coefficients From nvstGetCscCoefficients for sourceFormat.
+/// \param[in] kernel Kernel to use; NVST_CSC_KERNEL_AUTO picks the fastest one.
+/// \retval NVST_R_SUCCESS
+/// \retval NVST_R_INVALID_PARAM Unsupported format, missing buffers or destination too small.
+/// \retval NVST_R_NO_IMPLEMENTATION The kernel isn't supported on this CPU.
+/// \ingroup VideoData
+static inline NvstResult nvstConvertRgbToNv12(
+    const NvstGraphicsSurface* source,
+    NvstSurfaceFormat sourceFormat,
+    NvstGraphicsSurface* destination,
+    const NvstCscCoefficients* coefficients,
+    NvstCscKernel kernel)
+{
+    NvstSurfacePlanes src;
+    if (!source || !destination || !coefficients || !nvstGetSurfacePlanes(source, sourceFormat, &src) ||
+        src.planeCount != 1)
+    {
+        return NVST_R_INVALID_PARAM;
+    }
+    if (destination->width < src.width || destination->height < src.height)
+    {
+        return NVST_R_INVALID_PARAM;
+    }
+    if (kernel == NVST_CSC_KERNEL_AUTO)
+    {
+        kernel = nvstCscGetBestKernel();
+    }
+    else if (!nvstCscKernelSupported(kernel))
+    {
+        return NVST_R_NO_IMPLEMENTATION;
+    }
+    destination->dataWidth = src.width;
+    destination->dataHeight = src.height;
+    NvstSurfacePlanes dst;
+    if (!nvstGetSurfacePlanes(destination, NVST_SF_NV12, &dst))
+    {
+        return NVST_R_INVALID_PARAM;
+    }
+
+    for (uint32_t y = 0; y < src.height; y += 2)
+    {
+        const bool pair = y + 1 < src.height;
+        const uint8_t* row0 = src.data[0] + static_cast<size_t>(src.pitch[0]) * y;
+        const uint8_t* row1 = pair ? row0 + src.pitch[0] : row0;
+        uint8_t* y0 = dst.data[0] + static_cast<size_t>(dst.pitch[0]) * y;
+        uint8_t* y1 = pair ? y0 + dst.pitch[0] : nullptr;
+        uint8_t* uv = dst.data[1] + static_cast<size_t>(dst.pitch[1]) * (y / 2);
+        switch (kernel)
+        {
+#if defined(NVST_CSC_X86)
+        case NVST_CSC_KERNEL_AVX2:
+            nvst_csc::convertRowsAvx2(*coefficients, row0, row1, y0, y1, uv, src.width);
+            break;
+        case NVST_CSC_KERNEL_SSE4:
+            nvst_csc::convertRowsSse(*coefficients, row0, row1, y0, y1, uv, src.width);
+            break;
+#endif
+        default:
+            nvst_csc::convertRowsScalar(*coefficients, row0, row1, y0, y1, uv, 0, src.width);
+            break;
+        }
+    }
+
+    destination->renderSequenceNumber = source->renderSequenceNumber;
+    destination->renderTimestampUs = source->renderTimestampUs;
+    destination->displayTimestampUs = source->displayTimestampUs;
+    destination->captureStartTs = source->captureStartTs;
+    destination->captureEndTs = source->captureEndTs;
+    destination->metadataSize = source->metadataSize;
+    destination->metadata = source->metadata;
+    destination->sizeHintPerBlock = source->sizeHintPerBlock;
+    destination->meHintCountsPerBlock = source->meHintCountsPerBlock;
+    destination->meExternalHints = source->meExternalHints;
+    destination->vvsyncStatus = source->vvsyncStatus;
+    return NVST_R_SUCCESS;
+}
+
+/// Per-stream RGB to NV12 converter.
+///
+/// Takes the source format from surfaceFormat and the output colour space from
+/// surfaceColorSpace of the stream's NvstVideoSenderStreamConfig.
+/// \ingroup VideoData
+class NvstSurfaceConverter
+{
+public:
+    /// \param[in] config Sender configuration of the stream producing the frames.
+    /// \param[in] kernel Kernel to use; NVST_CSC_KERNEL_AUTO picks the fastest one.
+    explicit NvstSurfaceConverter(
+        const NvstVideoSenderStreamConfig& config,
+        NvstCscKernel kernel = NVST_CSC_KERNEL_AUTO)
+        : m_sourceFormat(config.surfaceFormat)
+        , m_kernel(kernel == NVST_CSC_KERNEL_AUTO ? nvstCscGetBestKernel() : kernel)
+    {
+        m_valid = nvstGetCscCoefficients(config.surfaceColorSpace, m_sourceFormat, &m_coefficients);
+    }
+
+    /// \return false if the stream's surfaceFormat or surfaceColorSpace isn't supported.
+    bool valid() const { return m_valid; }
+
+    /// \return Kernel in use.
+    NvstCscKernel kernel() const { return m_kernel; }
+
+    /// Convert one frame. \sa nvstConvertRgbToNv12
+    NvstResult convert(const NvstGraphicsSurface* source, NvstGraphicsSurface* destination) const
+    {
+        if (!m_valid)
+        {
+            return NVST_R_INVALID_STATE;
+        }
+        return nvstConvertRgbToNv12(source, m_sourceFormat, destination, &m_coefficients, m_kernel);
+    }
+
+private:
+    NvstSurfaceFormat m_sourceFormat;
+    NvstCscKernel m_kernel;
+    NvstCscCoefficients m_coefficients;
+    bool m_valid = false;
+};
@@ -0,0 +1,418 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file FrameGenerator.h
+/// Synthetic, reproducible video source for loopback benchmarks.
+///
+/// Renders moving test patterns on the CPU directly into system memory surfaces
+/// (typically taken from an NvstSurfacePool), without a game or a GPU.
+/// The pattern is a set of scrolling diagonal colour stripes with a bouncing
+/// checkerboard box, plus an optional share of noise rows to raise entropy.
+/// Every row is produced by copying from precomputed pattern rows or by a
+/// vectorized noise generator, which sustains 4K120 on one core.
+
+#pragma once
+
+#include <nvsc/TimeUtils.h>
+#include <nvst/common/SurfaceLayout.h>
+#include <nvst/server/SurfacePool.h>
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NVST_FRAME_GENERATOR_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NVST_FRAME_GENERATOR_NEON 1
+#endif
+
+/// Configuration of NvstFrameGenerator.
+/// \ingroup VideoData
+typedef struct NvstFrameGeneratorConfig_t
+{
+    /// One of NVST_SF_ARGB, NVST_SF_BGRA, NVST_SF_ABGR, NVST_SF_NV12 or NVST_SF_YCbCr420p.
+    NvstSurfaceFormat format;
+    /// Horizontal motion of the pattern in pixels per frame.
+    int32_t motionX;
+    /// Vertical motion of the pattern in pixels per frame.
+    int32_t motionY;
+    /// Share of rows replaced by noise, from 0 (smooth, cheap to encode) to 1 (pure noise).
+    float entropy;
+    /// Seed making the noise reproducible across runs.
+    uint64_t seed;
+} NvstFrameGeneratorConfig;
+
+/// Fill the config with defaults: NV12, motion of (4, 2) pixels per frame, 5% noise.
+static inline void nvstFrameGeneratorGetDefaultConfig(NvstFrameGeneratorConfig* config)
+{
+    config->format = NVST_SF_NV12;
+    config->motionX = 4;
+    config->motionY = 2;
+    config->entropy = 0.05f;
+    config->seed = 0x9E3779B97F4A7C15ull;
+}
+
+/// CPU test pattern generator writing into system memory surfaces.
+///
+/// Output is a pure function of the configuration, the frame index and the
+/// surface geometry, so runs are reproducible. Only renderSequenceNumber and
+/// renderTimestampUs depend on the call.
+/// \ingroup VideoData
+class NvstFrameGenerator
+{
+public:
+    /// \param[in] width Width of the frames to render. Must be even for YUV formats.
+    /// \param[in] height Height of the frames to render. Must be even for YUV formats.
+    /// \param[in] config Generator configuration.
+    NvstFrameGenerator(uint32_t width, uint32_t height, const NvstFrameGeneratorConfig& config)
+        : m_width(width)
+        , m_height(height)
+        , m_config(config)
+    {
+        if (m_config.entropy < 0.0f)
+        {
+            m_config.entropy = 0.0f;
+        }
+        if (m_config.entropy > 1.0f)
+        {
+            m_config.entropy = 1.0f;
+        }
+        m_noiseThreshold = static_cast<uint32_t>(m_config.entropy * 65536.0f);
+        m_boxSize = (width < height ? width : height) / 4 & ~1u;
+        buildPatternRows();
+    }
+
+    /// \return Index of the next frame to render.
+    uint32_t frameIndex() const { return m_frameIndex; }
+
+    /// Acquire a surface from the pool and render the next frame into it.
+    /// \return The rendered surface, or NULL if the pool is exhausted, its format differs from
+    /// the configured one or its surfaces are smaller than the generator
+    /// (the frame index is not advanced in that case).
+    NvstGraphicsSurface* renderNext(NvstSurfacePool& pool)
+    {
+        if (pool.format() != m_config.format)
+        {
+            return nullptr;
+        }
+        NvstGraphicsSurface* surface = pool.acquire();
+        if (surface && !render(surface))
+        {
+            NvstSurfacePool::release(surface);
+            return nullptr;
+        }
+        return surface;
+    }
+
+    /// Render the next frame into a surface.
+    ///
+    /// Fills the pixels within dataWidth x dataHeight (which is set to the generator size),
+    /// renderSequenceNumber and renderTimestampUs.
+    /// NvstGraphicsSurface doesn't carry its format, so the caller must make sure the surface
+    /// is in the configured format; renderNext() checks this against the pool.
+    /// \return false if the surface or its pitch is too small for the generator.
+    bool render(NvstGraphicsSurface* surface)
+    {
+        if (surface->width < m_width || surface->height < m_height)
+        {
+            return false;
+        }
+        surface->dataWidth = m_width;
+        surface->dataHeight = m_height;
+        NvstSurfacePlanes planes;
+        if (!nvstGetSurfacePlanes(surface, m_config.format, &planes))
+        {
+            return false;
+        }
+        for (uint32_t p = 0; p < planes.planeCount; ++p)
+        {
+            if (planes.pitch[p] < m_planes[p].rowBytes)
+            {
+                return false;
+            }
+        }
+
+        const uint32_t n = m_frameIndex;
+        const int64_t shiftX = static_cast<int64_t>(n) * m_config.motionX;
+        const int64_t shiftY = static_cast<int64_t>(n) * m_config.motionY;
+        // Diagonal stripes: P(x, y) = lut[(x + y - shiftX - shiftY) & 255].
+        const uint32_t phase = static_cast<uint32_t>(-(shiftX + shiftY)) & (kPeriod - 1);
+        const uint32_t boxX = bounce(shiftX, m_width - m_boxSize) & ~1u;
+        const uint32_t boxY = bounce(shiftY, m_height - m_boxSize) & ~1u;
+
+        for (uint32_t y = 0; y < m_height; ++y)
+        {
+            const bool noise = isNoiseRow(n, y);
+            const bool boxRow = y >= boxY && y < boxY + m_boxSize;
+            const uint32_t rowPhase = (y + phase) & (kPeriod - 1);
+            const uint32_t checker = ((y - boxY) / kCheckerSize) & 1;
+            for (uint32_t p = 0; p < planes.planeCount; ++p)
+            {
+                const Plane& plane = m_planes[p];
+                if (p > 0 && (y & 1))
+                {
+                    // 4:2:0 chroma rows are written with the even luma rows.
+                    continue;
+                }
+                const uint32_t planeY = p > 0 && m_subsampled ? y / 2 : y;
+                uint8_t* row = planes.data[p] + static_cast<size_t>(planes.pitch[p]) * planeY;
+                if (noise)
+                {
+                    fillNoise(row, plane.rowBytes, mix(m_config.seed, n, y, p));
+                    continue;
+                }
+                const uint32_t offset = p > 0 && m_subsampled ? rowPhase / 2 : rowPhase;
+                std::memcpy(row, plane.stripes.data() + offset * plane.bytesPerPixel, plane.rowBytes);
+                if (boxRow && m_boxSize)
+                {
+                    const uint32_t x = p > 0 && m_subsampled ? boxX / 2 : boxX;
+                    const std::vector<uint8_t>& boxPattern = plane.box[checker];
+                    std::memcpy(row + x * plane.bytesPerPixel, boxPattern.data(), boxPattern.size());
+                }
+            }
+        }
+
+        surface->renderSequenceNumber = n;
+        surface->renderTimestampUs = static_cast<uint64_t>(nvstGetTimeNs() / 1000);
+        ++m_frameIndex;
+        return true;
+    }
+
+private:
+    static const uint32_t kPeriod = 256;
+    static const uint32_t kCheckerSize = 16;
+
+    struct Plane
+    {
+        uint32_t bytesPerPixel = 1;
+        size_t rowBytes = 0;
+        /// Stripe row, kPeriod pixels longer than the plane so any phase can be copied out.
+        std::vector<uint8_t> stripes;
+        /// The two checkerboard phases of the box.
+        std::vector<uint8_t> box[2];
+    };
+
+    struct Yuv
+    {
+        uint8_t y, u, v;
+    };
+
+    static Yuv toYuv(uint8_t r, uint8_t g, uint8_t b)
+    {
+        // BT.709 limited range; exact colorimetry is irrelevant for a test pattern.
+        Yuv yuv;
+        yuv.y = static_cast<uint8_t>(16 + ((47 * r + 157 * g + 16 * b + 128) >> 8));
+        yuv.u = static_cast<uint8_t>(128 + ((-26 * r - 87 * g + 112 * b + 128) >> 8));
+        yuv.v = static_cast<uint8_t>(128 + ((112 * r - 102 * g - 10 * b + 128) >> 8));
+        return yuv;
+    }
+
+    static void stripeColor(uint32_t i, uint8_t* r, uint8_t* g, uint8_t* b)
+    {
+        *r = static_cast<uint8_t>(i);
+        *g = static_cast<uint8_t>(i * 2);
+        *b = static_cast<uint8_t>(255 - i);
+    }
+
+    static void boxColor(uint32_t checker, uint8_t* r, uint8_t* g, uint8_t* b)
+    {
+        *r = checker ? 240 : 16;
+        *g = checker ? 240 : 16;
+        *b = checker ? 64 : 16;
+    }
+
+    void buildPatternRows()
+    {
+        const NvstSurfaceFormat format = m_config.format;
+        const uint32_t span = m_width + kPeriod;
+        NvstPackedRgbOffsets rgb;
+        if (nvstGetPackedRgbOffsets(format, &rgb))
+        {
+            Plane& plane = m_planes[0];
+            plane.bytesPerPixel = 4;
+            plane.rowBytes = static_cast<size_t>(m_width) * 4;
+            plane.stripes.resize(static_cast<size_t>(span) * 4);
+            for (uint32_t x = 0; x < span; ++x)
+            {
+                uint8_t* px = &plane.stripes[x * 4];
+                stripeColor(x & (kPeriod - 1), &px[rgb.r], &px[rgb.g], &px[rgb.b]);
+                px[rgb.a] = 255;
+            }
+            for (uint32_t c = 0; c < 2; ++c)
+            {
+                plane.box[c].resize(static_cast<size_t>(m_boxSize) * 4);
+                for (uint32_t x = 0; x < m_boxSize; ++x)
+                {
+                    uint8_t* px = &plane.box[c][x * 4];
+                    boxColor(c ^ ((x / kCheckerSize) & 1), &px[rgb.r], &px[rgb.g], &px[rgb.b]);
+                    px[rgb.a] = 255;
+                }
+            }
+            return;
+        }
+
+        m_subsampled = true;
+        Plane& luma = m_planes[0];
+        luma.rowBytes = m_width;
+        luma.stripes.resize(span);
+        for (uint32_t x = 0; x < span; ++x)
+        {
+            uint8_t r, g, b;
+            stripeColor(x & (kPeriod - 1), &r, &g, &b);
+            luma.stripes[x] = toYuv(r, g, b).y;
+        }
+        for (uint32_t c = 0; c < 2; ++c)
+        {
+            luma.box[c].resize(m_boxSize);
+            for (uint32_t x = 0; x < m_boxSize; ++x)
+            {
+                uint8_t r, g, b;
+                boxColor(c ^ ((x / kCheckerSize) & 1), &r, &g, &b);
+                luma.box[c][x] = toYuv(r, g, b).y;
+            }
+        }
+
+        // Chroma is sampled at every other stripe phase; the box chroma is flat.
+        uint8_t r, g, b;
+        boxColor(0, &r, &g, &b);
+        const Yuv boxYuv = toYuv(r, g, b);
+        const uint32_t chromaSpan = span / 2;
+        const uint32_t chromaBox = m_boxSize / 2;
+        if (format == NVST_SF_NV12)
+        {
+            Plane& uv = m_planes[1];
+            uv.bytesPerPixel = 2;
+            uv.rowBytes = static_cast<size_t>(m_width / 2) * 2;
+            uv.stripes.resize(static_cast<size_t>(chromaSpan) * 2);
+            for (uint32_t x = 0; x < chromaSpan; ++x)
+            {
+                stripeColor((2 * x) & (kPeriod - 1), &r, &g, &b);
+                const Yuv yuv = toYuv(r, g, b);
+                uv.stripes[2 * x] = yuv.u;
+                uv.stripes[2 * x + 1] = yuv.v;
+            }
+            for (uint32_t c = 0; c < 2; ++c)
+            {
+                uv.box[c].resize(static_cast<size_t>(chromaBox) * 2);
+                for (uint32_t x = 0; x < chromaBox; ++x)
+                {
+                    uv.box[c][2 * x] = boxYuv.u;
+                    uv.box[c][2 * x + 1] = boxYuv.v;
+                }
+            }
+        }
+        else
+        {
+            for (uint32_t p = 1; p < 3; ++p)
+            {
+                Plane& chroma = m_planes[p];
+                chroma.rowBytes = m_width / 2;
+                chroma.stripes.resize(chromaSpan);
+                for (uint32_t x = 0; x < chromaSpan; ++x)
+                {
+                    stripeColor((2 * x) & (kPeriod - 1), &r, &g, &b);
+                    const Yuv yuv = toYuv(r, g, b);
+                    chroma.stripes[x] = p == 1 ? yuv.u : yuv.v;
+                }
+                for (uint32_t c = 0; c < 2; ++c)
+                {
+                    chroma.box[c].assign(chromaBox, p == 1 ? boxYuv.u : boxYuv.v);
+                }
+            }
+        }
+    }
+
+    /// Triangle wave in [0, range], so the box bounces off the frame edges.
+    static uint32_t bounce(int64_t position, uint32_t range)
+    {
+        if (range == 0)
+        {
+            return 0;
+        }
+        const int64_t period = 2 * static_cast<int64_t>(range);
+        int64_t t = position % period;
+        t = t < 0 ? t + period : t;
+        return static_cast<uint32_t>(t <= range ? t : period - t);
+    }
+
+    static uint64_t mix(uint64_t seed, uint32_t frame, uint32_t row, uint32_t plane)
+    {
+        uint64_t x = seed ^ (static_cast<uint64_t>(frame) << 32) ^ (static_cast<uint64_t>(row) << 2) ^ plane;
+        x ^= x >> 33;
+        x *= 0xFF51AFD7ED558CCDull;
+        x ^= x >> 33;
+        x *= 0xC4CEB9FE1A85EC53ull;
+        x ^= x >> 33;
+        return x | 1;
+    }
+
+    bool isNoiseRow(uint32_t frame, uint32_t y) const
+    {
+        if (m_noiseThreshold == 0)
+        {
+            return false;
+        }
+        // Decide per pair of rows so 4:2:0 chroma rows follow their luma rows.
+        return (mix(m_config.seed, frame, y >> 1, 3) & 0xFFFF) < m_noiseThreshold;
+    }
+
+    /// Fill a row with xorshift32 noise, four lanes at a time where SIMD is available.
+    static void fillNoise(uint8_t* dst, size_t size, uint64_t seed)
+    {
+        uint32_t lanes[4] = {static_cast<uint32_t>(seed) | 1,
+                             static_cast<uint32_t>(seed >> 32) | 1,
+                             static_cast<uint32_t>(seed * 3) | 1,
+                             static_cast<uint32_t>((seed >> 32) * 5) | 1};
+        size_t i = 0;
+#if defined(NVST_FRAME_GENERATOR_SSE2)
+        __m128i state = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lanes));
+        for (; i + 16 <= size; i += 16)
+        {
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 13));
+            state = _mm_xor_si128(state, _mm_srli_epi32(state, 17));
+            state = _mm_xor_si128(state, _mm_slli_epi32(state, 5));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), state);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), state);
+#elif defined(NVST_FRAME_GENERATOR_NEON)
+        uint32x4_t state = vld1q_u32(lanes);
+        for (; i + 16 <= size; i += 16)
+        {
+            state = veorq_u32(state, vshlq_n_u32(state, 13));
+            state = veorq_u32(state, vshrq_n_u32(state, 17));
+            state = veorq_u32(state, vshlq_n_u32(state, 5));
+            vst1q_u8(dst + i, vreinterpretq_u8_u32(state));
+        }
+        vst1q_u32(lanes, state);
+#endif
+        uint32_t x = lanes[0];
+        for (; i < size; ++i)
+        {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            dst[i] = static_cast<uint8_t>(x);
+        }
+    }
+
+    uint32_t m_width;
+    uint32_t m_height;
+    NvstFrameGeneratorConfig m_config;
+    uint32_t m_noiseThreshold = 0;
+    uint32_t m_boxSize = 0;
+    bool m_subsampled = false;
+    uint32_t m_frameIndex = 0;
+    Plane m_planes[3];
+};
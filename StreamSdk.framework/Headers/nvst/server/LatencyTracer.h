@@ -0,0 +1,311 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file LatencyTracer.h
+/// Per-frame latency breakdown of the server pipeline.
+///
+/// Joins the timestamps a frame collects on its way through the server
+/// (render, push, encode, packetize, send) by frame number, and keeps one
+/// histogram per stage of the time spent since the previous recorded stage.
+
+#pragma once
+
+#include <nvsc/TimeUtils.h>
+#include <nvst/common/Histogram.h>
+#include <nvst/common/StreamConfig.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+/// Pipeline stages, in the order a frame passes them.
+/// \ingroup Video
+typedef enum NvstLatencyStage_t
+{
+    /// Frame rendered (NvstGraphicsSurface::renderTimestampUs).
+    NVST_LS_RENDER = 0,
+    /// Frame handed to nvstPushStreamData.
+    NVST_LS_PUSH = 1,
+    /// Encoder picked up the frame.
+    NVST_LS_ENCODE_START = 2,
+    /// Encoder produced the bitstream.
+    NVST_LS_ENCODE_END = 3,
+    /// Bitstream split into packets.
+    NVST_LS_PACKETIZE = 4,
+    /// Last packet sent (or frameStatusUpdated received).
+    NVST_LS_SEND = 5,
+    NVST_LS_COUNT
+} NvstLatencyStage;
+
+/// Counters of an NvstLatencyTracer.
+/// \ingroup Video
+typedef struct NvstLatencyTracerStats_t
+{
+    /// Frames that reached NVST_LS_SEND.
+    uint64_t framesCompleted;
+    /// Frames reported as dropped through onFrameStatus().
+    uint64_t framesDropped;
+    /// Frames whose slot was reused by a newer frame before they reached NVST_LS_SEND.
+    uint64_t framesEvicted;
+    /// Marks ignored because their slot already belongs to a newer frame.
+    uint64_t staleMarks;
+    /// Frame statuses ignored because the frame key callback didn't know the frame.
+    uint64_t unmatchedStatuses;
+} NvstLatencyTracerStats;
+
+/// Maps NvstVideoFrameStatus::frameNumber, the encoder's frame number, to the key the frame was marked with.
+/// \param[in] context Context given to NvstLatencyTracer::setFrameKeyProc().
+/// \param[in] encoderFrameNumber Frame number reported by frameStatusUpdated.
+/// \param[out] frameNumber Key of the frame, e.g. its renderSequenceNumber.
+/// \return false if the frame is unknown; the status is then ignored.
+typedef bool (*NVST_LATENCY_FRAME_KEY_PROC)(void* context, uint32_t encoderFrameNumber, uint32_t* frameNumber);
+
+/// Opt-in, lock-free tracer of per-frame stage latencies.
+///
+/// Frames are kept in a ring indexed by frame number, so only the most recent
+/// capacity frames can be in flight. When two frames map to the same slot the
+/// newer frame keeps it; marks of the older one are counted as staleMarks.
+/// Stages may be marked from any thread, but the marks of one frame must be
+/// ordered (each stage happens after the previous one), which is naturally the
+/// case in a pipeline. Stages may be skipped; each
+/// stage histogram then measures the time since the latest earlier stage that
+/// was marked. All times are in microseconds on the nvstGetTimeNs() clock, and
+/// renderTimestampUs is expected to use the same clock.
+///
+/// The frame number is whatever key the caller uses consistently; onPush() uses
+/// NvstGraphicsSurface::renderSequenceNumber. onFrameStatus() receives the
+/// encoder's frame number instead, which equals renderSequenceNumber only if the
+/// application numbers pushed frames the way the encoder does. Otherwise install
+/// an NVST_LATENCY_FRAME_KEY_PROC with setFrameKeyProc() to translate it.
+/// \ingroup Video
+class NvstLatencyTracer
+{
+public:
+    /// \param[in] capacity Maximum number of frames in flight; rounded up to a power of two.
+    explicit NvstLatencyTracer(uint32_t capacity = 256)
+    {
+        uint32_t size = 1;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+        m_mask = size - 1;
+        m_slots.reset(new Slot[size]);
+    }
+
+    NvstLatencyTracer(const NvstLatencyTracer&) = delete;
+    NvstLatencyTracer& operator=(const NvstLatencyTracer&) = delete;
+
+    /// Enable or disable tracing. While disabled every call is a single relaxed load.
+    void setEnabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+
+    bool isEnabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+    /// Translate the frame numbers passed to onFrameStatus(). NULL, the default, uses them as keys unchanged.
+    /// Call before enabling the tracer.
+    void setFrameKeyProc(NVST_LATENCY_FRAME_KEY_PROC frameKeyProc, void* context)
+    {
+        m_frameKeyProc = frameKeyProc;
+        m_frameKeyContext = context;
+    }
+
+    /// Record that a frame reached a stage.
+    /// \param[in] frameNumber Key of the frame.
+    /// \param[in] stage Stage reached.
+    /// \param[in] timestampUs Time the stage was reached; 0 means now.
+    void mark(uint32_t frameNumber, NvstLatencyStage stage, uint64_t timestampUs = 0)
+    {
+        if (!isEnabled() || stage >= NVST_LS_COUNT)
+        {
+            return;
+        }
+        if (timestampUs == 0)
+        {
+            timestampUs = static_cast<uint64_t>(nvstGetTimeNs() / 1000);
+        }
+        Slot* claimed = claim(frameNumber);
+        if (!claimed)
+        {
+            return;
+        }
+        Slot& slot = *claimed;
+        slot.timestampUs[stage].store(timestampUs, std::memory_order_relaxed);
+
+        for (int previous = static_cast<int>(stage) - 1; previous >= 0; --previous)
+        {
+            const uint64_t earlier = slot.timestampUs[previous].load(std::memory_order_relaxed);
+            if (earlier)
+            {
+                m_stages[stage].record(timestampUs > earlier ? timestampUs - earlier : 0);
+                break;
+            }
+        }
+        if (stage == NVST_LS_SEND)
+        {
+            for (int first = 0; first < NVST_LS_SEND; ++first)
+            {
+                const uint64_t earliest = slot.timestampUs[first].load(std::memory_order_relaxed);
+                if (earliest)
+                {
+                    m_total.record(timestampUs > earliest ? timestampUs - earliest : 0);
+                    break;
+                }
+            }
+            slot.completed.store(true, std::memory_order_relaxed);
+            m_framesCompleted.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// Record render and push stages of a surface about to be pushed.
+    /// Call right before nvstPushStreamData; the frame is keyed by renderSequenceNumber.
+    void onPush(const NvstGraphicsSurface& surface)
+    {
+        if (!isEnabled())
+        {
+            return;
+        }
+        if (surface.renderTimestampUs)
+        {
+            mark(surface.renderSequenceNumber, NVST_LS_RENDER, surface.renderTimestampUs);
+        }
+        mark(surface.renderSequenceNumber, NVST_LS_PUSH);
+    }
+
+    /// Record the send stage from NvstVideoSenderStreamConfig::frameStatusUpdated.
+    /// status.frameNumber is translated by the frame key callback, if any.
+    /// Dropped frames are counted but not added to the histograms.
+    void onFrameStatus(const NvstVideoFrameStatus& status)
+    {
+        if (!isEnabled())
+        {
+            return;
+        }
+        uint32_t frameNumber = status.frameNumber;
+        if (m_frameKeyProc && !m_frameKeyProc(m_frameKeyContext, status.frameNumber, &frameNumber))
+        {
+            m_unmatchedStatuses.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (status.dropped)
+        {
+            Slot* slot = claim(frameNumber);
+            if (slot)
+            {
+                slot->completed.store(true, std::memory_order_relaxed);
+                m_framesDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            return;
+        }
+        mark(frameNumber, NVST_LS_SEND);
+    }
+
+    /// Time spent reaching a stage from the previous marked stage.
+    /// The NVST_LS_RENDER histogram stays empty, as nothing precedes it.
+    const NvstHistogram& stageHistogram(NvstLatencyStage stage) const { return m_stages[stage]; }
+
+    /// Time from the first marked stage to NVST_LS_SEND.
+    const NvstHistogram& totalHistogram() const { return m_total; }
+
+    NvstLatencyTracerStats getStats() const
+    {
+        NvstLatencyTracerStats stats;
+        stats.framesCompleted = m_framesCompleted.load(std::memory_order_relaxed);
+        stats.framesDropped = m_framesDropped.load(std::memory_order_relaxed);
+        stats.framesEvicted = m_framesEvicted.load(std::memory_order_relaxed);
+        stats.staleMarks = m_staleMarks.load(std::memory_order_relaxed);
+        stats.unmatchedStatuses = m_unmatchedStatuses.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /// Clear histograms and counters. Not atomic with respect to concurrent marks.
+    void reset()
+    {
+        for (uint32_t i = 0; i < NVST_LS_COUNT; ++i)
+        {
+            m_stages[i].reset();
+        }
+        m_total.reset();
+        m_framesCompleted.store(0, std::memory_order_relaxed);
+        m_framesDropped.store(0, std::memory_order_relaxed);
+        m_framesEvicted.store(0, std::memory_order_relaxed);
+        m_staleMarks.store(0, std::memory_order_relaxed);
+        m_unmatchedStatuses.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    /// Set in a slot's tag while its owner clears the timestamps.
+    static const uint64_t kClaiming = 1ull << 63;
+
+    struct Slot
+    {
+        /// frameNumber + 1 of the frame owning the slot, 0 if unused.
+        std::atomic<uint64_t> tag{0};
+        std::atomic<bool> completed{true};
+        std::atomic<uint64_t> timestampUs[NVST_LS_COUNT] = {};
+    };
+
+    /// \return The slot of the frame, or NULL if a newer frame owns it.
+    Slot* claim(uint32_t frameNumber)
+    {
+        Slot& slot = m_slots[frameNumber & m_mask];
+        const uint64_t tag = static_cast<uint64_t>(frameNumber) + 1;
+        uint64_t current = slot.tag.load(std::memory_order_acquire);
+        for (;;)
+        {
+            if (current == tag)
+            {
+                return &slot;
+            }
+            if (current & kClaiming)
+            {
+                std::this_thread::yield();
+                current = slot.tag.load(std::memory_order_acquire);
+                continue;
+            }
+            // Frame numbers wrap, so compare them by their distance.
+            if (current != 0 && static_cast<int32_t>(frameNumber - static_cast<uint32_t>(current - 1)) < 0)
+            {
+                m_staleMarks.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            if (slot.tag.compare_exchange_weak(current, tag | kClaiming, std::memory_order_acquire))
+            {
+                break;
+            }
+        }
+        if (current != 0 && !slot.completed.load(std::memory_order_relaxed))
+        {
+            m_framesEvicted.fetch_add(1, std::memory_order_relaxed);
+        }
+        for (uint32_t i = 0; i < NVST_LS_COUNT; ++i)
+        {
+            slot.timestampUs[i].store(0, std::memory_order_relaxed);
+        }
+        slot.completed.store(false, std::memory_order_relaxed);
+        slot.tag.store(tag, std::memory_order_release);
+        return &slot;
+    }
+
+    std::atomic<bool> m_enabled{false};
+    NVST_LATENCY_FRAME_KEY_PROC m_frameKeyProc = nullptr;
+    void* m_frameKeyContext = nullptr;
+    uint32_t m_mask = 0;
+    std::unique_ptr<Slot[]> m_slots;
+    NvstHistogram m_stages[NVST_LS_COUNT];
+    NvstHistogram m_total;
+    std::atomic<uint64_t> m_framesCompleted{0};
+    std::atomic<uint64_t> m_framesDropped{0};
+    std::atomic<uint64_t> m_framesEvicted{0};
+    std::atomic<uint64_t> m_staleMarks{0};
+    std::atomic<uint64_t> m_unmatchedStatuses{0};
+};
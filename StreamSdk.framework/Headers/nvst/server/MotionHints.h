@@ -0,0 +1,415 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file MotionHints.h
+/// CPU generation of external motion estimation hints.
+///
+/// Fills NvstGraphicsSurface::meExternalHints and meHintCountsPerBlock for
+/// streams created with NvstVideoSenderStreamConfig::enableExternalMeHints,
+/// either by block matching consecutive system memory frames or from motion
+/// vectors the application already knows (e.g. camera motion in AR).
+
+#pragma once
+
+#include <nvst/common/SurfaceLayout.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define NVST_MOTION_HINTS_SSE2 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NVST_MOTION_HINTS_NEON 1
+#endif
+
+/// Binary compatible with NVENC_EXTERNAL_ME_HINT_COUNTS_PER_BLOCKTYPE.
+/// \ingroup VideoData
+typedef struct NvstExternalMeHintCountsPerBlockType_t
+{
+    uint32_t numCandsPerBlk16x16 : 4;
+    uint32_t numCandsPerBlk16x8 : 4;
+    uint32_t numCandsPerBlk8x16 : 4;
+    uint32_t numCandsPerBlk8x8 : 4;
+    uint32_t reserved : 16;
+    uint32_t reserved1[3];
+} NvstExternalMeHintCountsPerBlockType;
+
+/// Binary compatible with NVENC_EXTERNAL_ME_HINT.
+/// \ingroup VideoData
+typedef struct NvstExternalMeHint_t
+{
+    /// Horizontal motion in quarter pixels.
+    int32_t mvx : 12;
+    /// Vertical motion in quarter pixels.
+    int32_t mvy : 10;
+    /// Reference index; always 0 (the previous frame) here.
+    int32_t refidx : 5;
+    /// 0 for L0, 1 for L1.
+    int32_t dir : 1;
+    /// 0 = 16x16, 1 = 16x8, 2 = 8x16, 3 = 8x8.
+    int32_t partType : 2;
+    int32_t lastofPart : 1;
+    int32_t lastOfMB : 1;
+} NvstExternalMeHint;
+
+static_assert(sizeof(NvstExternalMeHintCountsPerBlockType) == 16, "Must match NVENC layout");
+static_assert(sizeof(NvstExternalMeHint) == 4, "Must match NVENC layout");
+
+/// Full-pixel motion vector of one 16x16 block: the block's content moved
+/// from (x + x, y + y) in the reference frame to (x, y) in the current one.
+/// \ingroup VideoData
+typedef struct NvstMotionVector_t
+{
+    int16_t x;
+    int16_t y;
+} NvstMotionVector;
+
+/// Configuration of NvstMotionHintGenerator.
+/// \ingroup VideoData
+typedef struct NvstMotionHintConfig_t
+{
+    /// Maximum refinement distance in pixels around the best predictor.
+    uint32_t searchRange;
+    /// Number of L0 candidates per 16x16 block (1 or 2). The second candidate is
+    /// the runner-up predictor, which helps at object boundaries.
+    uint32_t candidatesPerBlock;
+    /// Weight of the distance to the predicted vector in the matching cost,
+    /// which keeps the field smooth in flat areas.
+    uint32_t smoothness;
+} NvstMotionHintConfig;
+
+/// Fill the config with defaults: 16 pixel search range, 1 candidate, smoothness 4.
+static inline void nvstMotionHintGetDefaultConfig(NvstMotionHintConfig* config)
+{
+    config->searchRange = 16;
+    config->candidatesPerBlock = 1;
+    config->smoothness = 4;
+}
+
+/// Motion hint generator for one video stream.
+///
+/// Hints are produced for a 16x16 block grid in raster order, L0 only, as
+/// NVENC expects them for H.264 macroblocks. Block matching uses the luma
+/// plane, so sources must be NVST_SF_NV12 or NVST_SF_YCbCr420p (convert
+/// packed RGB first, see ColorConvert.h). The search evaluates spatial,
+/// temporal, global and application predictors and refines the best one with
+/// a small diamond search, using SIMD SAD where available.
+///
+/// The hint buffers belong to the generator and are reused by the next call,
+/// so attach() them to one frame at a time.
+/// \ingroup VideoData
+class NvstMotionHintGenerator
+{
+public:
+    /// \param[in] width Width of the frames in pixels.
+    /// \param[in] height Height of the frames in pixels.
+    /// \param[in] config Generator configuration.
+    NvstMotionHintGenerator(uint32_t width, uint32_t height, const NvstMotionHintConfig& config)
+        : m_width(width)
+        , m_height(height)
+        , m_config(config)
+        , m_blocksX((width + 15) / 16)
+        , m_blocksY((height + 15) / 16)
+    {
+        m_config.candidatesPerBlock = m_config.candidatesPerBlock >= 2 ? 2 : 1;
+        const size_t blocks = static_cast<size_t>(m_blocksX) * m_blocksY;
+        m_vectors.assign(blocks, NvstMotionVector());
+        m_previous.assign(blocks, NvstMotionVector());
+        m_runnerUp.assign(blocks, NvstMotionVector());
+        m_hints.resize(blocks * m_config.candidatesPerBlock);
+        // L0 only; the L1 entry stays zero.
+        std::memset(m_counts, 0, sizeof(m_counts));
+        m_counts[0].numCandsPerBlk16x16 = m_config.candidatesPerBlock;
+    }
+
+    /// Value for NvstVideoSenderStreamConfig::maxMeHintCountsPerBlock: the L0 and L1 counts.
+    /// The pointer stays valid for the lifetime of the generator.
+    NvstExternalMeHintCountsPerBlockType* maxCountsPerBlock() { return m_counts; }
+
+    /// Estimate motion between two frames by block matching.
+    /// \param[in] current Frame about to be pushed.
+    /// \param[in] reference Previously pushed frame (the encoder's reference).
+    /// \param[in] format NVST_SF_NV12 or NVST_SF_YCbCr420p.
+    /// \param[in] appVectors Optional per-block predictors from the application, in raster order.
+    /// \param[in] globalMotion Optional predictor shared by all blocks, e.g. camera pan.
+    /// \return false if the frames can't be read or don't match the generator size.
+    bool generate(
+        const NvstGraphicsSurface* current,
+        const NvstGraphicsSurface* reference,
+        NvstSurfaceFormat format,
+        const NvstMotionVector* appVectors = nullptr,
+        const NvstMotionVector* globalMotion = nullptr)
+    {
+        if (format != NVST_SF_NV12 && format != NVST_SF_YCbCr420p)
+        {
+            return false;
+        }
+        NvstSurfacePlanes cur, ref;
+        if (!nvstGetSurfacePlanes(current, format, &cur) || !nvstGetSurfacePlanes(reference, format, &ref) ||
+            cur.width != m_width || cur.height != m_height || ref.width != m_width || ref.height != m_height)
+        {
+            return false;
+        }
+
+        m_previous.swap(m_vectors);
+        Frame frame = {cur.data[0], cur.pitch[0], ref.data[0], ref.pitch[0]};
+        for (uint32_t by = 0; by < m_blocksY; ++by)
+        {
+            for (uint32_t bx = 0; bx < m_blocksX; ++bx)
+            {
+                const size_t index = static_cast<size_t>(by) * m_blocksX + bx;
+                NvstMotionVector predictors[6];
+                uint32_t count = 0;
+                predictors[count++] = NvstMotionVector();
+                if (bx > 0)
+                {
+                    predictors[count++] = m_vectors[index - 1];
+                }
+                if (by > 0)
+                {
+                    predictors[count++] = m_vectors[index - m_blocksX];
+                }
+                predictors[count++] = m_previous[index];
+                if (appVectors)
+                {
+                    predictors[count++] = appVectors[index];
+                }
+                if (globalMotion)
+                {
+                    predictors[count++] = *globalMotion;
+                }
+                searchBlock(frame, bx * 16, by * 16, predictors, count, &m_vectors[index], &m_runnerUp[index]);
+            }
+        }
+        buildHints();
+        return true;
+    }
+
+    /// Build hints directly from application motion vectors, without block matching.
+    /// \param[in] vectors One vector per 16x16 block in raster order (blockCount() entries).
+    void generateFromMotionVectors(const NvstMotionVector* vectors)
+    {
+        m_previous.swap(m_vectors);
+        for (size_t i = 0; i < m_vectors.size(); ++i)
+        {
+            m_vectors[i] = clampVector(vectors[i]);
+            m_runnerUp[i] = m_vectors[i];
+        }
+        buildHints();
+    }
+
+    /// Attach the hints of the last generate*() call to a surface before pushing it.
+    void attach(NvstGraphicsSurface* surface)
+    {
+        surface->meExternalHints = m_hints.data();
+        surface->meHintCountsPerBlock = m_counts;
+        surface->sizeHintPerBlock = m_config.candidatesPerBlock;
+    }
+
+    /// \return Motion field of the last generate*() call, one vector per block in raster order.
+    const NvstMotionVector* vectors() const { return m_vectors.data(); }
+
+    uint32_t blocksX() const { return m_blocksX; }
+    uint32_t blocksY() const { return m_blocksY; }
+    size_t blockCount() const { return m_vectors.size(); }
+
+    /// Sum of absolute differences of two 16x16 blocks.
+    static uint32_t sad16x16(const uint8_t* a, uint32_t pitchA, const uint8_t* b, uint32_t pitchB)
+    {
+#if defined(NVST_MOTION_HINTS_SSE2)
+        __m128i sum = _mm_setzero_si128();
+        for (int row = 0; row < 16; ++row)
+        {
+            const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + static_cast<size_t>(pitchA) * row));
+            const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + static_cast<size_t>(pitchB) * row));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb));
+        }
+        return static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_cvtsi128_si32(_mm_srli_si128(sum, 8)));
+#elif defined(NVST_MOTION_HINTS_NEON)
+        uint16x8_t sum = vdupq_n_u16(0);
+        for (int row = 0; row < 16; ++row)
+        {
+            const uint8x16_t va = vld1q_u8(a + static_cast<size_t>(pitchA) * row);
+            const uint8x16_t vb = vld1q_u8(b + static_cast<size_t>(pitchB) * row);
+            sum = vpadalq_u8(sum, vabdq_u8(va, vb));
+        }
+        const uint32x4_t sum32 = vpaddlq_u16(sum);
+        const uint64x2_t sum64 = vpaddlq_u32(sum32);
+        return static_cast<uint32_t>(vgetq_lane_u64(sum64, 0) + vgetq_lane_u64(sum64, 1));
+#else
+        uint32_t sum = 0;
+        for (int row = 0; row < 16; ++row)
+        {
+            for (int col = 0; col < 16; ++col)
+            {
+                sum += static_cast<uint32_t>(
+                    std::abs(a[static_cast<size_t>(pitchA) * row + col] - b[static_cast<size_t>(pitchB) * row + col]));
+            }
+        }
+        return sum;
+#endif
+    }
+
+private:
+    /// Range of the NVENC fields in full pixels: mvx is 12 bits and mvy 10 bits of quarter pixels.
+    static const int kMaxVectorX = 511;
+    static const int kMaxVectorY = 127;
+
+    struct Frame
+    {
+        const uint8_t* current;
+        uint32_t currentPitch;
+        const uint8_t* reference;
+        uint32_t referencePitch;
+    };
+
+    static NvstMotionVector clampVector(NvstMotionVector v)
+    {
+        v.x = static_cast<int16_t>(v.x < -kMaxVectorX ? -kMaxVectorX : (v.x > kMaxVectorX ? kMaxVectorX : v.x));
+        v.y = static_cast<int16_t>(v.y < -kMaxVectorY ? -kMaxVectorY : (v.y > kMaxVectorY ? kMaxVectorY : v.y));
+        return v;
+    }
+
+    bool inside(uint32_t x, uint32_t y, NvstMotionVector v) const
+    {
+        const int64_t rx = static_cast<int64_t>(x) + v.x;
+        const int64_t ry = static_cast<int64_t>(y) + v.y;
+        return rx >= 0 && ry >= 0 && rx + 16 <= m_width && ry + 16 <= m_height && v.x >= -kMaxVectorX &&
+            v.x <= kMaxVectorX && v.y >= -kMaxVectorY && v.y <= kMaxVectorY;
+    }
+
+    uint32_t cost(const Frame& frame, uint32_t x, uint32_t y, NvstMotionVector v, NvstMotionVector predicted) const
+    {
+        const uint8_t* cur = frame.current + static_cast<size_t>(frame.currentPitch) * y + x;
+        const uint8_t* ref = frame.reference + static_cast<size_t>(frame.referencePitch) * (y + v.y) + (x + v.x);
+        const uint32_t distance = static_cast<uint32_t>(std::abs(v.x - predicted.x) + std::abs(v.y - predicted.y));
+        return sad16x16(cur, frame.currentPitch, ref, frame.referencePitch) + m_config.smoothness * distance;
+    }
+
+    void searchBlock(
+        const Frame& frame,
+        uint32_t x,
+        uint32_t y,
+        const NvstMotionVector* predictors,
+        uint32_t predictorCount,
+        NvstMotionVector* best,
+        NvstMotionVector* runnerUp) const
+    {
+        // Blocks that straddle the frame edge can't be matched; inherit the left neighbour's motion.
+        if (x + 16 > m_width || y + 16 > m_height)
+        {
+            *best = predictorCount > 1 && x > 0 ? predictors[1] : NvstMotionVector();
+            *runnerUp = *best;
+            return;
+        }
+
+        // The spatial median-ish predictor used for the smoothness term: the left neighbour if any.
+        const NvstMotionVector predicted = predictorCount > 1 ? predictors[1] : NvstMotionVector();
+        uint32_t bestCost = UINT32_MAX;
+        uint32_t secondCost = UINT32_MAX;
+        NvstMotionVector bestVector = NvstMotionVector();
+        NvstMotionVector secondVector = NvstMotionVector();
+        for (uint32_t i = 0; i < predictorCount; ++i)
+        {
+            const NvstMotionVector v = clampVector(predictors[i]);
+            if (!inside(x, y, v) || (i > 0 && v.x == bestVector.x && v.y == bestVector.y))
+            {
+                continue;
+            }
+            const uint32_t c = cost(frame, x, y, v, predicted);
+            if (c < bestCost)
+            {
+                secondCost = bestCost;
+                secondVector = bestVector;
+                bestCost = c;
+                bestVector = v;
+            }
+            else if (c < secondCost)
+            {
+                secondCost = c;
+                secondVector = v;
+            }
+        }
+
+        // Small diamond refinement around the best predictor.
+        static const int kDiamond[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+        const NvstMotionVector origin = bestVector;
+        for (uint32_t step = 0; step < m_config.searchRange * 2; ++step)
+        {
+            NvstMotionVector center = bestVector;
+            bool improved = false;
+            for (const int(&d)[2] : kDiamond)
+            {
+                NvstMotionVector v;
+                v.x = static_cast<int16_t>(center.x + d[0]);
+                v.y = static_cast<int16_t>(center.y + d[1]);
+                if (std::abs(v.x - origin.x) > static_cast<int>(m_config.searchRange) ||
+                    std::abs(v.y - origin.y) > static_cast<int>(m_config.searchRange) || !inside(x, y, v))
+                {
+                    continue;
+                }
+                const uint32_t c = cost(frame, x, y, v, predicted);
+                if (c < bestCost)
+                {
+                    secondCost = bestCost;
+                    secondVector = bestVector;
+                    bestCost = c;
+                    bestVector = v;
+                    improved = true;
+                }
+            }
+            if (!improved)
+            {
+                break;
+            }
+        }
+        *best = bestVector;
+        *runnerUp = secondCost == UINT32_MAX ? bestVector : secondVector;
+    }
+
+    void buildHints()
+    {
+        const uint32_t candidates = m_config.candidatesPerBlock;
+        for (size_t i = 0; i < m_vectors.size(); ++i)
+        {
+            for (uint32_t c = 0; c < candidates; ++c)
+            {
+                const NvstMotionVector& v = c == 0 ? m_vectors[i] : m_runnerUp[i];
+                NvstExternalMeHint& hint = m_hints[i * candidates + c];
+                std::memset(&hint, 0, sizeof(hint));
+                hint.mvx = v.x * 4;
+                hint.mvy = v.y * 4;
+                hint.refidx = 0;
+                hint.dir = 0;
+                hint.partType = 0;
+                hint.lastofPart = c + 1 == candidates;
+                hint.lastOfMB = c + 1 == candidates;
+            }
+        }
+    }
+
+    uint32_t m_width;
+    uint32_t m_height;
+    NvstMotionHintConfig m_config;
+    uint32_t m_blocksX;
+    uint32_t m_blocksY;
+    std::vector<NvstMotionVector> m_vectors;
+    std::vector<NvstMotionVector> m_previous;
+    std::vector<NvstMotionVector> m_runnerUp;
+    std::vector<NvstExternalMeHint> m_hints;
+    /// L0 and L1 counts, as the SDK reads them.
+    NvstExternalMeHintCountsPerBlockType m_counts[2];
+};
@@ -0,0 +1,324 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file MultiStreamScheduler.h
+/// Lockstep capture of several video streams of one connection.
+///
+/// Stereo views, or a main view plus a preview, must show content from the
+/// same instant. NvstMultiStreamScheduler drives every registered video
+/// stream from a single tick on a shared worker pool and stamps all frames
+/// of a tick with the same render timestamp, which the client sees as
+/// NvstVideoDecodeUnit::frameTimestampUs (see NvstMultiStreamFrameAligner).
+
+#pragma once
+
+#include <nvsc/TimeUtils.h>
+#include <nvst/common/Stream.h>
+#include <nvst/common/StreamConfig.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Produce the frame of one stream for a tick.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] streamIndex Index of the stream, as passed to addStream().
+/// \param[in] tickTimestampUs Time of the tick on the nvstGetTimeNs() clock, in microseconds.
+/// \param[out] streamData Frame to push (NVST_MT_VIDEO or NVST_MT_PRE_ENCODED_VIDEO).
+/// \return false to push nothing for this stream on this tick.
+typedef bool (*NVST_STREAM_CAPTURE_PROC)(
+    void* context,
+    uint16_t streamIndex,
+    uint64_t tickTimestampUs,
+    NvstStreamData* streamData);
+
+/// Take back a frame the SDK didn't accept (e.g. NVST_R_BUSY), so its buffer can be reused.
+/// \param[in] context Application-supplied pointer.
+/// \param[in] streamIndex Index of the stream.
+/// \param[in] streamData Frame that was not pushed.
+/// \param[in] result Result of the push.
+typedef void (*NVST_STREAM_REJECT_PROC)(
+    void* context,
+    uint16_t streamIndex,
+    const NvstStreamData* streamData,
+    NvstResult result);
+
+/// Counters of one stream of an NvstMultiStreamScheduler.
+/// \ingroup Video
+typedef struct NvstScheduledStreamStats_t
+{
+    /// Frames accepted by the SDK (including NVST_R_FRAME_DROPPED).
+    uint64_t pushed;
+    /// Frames not accepted by the SDK.
+    uint64_t rejected;
+    /// Ticks for which the capture proc returned false.
+    uint64_t skipped;
+} NvstScheduledStreamStats;
+
+/// Shared-tick scheduler for up to VIDEO_STREAM_MAX_COUNT video streams.
+///
+/// On every tick each stream's capture proc runs on the worker pool, and the
+/// resulting frames are pushed with renderSequenceNumber set to the tick index
+/// and renderTimestampUs set to the tick time (pre-encoded frames get the tick
+/// index as frameNumber). If any stream is still busy when the next tick is
+/// due, the whole tick is skipped, so streams never drift apart.
+/// \ingroup Video
+class NvstMultiStreamScheduler
+{
+public:
+    /// \param[in] fps Tick rate.
+    /// \param[in] workerCount Number of worker threads; 0 uses one per stream.
+    /// \param[in] pushProc Function used to hand data to the SDK. Defaults to nvstPushStreamData.
+    explicit NvstMultiStreamScheduler(
+        double fps,
+        uint32_t workerCount = 0,
+        PUSH_STREAM_DATA_PROC pushProc = nvstPushStreamData)
+        : m_workerCount(workerCount)
+        , m_pushProc(pushProc ? pushProc : nvstPushStreamData)
+    {
+        setFps(fps);
+    }
+
+    ~NvstMultiStreamScheduler() { stop(); }
+
+    NvstMultiStreamScheduler(const NvstMultiStreamScheduler&) = delete;
+    NvstMultiStreamScheduler& operator=(const NvstMultiStreamScheduler&) = delete;
+
+    /// Register a stream. Only allowed while stopped.
+    /// \param[in] streamConnection Connection of the video stream.
+    /// \param[in] captureProc Called on a worker thread once per tick.
+    /// \param[in] rejectProc Optional. Called when the SDK doesn't accept a frame.
+    /// \param[in] context Passed to both procs.
+    /// \param[out] streamIndex Optional. Receives the index passed to the procs.
+    /// \retval NVST_R_SUCCESS
+    /// \retval NVST_R_INVALID_PARAM captureProc is NULL.
+    /// \retval NVST_R_INVALID_STATE The scheduler is running or already has VIDEO_STREAM_MAX_COUNT streams.
+    NvstResult addStream(
+        NvstStreamConnection streamConnection,
+        NVST_STREAM_CAPTURE_PROC captureProc,
+        NVST_STREAM_REJECT_PROC rejectProc,
+        void* context,
+        uint16_t* streamIndex = nullptr)
+    {
+        if (!captureProc)
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+        if (m_tickThread.joinable() || m_streamCount == VIDEO_STREAM_MAX_COUNT)
+        {
+            return NVST_R_INVALID_STATE;
+        }
+        Stream& stream = m_streams[m_streamCount];
+        stream.connection = streamConnection;
+        stream.captureProc = captureProc;
+        stream.rejectProc = rejectProc;
+        stream.context = context;
+        if (streamIndex)
+        {
+            *streamIndex = static_cast<uint16_t>(m_streamCount);
+        }
+        ++m_streamCount;
+        return NVST_R_SUCCESS;
+    }
+
+    /// Change the tick rate. Takes effect from the next tick.
+    void setFps(double fps)
+    {
+        const int64_t intervalNs = fps > 0.0 ? static_cast<int64_t>(1e9 / fps) : 16666667;
+        m_intervalNs.store(intervalNs, std::memory_order_relaxed);
+    }
+
+    /// Start ticking.
+    /// \retval NVST_R_SUCCESS
+    /// \retval NVST_R_INVALID_STATE Already running or no stream was added.
+    NvstResult start()
+    {
+        if (m_tickThread.joinable() || m_streamCount == 0)
+        {
+            return NVST_R_INVALID_STATE;
+        }
+        m_stop = false;
+        m_nextStream = m_streamCount;
+        m_pending = 0;
+        const uint32_t workers = m_workerCount ? m_workerCount : m_streamCount;
+        for (uint32_t i = 0; i < workers; ++i)
+        {
+            m_workers.emplace_back(&NvstMultiStreamScheduler::workerLoop, this);
+        }
+        m_tickThread = std::thread(&NvstMultiStreamScheduler::tickLoop, this);
+        return NVST_R_SUCCESS;
+    }
+
+    /// Stop ticking and wait for the current tick to finish.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_tickCondition.notify_all();
+        m_workCondition.notify_all();
+        if (m_tickThread.joinable())
+        {
+            m_tickThread.join();
+        }
+        for (std::thread& worker : m_workers)
+        {
+            worker.join();
+        }
+        m_workers.clear();
+    }
+
+    /// \return Number of ticks dispatched to the streams.
+    uint64_t tickCount() const { return m_ticks.load(std::memory_order_relaxed); }
+
+    /// \return Number of ticks skipped because a stream was still busy or the tick thread fell behind.
+    uint64_t missedTickCount() const { return m_missedTicks.load(std::memory_order_relaxed); }
+
+    /// \return Counters of a stream.
+    NvstScheduledStreamStats getStreamStats(uint16_t streamIndex) const
+    {
+        NvstScheduledStreamStats stats = {};
+        if (streamIndex < m_streamCount)
+        {
+            const Stream& stream = m_streams[streamIndex];
+            stats.pushed = stream.pushed.load(std::memory_order_relaxed);
+            stats.rejected = stream.rejected.load(std::memory_order_relaxed);
+            stats.skipped = stream.skipped.load(std::memory_order_relaxed);
+        }
+        return stats;
+    }
+
+private:
+    struct Stream
+    {
+        NvstStreamConnection connection = nullptr;
+        NVST_STREAM_CAPTURE_PROC captureProc = nullptr;
+        NVST_STREAM_REJECT_PROC rejectProc = nullptr;
+        void* context = nullptr;
+        std::atomic<uint64_t> pushed{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> skipped{0};
+    };
+
+    void tickLoop()
+    {
+        int64_t nextNs = nvstGetTimeNs();
+        uint32_t tickIndex = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop)
+        {
+            if (m_pending == 0)
+            {
+                m_tickIndex = tickIndex++;
+                m_tickTimestampUs = static_cast<uint64_t>(nextNs / 1000);
+                m_nextStream = 0;
+                m_pending = m_streamCount;
+                m_ticks.fetch_add(1, std::memory_order_relaxed);
+                m_workCondition.notify_all();
+            }
+            else
+            {
+                m_missedTicks.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            const int64_t intervalNs = m_intervalNs.load(std::memory_order_relaxed);
+            nextNs += intervalNs;
+            const int64_t nowNs = nvstGetTimeNs();
+            if (nextNs < nowNs)
+            {
+                // Fell behind: skip the lost ticks instead of bursting to catch up.
+                const int64_t lost = (nowNs - nextNs) / intervalNs + 1;
+                m_missedTicks.fetch_add(static_cast<uint64_t>(lost), std::memory_order_relaxed);
+                nextNs += lost * intervalNs;
+            }
+            const std::chrono::steady_clock::time_point deadline{std::chrono::nanoseconds(nextNs)};
+            m_tickCondition.wait_until(lock, deadline, [this] { return m_stop; });
+        }
+    }
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;)
+        {
+            m_workCondition.wait(lock, [this] { return m_stop || m_nextStream < m_streamCount; });
+            if (m_nextStream >= m_streamCount)
+            {
+                // Stopping; streams of the tick in flight have all been handed out.
+                return;
+            }
+            const uint32_t index = m_nextStream++;
+            const uint32_t tickIndex = m_tickIndex;
+            const uint64_t tickTimestampUs = m_tickTimestampUs;
+            lock.unlock();
+            runStream(static_cast<uint16_t>(index), tickIndex, tickTimestampUs);
+            lock.lock();
+            --m_pending;
+        }
+    }
+
+    void runStream(uint16_t index, uint32_t tickIndex, uint64_t tickTimestampUs)
+    {
+        Stream& stream = m_streams[index];
+        NvstStreamData data = {};
+        if (!stream.captureProc(stream.context, index, tickTimestampUs, &data))
+        {
+            stream.skipped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (data.mediaType == NVST_MT_VIDEO)
+        {
+            data.graphicsSurface.renderSequenceNumber = tickIndex;
+            data.graphicsSurface.renderTimestampUs = tickTimestampUs;
+        }
+        else if (data.mediaType == NVST_MT_PRE_ENCODED_VIDEO)
+        {
+            data.preEncodedVideo.frameNumber = tickIndex;
+        }
+        const NvstResult result = m_pushProc(stream.connection, &data);
+        if (result == NVST_R_SUCCESS || result == NVST_R_FRAME_DROPPED)
+        {
+            stream.pushed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        stream.rejected.fetch_add(1, std::memory_order_relaxed);
+        if (stream.rejectProc)
+        {
+            stream.rejectProc(stream.context, index, &data, result);
+        }
+    }
+
+    uint32_t m_workerCount;
+    PUSH_STREAM_DATA_PROC m_pushProc;
+    std::atomic<int64_t> m_intervalNs{16666667};
+    Stream m_streams[VIDEO_STREAM_MAX_COUNT];
+    uint32_t m_streamCount = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_tickCondition;
+    std::condition_variable m_workCondition;
+    bool m_stop = false;
+    uint32_t m_nextStream = 0;
+    uint32_t m_pending = 0;
+    uint32_t m_tickIndex = 0;
+    uint64_t m_tickTimestampUs = 0;
+
+    std::atomic<uint64_t> m_ticks{0};
+    std::atomic<uint64_t> m_missedTicks{0};
+    std::thread m_tickThread;
+    std::vector<std::thread> m_workers;
+};
@@ -0,0 +1,369 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file PreEncodedFileSource.h
+/// Drive an NVST_MT_PRE_ENCODED_VIDEO stream from a recorded H.264/H.265 Annex-B file.
+///
+/// The file is memory mapped once and indexed into access units; frames are then
+/// pushed straight out of the mapping, without copies, at a configurable frame rate.
+/// One NvstPreEncodedFileSource can be shared by any number of players, which makes
+/// it practical to load-test the transport with hundreds of streams on a host
+/// without a GPU.
+/// \warning Memory mapping is only implemented for POSIX platforms.
+
+#pragma once
+
+#include <nvst/common/AnnexB.h>
+#include <nvst/common/Stream.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// One access unit of the indexed file.
+/// \ingroup VideoData
+typedef struct NvstPreEncodedFrameIndexEntry_t
+{
+    /// Offset of the first byte of the access unit in the file.
+    uint64_t offset;
+    /// Size of the access unit in bytes, start codes included.
+    uint32_t sizeInBytes;
+    /// Frame type derived from the NAL units of the access unit.
+    NvstEncodedFrameType encodedFrameType;
+    /// A decoder can start at this frame: IDR, or for H.265 IDR or BLA. Non-IDR I-frames and
+    /// CRA pictures are I-frames but not random access points.
+    bool randomAccess;
+} NvstPreEncodedFrameIndexEntry;
+
+/// Read-only, memory-mapped Annex-B file with a per-frame index.
+/// \ingroup VideoData
+class NvstPreEncodedFileSource
+{
+public:
+    NvstPreEncodedFileSource() = default;
+    ~NvstPreEncodedFileSource() { close(); }
+
+    NvstPreEncodedFileSource(const NvstPreEncodedFileSource&) = delete;
+    NvstPreEncodedFileSource& operator=(const NvstPreEncodedFileSource&) = delete;
+
+    /// Map the file and build the frame index.
+    /// \param[in] path Path of the elementary stream file.
+    /// \param[in] format Codec of the file.
+    /// \retval NVST_R_INVALID_PARAM if path is NULL
+    /// \retval NVST_R_NOT_FOUND if the file can't be opened
+    /// \retval NVST_R_INVALID_VALUE if the file contains no decodable frame, doesn't start with an IDR frame or
+    /// is 4 GiB or larger (NvstNalUnit offsets are 32-bit)
+    /// \retval NVST_R_NO_IMPLEMENTATION on platforms without mmap support
+    /// \retval NVST_R_GENERIC_ERROR if mapping failed
+    /// \retval NVST_R_SUCCESS otherwise
+    NvstResult open(const char* path, NvstVideoFormat format)
+    {
+        close();
+        if (!path)
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+#ifdef _WIN32
+        (void)format;
+        return NVST_R_NO_IMPLEMENTATION;
+#else
+        const int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+        {
+            return NVST_R_NOT_FOUND;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size <= 0 || static_cast<uint64_t>(info.st_size) > UINT32_MAX)
+        {
+            ::close(fd);
+            return NVST_R_INVALID_VALUE;
+        }
+        void* mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+        {
+            return NVST_R_GENERIC_ERROR;
+        }
+        madvise(mapping, static_cast<size_t>(info.st_size), MADV_WILLNEED);
+        m_data = static_cast<const uint8_t*>(mapping);
+        m_size = static_cast<size_t>(info.st_size);
+        m_format = format;
+
+        buildIndex();
+        if (m_frames.empty() || !m_frames[0].randomAccess)
+        {
+            close();
+            return NVST_R_INVALID_VALUE;
+        }
+        return NVST_R_SUCCESS;
+#endif
+    }
+
+    /// Unmap the file. Frames handed out earlier become invalid.
+    void close()
+    {
+#ifndef _WIN32
+        if (m_data)
+        {
+            munmap(const_cast<uint8_t*>(m_data), m_size);
+        }
+#endif
+        m_data = nullptr;
+        m_size = 0;
+        m_frames.clear();
+    }
+
+    /// \return Codec of the opened file.
+    NvstVideoFormat format() const { return m_format; }
+
+    /// \return Number of indexed frames.
+    uint32_t frameCount() const { return static_cast<uint32_t>(m_frames.size()); }
+
+    /// \return Index entry of a frame.
+    const NvstPreEncodedFrameIndexEntry& frame(uint32_t index) const { return m_frames[index]; }
+
+    /// Index of the first random access frame at or after \p index, wrapping around to the start of the file.
+    uint32_t nextIntraFrame(uint32_t index) const
+    {
+        const uint32_t count = frameCount();
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const uint32_t candidate = (index + i) % count;
+            if (m_frames[candidate].randomAccess)
+            {
+                return candidate;
+            }
+        }
+        return 0;
+    }
+
+    /// Describe a frame for nvstPushStreamData without copying it.
+    /// \param[in] index Frame to describe.
+    /// \param[in] frameNumber Frame number to report to the SDK.
+    /// \param[out] streamData Receives an NVST_MT_PRE_ENCODED_VIDEO datum pointing into the mapping.
+    /// The pointed at memory is read-only and stays valid until close().
+    void fillStreamData(uint32_t index, uint32_t frameNumber, NvstStreamData* streamData) const
+    {
+        const NvstPreEncodedFrameIndexEntry& entry = m_frames[index];
+        *streamData = NvstStreamData();
+        streamData->mediaType = NVST_MT_PRE_ENCODED_VIDEO;
+        streamData->preEncodedVideo.frame = const_cast<uint8_t*>(m_data + entry.offset);
+        streamData->preEncodedVideo.sizeInBytes = entry.sizeInBytes;
+        streamData->preEncodedVideo.frameNumber = frameNumber;
+        streamData->preEncodedVideo.encodedFrameType = entry.encodedFrameType;
+        streamData->preEncodedVideo.context = const_cast<NvstPreEncodedFileSource*>(this);
+    }
+
+private:
+    void buildIndex()
+    {
+        struct Pending
+        {
+            bool open = false;
+            bool hasVcl = false;
+            bool hasRandomAccess = false;
+            bool hasDecoderRefresh = false;
+            size_t start = 0;
+            const uint8_t* firstSlice = nullptr;
+            size_t firstSliceSize = 0;
+        } au;
+
+        const NvstVideoFormat format = m_format;
+        const uint8_t* data = m_data;
+        std::vector<NvstPreEncodedFrameIndexEntry>& frames = m_frames;
+
+        auto finish = [&](size_t end) {
+            if (au.open && au.hasVcl)
+            {
+                NvstPreEncodedFrameIndexEntry entry;
+                entry.offset = au.start;
+                entry.sizeInBytes = static_cast<uint32_t>(end - au.start);
+                entry.encodedFrameType =
+                    nvstClassifyPicture(format, au.firstSlice, au.firstSliceSize, au.hasRandomAccess);
+                entry.randomAccess = au.hasDecoderRefresh;
+                frames.push_back(entry);
+            }
+            au = Pending();
+        };
+
+        nvstForEachNalUnit(m_format, m_data, m_size, [&](const NvstNalUnit& nal) {
+            const bool vcl = nvstNalIsVcl(format, nal.type);
+            const bool boundary = au.hasVcl &&
+                ((vcl && nal.firstSliceOfPicture) || (!vcl && nvstNalStartsAccessUnit(format, nal.type)));
+            if (boundary)
+            {
+                finish(nal.offset);
+            }
+            if (!au.open)
+            {
+                au.open = true;
+                au.start = nal.offset;
+            }
+            if (vcl)
+            {
+                if (!au.hasVcl)
+                {
+                    au.firstSlice = data + nal.headerOffset;
+                    au.firstSliceSize = nal.size;
+                }
+                au.hasVcl = true;
+                au.hasRandomAccess |= nvstNalIsRandomAccess(format, nal.type);
+                au.hasDecoderRefresh |= nvstNalIsDecoderRefresh(format, nal.type);
+            }
+            return true;
+        });
+        finish(m_size);
+    }
+
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    NvstVideoFormat m_format = NVST_VF_H264;
+    std::vector<NvstPreEncodedFrameIndexEntry> m_frames;
+};
+
+/// Pushes the frames of an NvstPreEncodedFileSource to a stream connection at a fixed rate.
+///
+/// The file is looped forever; frame numbers keep increasing across loops.
+/// Call requestIntraFrame() from the onIdrRequestReceived callback so the next
+/// pushed frame is a random access frame (IDR, or IDR/BLA for H.265). Frames
+/// rejected by the SDK are skipped, and the player resynchronizes at the next
+/// random access frame so the client never sees a broken reference chain.
+/// \ingroup VideoData
+class NvstPreEncodedFilePlayer
+{
+public:
+    /// \param[in] source Indexed file, shared between players. Must outlive the player.
+    /// \param[in] streamConnection Connection of an NVST_SO_PRE_ENCODED video stream.
+    /// \param[in] fps Target frame rate.
+    /// \param[in] pushProc Function used to hand data to the SDK. Defaults to nvstPushStreamData.
+    NvstPreEncodedFilePlayer(
+        const NvstPreEncodedFileSource& source,
+        NvstStreamConnection streamConnection,
+        double fps,
+        PUSH_STREAM_DATA_PROC pushProc = nvstPushStreamData)
+        : m_source(source)
+        , m_streamConnection(streamConnection)
+        , m_pushProc(pushProc ? pushProc : nvstPushStreamData)
+    {
+        setFps(fps);
+    }
+
+    ~NvstPreEncodedFilePlayer() { stop(); }
+
+    NvstPreEncodedFilePlayer(const NvstPreEncodedFilePlayer&) = delete;
+    NvstPreEncodedFilePlayer& operator=(const NvstPreEncodedFilePlayer&) = delete;
+
+    /// Change the push rate. Takes effect from the next frame.
+    void setFps(double fps)
+    {
+        const int64_t intervalNs = fps > 0.0 ? static_cast<int64_t>(1e9 / fps) : 16666667;
+        m_intervalNs.store(intervalNs, std::memory_order_relaxed);
+    }
+
+    /// Make the next pushed frame a random access frame. Safe to call from SDK callbacks.
+    void requestIntraFrame() { m_intraRequested.store(true, std::memory_order_relaxed); }
+
+    /// Push the next frame immediately, without pacing.
+    /// \return The result of the push.
+    NvstResult pushNextFrame()
+    {
+        if (m_source.frameCount() == 0)
+        {
+            return NVST_R_INVALID_STATE;
+        }
+        if (m_intraRequested.exchange(false, std::memory_order_relaxed) || m_resync)
+        {
+            m_nextIndex = m_source.nextIntraFrame(m_nextIndex);
+        }
+
+        NvstStreamData data;
+        m_source.fillStreamData(m_nextIndex, m_frameNumber, &data);
+        const NvstResult result = m_pushProc(m_streamConnection, &data);
+        if (result == NVST_R_SUCCESS || result == NVST_R_FRAME_DROPPED)
+        {
+            m_pushed.fetch_add(1, std::memory_order_relaxed);
+            m_resync = false;
+        }
+        else
+        {
+            m_skipped.fetch_add(1, std::memory_order_relaxed);
+            m_resync = true;
+        }
+        ++m_frameNumber;
+        m_nextIndex = (m_nextIndex + 1) % m_source.frameCount();
+        return result;
+    }
+
+    /// Start pushing on a dedicated thread.
+    void start()
+    {
+        if (m_thread.joinable())
+        {
+            return;
+        }
+        m_running.store(true, std::memory_order_relaxed);
+        m_thread = std::thread([this] {
+            std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+            while (m_running.load(std::memory_order_relaxed))
+            {
+                pushNextFrame();
+                next += std::chrono::nanoseconds(m_intervalNs.load(std::memory_order_relaxed));
+                const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+                if (next < now)
+                {
+                    // Fell behind (e.g. the host is overloaded); don't burst to catch up.
+                    next = now;
+                }
+                std::this_thread::sleep_until(next);
+            }
+        });
+    }
+
+    /// Stop the pushing thread started with start().
+    void stop()
+    {
+        m_running.store(false, std::memory_order_relaxed);
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+    }
+
+    /// \return Number of frames accepted by the SDK.
+    uint64_t pushedCount() const { return m_pushed.load(std::memory_order_relaxed); }
+
+    /// \return Number of frames the SDK rejected.
+    uint64_t skippedCount() const { return m_skipped.load(std::memory_order_relaxed); }
+
+private:
+    const NvstPreEncodedFileSource& m_source;
+    NvstStreamConnection m_streamConnection;
+    PUSH_STREAM_DATA_PROC m_pushProc;
+    std::atomic<int64_t> m_intervalNs{16666667};
+    std::atomic<bool> m_intraRequested{false};
+    std::atomic<bool> m_running{false};
+    std::atomic<uint64_t> m_pushed{0};
+    std::atomic<uint64_t> m_skipped{0};
+    uint32_t m_nextIndex = 0;
+    uint32_t m_frameNumber = 0;
+    bool m_resync = false;
+    std::thread m_thread;
+};
@@ -0,0 +1,544 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file PushQueue.h
+/// Backpressure-aware asynchronous submission queue in front of nvstPushStreamData.
+///
+/// Producers (render, audio and input threads) enqueue stream data without blocking.
+/// A single sender thread drains the queue into nvstPushStreamData and applies a
+/// per-NvstMediaType policy whenever the queue or the SDK is saturated.
+
+#pragma once
+
+#include <nvst/common/Histogram.h>
+#include <nvst/common/Stream.h>
+#include <nvsc/TimeUtils.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/// What to do with stream data of a given media type under backpressure.
+/// \ingroup streamData
+typedef enum NvstPushPolicy_t
+{
+    /// Drop only when full: when the queue is full the oldest queued item is released
+    /// to make room. Everything else is pushed in order, and data rejected by the SDK
+    /// with NVST_R_BUSY is retried after retryIntervalUs.
+    /// Default for audio, where every dropped frame is an audible gap.
+    NVST_PP_DROP_OLDEST = 0,
+    /// Never drop: when the queue is full enqueue() fails with NVST_R_BUSY,
+    /// and data rejected by the SDK with NVST_R_BUSY is retried after retryIntervalUs.
+    /// Default for input and any other media type.
+    NVST_PP_RETRY = 1,
+    /// Keep only the freshest data: like NVST_PP_DROP_OLDEST when the queue is full,
+    /// but the sender also skips items superseded by newer ones, and data rejected by
+    /// the SDK with NVST_R_BUSY is released.
+    /// Default for video, so stale frames never get encoded.
+    NVST_PP_LATEST = 2,
+} NvstPushPolicy;
+
+/// Counters kept per media type by NvstPushQueue.
+/// \ingroup streamData
+typedef struct NvstPushQueueStats_t
+{
+    /// Items accepted by enqueue().
+    uint64_t enqueued;
+    /// Items rejected by enqueue() because the queue was full (NVST_PP_RETRY only).
+    uint64_t rejected;
+    /// Items released without being pushed (queue full, superseded or SDK busy).
+    uint64_t dropped;
+    /// Items accepted by the SDK (including NVST_R_FRAME_DROPPED).
+    uint64_t pushed;
+    /// Push attempts that returned NVST_R_BUSY.
+    uint64_t busy;
+    /// Items released after the SDK returned an error other than NVST_R_BUSY.
+    uint64_t failed;
+} NvstPushQueueStats;
+
+/// Callback used to release stream data the queue decided not to push.
+///
+/// Audio frames carry their own release callback, which the queue invokes when
+/// no callback is configured. Graphics surfaces, pre-encoded video and input
+/// events don't, so the application must provide one for those media types
+/// if they need releasing (e.g. NvstSurfacePool::release).
+/// \param[in] context Application-supplied pointer.
+/// \param[in] streamData The data that was dropped.
+typedef void (*NVST_PUSH_QUEUE_DROP_PROC)(void* context, const NvstStreamData* streamData);
+
+/// Configuration of NvstPushQueue.
+/// \ingroup streamData
+typedef struct NvstPushQueueConfig_t
+{
+    /// Number of items that can be queued per media type. Rounded up to a power of two.
+    uint32_t capacityPerMediaType;
+    /// Delay before retrying data rejected with NVST_R_BUSY under NVST_PP_RETRY and NVST_PP_DROP_OLDEST.
+    uint32_t retryIntervalUs;
+    /// Policy per media type, indexed by NvstMediaType.
+    NvstPushPolicy policy[NVST_MT_LAST];
+    /// Releases dropped data. Optional, see NVST_PUSH_QUEUE_DROP_PROC.
+    NVST_PUSH_QUEUE_DROP_PROC dropProc;
+    /// Context pointer passed to dropProc.
+    void* dropContext;
+    /// Function used to hand data to the SDK. Defaults to nvstPushStreamData.
+    PUSH_STREAM_DATA_PROC pushProc;
+} NvstPushQueueConfig;
+
+/// Fill the config with defaults: 8 items per media type, 1ms retry interval,
+/// latest-only for video, drop-oldest for audio, retry for everything else.
+static inline void nvstPushQueueGetDefaultConfig(NvstPushQueueConfig* config)
+{
+    config->capacityPerMediaType = 8;
+    config->retryIntervalUs = 1000;
+    for (int i = 0; i < NVST_MT_LAST; ++i)
+    {
+        config->policy[i] = NVST_PP_RETRY;
+    }
+    config->policy[NVST_MT_VIDEO] = NVST_PP_LATEST;
+    config->policy[NVST_MT_PRE_ENCODED_VIDEO] = NVST_PP_LATEST;
+    config->policy[NVST_MT_AUDIO] = NVST_PP_DROP_OLDEST;
+    config->dropProc = nullptr;
+    config->dropContext = nullptr;
+    config->pushProc = nvstPushStreamData;
+}
+
+/// Bounded, lock-free multi-producer single-consumer queue of NvstStreamData
+/// with a dedicated sender thread.
+///
+/// enqueue() never blocks and may be called from any thread. Each media type
+/// has its own ring, so a burst of video can never starve input events.
+/// Time spent in the queue (microseconds) and the queue depth observed at
+/// enqueue time are recorded per media type in lock-free histograms.
+/// \warning Pre-encoded frames of a P-frame chain should use NVST_PP_RETRY,
+/// since dropping one breaks decoding until the next I-frame.
+/// \ingroup streamData
+class NvstPushQueue
+{
+public:
+    /// Create the queue and start its sender thread.
+    /// \param[in] streamConnection Stream connection all data is pushed to.
+    /// \param[in] config Queue configuration, see nvstPushQueueGetDefaultConfig().
+    NvstPushQueue(NvstStreamConnection streamConnection, const NvstPushQueueConfig& config)
+        : m_streamConnection(streamConnection)
+        , m_config(config)
+    {
+        if (!m_config.pushProc)
+        {
+            m_config.pushProc = nvstPushStreamData;
+        }
+        uint32_t capacity = 2;
+        while (capacity < m_config.capacityPerMediaType)
+        {
+            capacity <<= 1;
+        }
+        for (int i = 0; i < NVST_MT_LAST; ++i)
+        {
+            m_rings[i].init(capacity);
+        }
+        m_thread = std::thread(&NvstPushQueue::senderLoop, this);
+    }
+
+    /// Stop the sender thread. Data still queued is released through the drop path.
+    ~NvstPushQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+            m_stop.store(true, std::memory_order_release);
+        }
+        m_wakeCondition.notify_one();
+        m_thread.join();
+
+        for (int type = 0; type < NVST_MT_LAST; ++type)
+        {
+            MediaQueue& queue = m_rings[type];
+            if (queue.hasPending)
+            {
+                drop(queue, queue.pending.data);
+                queue.hasPending = false;
+            }
+            Item item;
+            while (queue.ring.tryPop(item))
+            {
+                drop(queue, item.data);
+            }
+        }
+    }
+
+    NvstPushQueue(const NvstPushQueue&) = delete;
+    NvstPushQueue& operator=(const NvstPushQueue&) = delete;
+
+    /// Queue stream data for sending. Never blocks.
+    /// \param[in] streamData Data to push. The struct is copied; the payload it
+    /// references must stay valid until it is released.
+    /// \retval NVST_R_SUCCESS if the data was queued.
+    /// \retval NVST_R_INVALID_PARAM if streamData is NULL or has an invalid media type.
+    /// \retval NVST_R_BUSY if the ring is full and the media type uses NVST_PP_RETRY;
+    /// the queue doesn't take ownership in that case.
+    NvstResult enqueue(const NvstStreamData* streamData)
+    {
+        if (!streamData || streamData->mediaType <= NVST_MT_NONE || streamData->mediaType >= NVST_MT_LAST)
+        {
+            return NVST_R_INVALID_PARAM;
+        }
+        MediaQueue& queue = m_rings[streamData->mediaType];
+
+        Item item;
+        item.data = *streamData;
+        item.enqueueTimeNs = nvstGetTimeNs();
+
+        while (!queue.ring.tryPush(item))
+        {
+            if (m_config.policy[streamData->mediaType] == NVST_PP_RETRY)
+            {
+                queue.rejected.fetch_add(1, std::memory_order_relaxed);
+                return NVST_R_BUSY;
+            }
+            // Make room by evicting the oldest item; the ring is MPMC-safe,
+            // so a producer may consume from it too.
+            Item oldest;
+            if (queue.ring.tryPop(oldest))
+            {
+                drop(queue, oldest.data);
+            }
+        }
+
+        queue.enqueued.fetch_add(1, std::memory_order_relaxed);
+        queue.depth.record(queue.ring.sizeApprox());
+        wakeSender();
+        return NVST_R_SUCCESS;
+    }
+
+    /// Snapshot of the counters for one media type.
+    NvstPushQueueStats getStats(NvstMediaType mediaType) const
+    {
+        const MediaQueue& queue = m_rings[mediaType];
+        NvstPushQueueStats stats;
+        stats.enqueued = queue.enqueued.load(std::memory_order_relaxed);
+        stats.rejected = queue.rejected.load(std::memory_order_relaxed);
+        stats.dropped = queue.dropped.load(std::memory_order_relaxed);
+        stats.pushed = queue.pushed.load(std::memory_order_relaxed);
+        stats.busy = queue.busy.load(std::memory_order_relaxed);
+        stats.failed = queue.failed.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    /// Histogram of the queue depth observed right after each enqueue.
+    const NvstHistogram& getDepthHistogram(NvstMediaType mediaType) const { return m_rings[mediaType].depth; }
+
+    /// Histogram of time between enqueue and the SDK accepting the data, in microseconds.
+    const NvstHistogram& getTimeInQueueHistogram(NvstMediaType mediaType) const
+    {
+        return m_rings[mediaType].timeInQueueUs;
+    }
+
+private:
+    struct Item
+    {
+        NvstStreamData data;
+        int64_t enqueueTimeNs;
+    };
+
+    /// Bounded MPMC ring (Vyukov). Producers and the evicting path both use it
+    /// concurrently with the sender thread, so each cell carries a sequence number.
+    class Ring
+    {
+    public:
+        void init(uint32_t capacity)
+        {
+            m_mask = capacity - 1;
+            m_cells.reset(new Cell[capacity]);
+            for (uint32_t i = 0; i < capacity; ++i)
+            {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            m_enqueuePos.store(0, std::memory_order_relaxed);
+            m_dequeuePos.store(0, std::memory_order_relaxed);
+        }
+
+        bool tryPush(const Item& item)
+        {
+            uint64_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = m_cells[pos & m_mask];
+                const uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.item = item;
+                        cell.sequence.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        bool tryPop(Item& item)
+        {
+            uint64_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                Cell& cell = m_cells[pos & m_mask];
+                const uint64_t sequence = cell.sequence.load(std::memory_order_acquire);
+                const int64_t diff = static_cast<int64_t>(sequence) - static_cast<int64_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        item = cell.item;
+                        cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    pos = m_dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        uint64_t sizeApprox() const
+        {
+            const uint64_t enqueued = m_enqueuePos.load(std::memory_order_relaxed);
+            const uint64_t dequeued = m_dequeuePos.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+    private:
+        struct Cell
+        {
+            std::atomic<uint64_t> sequence;
+            Item item;
+        };
+
+        std::unique_ptr<Cell[]> m_cells;
+        uint64_t m_mask = 0;
+        alignas(64) std::atomic<uint64_t> m_enqueuePos;
+        alignas(64) std::atomic<uint64_t> m_dequeuePos;
+    };
+
+    struct MediaQueue
+    {
+        void init(uint32_t capacity) { ring.init(capacity); }
+
+        Ring ring;
+        /// Item rejected with NVST_R_BUSY awaiting retry. Owned by the sender thread.
+        Item pending;
+        bool hasPending = false;
+        int64_t retryAtNs = 0;
+
+        std::atomic<uint64_t> enqueued{0};
+        std::atomic<uint64_t> rejected{0};
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<uint64_t> pushed{0};
+        std::atomic<uint64_t> busy{0};
+        std::atomic<uint64_t> failed{0};
+        NvstHistogram depth;
+        NvstHistogram timeInQueueUs;
+    };
+
+    void wakeSender()
+    {
+        // Only take the lock when the sender is actually parked. The fence pairs with
+        // the one in senderLoop() so either the sender sees the new item or we see it sleeping.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_senderSleeping.load(std::memory_order_relaxed))
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_wakeMutex);
+                m_wakeRequested = true;
+            }
+            m_wakeCondition.notify_one();
+        }
+    }
+
+    void drop(MediaQueue& queue, const NvstStreamData& data)
+    {
+        queue.dropped.fetch_add(1, std::memory_order_relaxed);
+        release(data);
+    }
+
+    void release(const NvstStreamData& data)
+    {
+        if (m_config.dropProc)
+        {
+            m_config.dropProc(m_config.dropContext, &data);
+        }
+        else if (data.mediaType == NVST_MT_AUDIO && data.audioFrame.releaseProc)
+        {
+            data.audioFrame.releaseProc(&data.audioFrame);
+        }
+    }
+
+    /// Push one item to the SDK.
+    /// \return false if the item has to be retried later.
+    bool push(MediaQueue& queue, NvstMediaType type, const Item& item)
+    {
+        const NvstResult result = m_config.pushProc(m_streamConnection, &item.data);
+        if (result == NVST_R_SUCCESS || result == NVST_R_FRAME_DROPPED)
+        {
+            queue.pushed.fetch_add(1, std::memory_order_relaxed);
+            const int64_t acceptedNs = nvstGetTimeNs();
+            const int64_t waitedNs = acceptedNs > item.enqueueTimeNs ? acceptedNs - item.enqueueTimeNs : 0;
+            queue.timeInQueueUs.record(static_cast<uint64_t>(waitedNs / 1000));
+            return true;
+        }
+        if (result == NVST_R_BUSY)
+        {
+            queue.busy.fetch_add(1, std::memory_order_relaxed);
+            if (m_config.policy[type] != NVST_PP_LATEST)
+            {
+                return false;
+            }
+            drop(queue, item.data);
+            return true;
+        }
+        queue.failed.fetch_add(1, std::memory_order_relaxed);
+        release(item.data);
+        return true;
+    }
+
+    /// Drain one media type. \return true if anything is left to retry.
+    bool drain(NvstMediaType type, int64_t nowNs)
+    {
+        MediaQueue& queue = m_rings[type];
+        if (queue.hasPending)
+        {
+            if (nowNs < queue.retryAtNs)
+            {
+                return true;
+            }
+            if (!push(queue, type, queue.pending))
+            {
+                queue.retryAtNs = nowNs + static_cast<int64_t>(m_config.retryIntervalUs) * 1000;
+                return true;
+            }
+            queue.hasPending = false;
+        }
+
+        Item item;
+        if (m_config.policy[type] == NVST_PP_LATEST)
+        {
+            // Only the freshest item is worth sending; everything older is stale.
+            if (!queue.ring.tryPop(item))
+            {
+                return false;
+            }
+            Item newer;
+            while (queue.ring.tryPop(newer))
+            {
+                drop(queue, item.data);
+                item = newer;
+            }
+            push(queue, type, item);
+            return false;
+        }
+
+        while (queue.ring.tryPop(item))
+        {
+            if (!push(queue, type, item))
+            {
+                queue.pending = item;
+                queue.hasPending = true;
+                queue.retryAtNs = nowNs + static_cast<int64_t>(m_config.retryIntervalUs) * 1000;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// \return true if a ring holds data that isn't blocked behind a pending retry.
+    bool hasSendableData() const
+    {
+        for (int type = NVST_MT_NONE + 1; type < NVST_MT_LAST; ++type)
+        {
+            if (!m_rings[type].hasPending && m_rings[type].ring.sizeApprox() != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void senderLoop()
+    {
+        while (!m_stop.load(std::memory_order_acquire))
+        {
+            bool retryPending = false;
+            bool anyQueued = false;
+            const int64_t nowNs = nvstGetTimeNs();
+            // Input first: it is the most latency sensitive and the cheapest to send.
+            retryPending |= drain(NVST_MT_INPUT, nowNs);
+            for (int type = NVST_MT_NONE + 1; type < NVST_MT_LAST; ++type)
+            {
+                if (type != NVST_MT_INPUT)
+                {
+                    retryPending |= drain(static_cast<NvstMediaType>(type), nowNs);
+                }
+            }
+            if (hasSendableData())
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_wakeMutex);
+            m_senderSleeping.store(true, std::memory_order_relaxed);
+            // Re-check after publishing the sleeping flag to avoid a lost wakeup.
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            anyQueued = hasSendableData();
+            if (!anyQueued && !m_wakeRequested && !m_stop.load(std::memory_order_acquire))
+            {
+                if (retryPending)
+                {
+                    m_wakeCondition.wait_for(lock, std::chrono::microseconds(m_config.retryIntervalUs));
+                }
+                else
+                {
+                    m_wakeCondition.wait(lock, [this] {
+                        return m_wakeRequested || m_stop.load(std::memory_order_acquire);
+                    });
+                }
+            }
+            m_wakeRequested = false;
+            m_senderSleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    NvstStreamConnection m_streamConnection;
+    NvstPushQueueConfig m_config;
+    MediaQueue m_rings[NVST_MT_LAST];
+
+    std::atomic<bool> m_stop{false};
+    std::atomic<bool> m_senderSleeping{false};
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    bool m_wakeRequested = false;
+    std::thread m_thread;
+};
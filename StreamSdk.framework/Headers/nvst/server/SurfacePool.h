@@ -0,0 +1,378 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file SurfacePool.h
+/// Recycling pool of system memory graphics surfaces for nvstPushStreamData.
+///
+/// All surfaces are allocated up front, page aligned, and are returned to a
+/// lock-free free list by release() instead of being freed.
+/// This keeps the allocator off the hot path when pushing NVST_SO_SYSMEM
+/// frames at high frame rates across many sessions.
+
+#pragma once
+
+#include <nvst/common/StreamData.h>
+#include <nvst/common/VideoFormat.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <unistd.h>
+#endif
+
+/// Counters describing pool usage.
+/// \ingroup VideoData
+typedef struct NvstSurfacePoolStats_t
+{
+    /// Number of surfaces handed out since the pool was created.
+    uint64_t acquired;
+    /// Number of surfaces returned through release().
+    uint64_t released;
+    /// Number of acquire attempts that failed because every surface was in flight.
+    uint64_t exhausted;
+    /// Number of surfaces currently owned by the application or the SDK.
+    uint32_t inFlight;
+    /// Total number of surfaces in the pool.
+    uint32_t capacity;
+} NvstSurfacePoolStats;
+
+/// Fixed-capacity pool of pre-allocated NVST_SO_SYSMEM graphics surfaces.
+///
+/// Typical usage:
+/// \code
+/// NvstSurfacePool pool(1920, 1080, NVST_SF_ARGB, 8);
+/// NvstGraphicsSurface* surface = pool.acquire();
+/// if (surface)
+/// {
+///     render(surface->surface, surface->pitch);
+///     NvstStreamData data = {};
+///     data.mediaType = NVST_MT_VIDEO;
+///     data.graphicsSurface = *surface;
+///     if (nvstPushStreamData(streamConnection, &data) != NVST_R_SUCCESS)
+///     {
+///         NvstSurfacePool::release(surface);
+///     }
+///     else
+///     {
+///         // Keep the surface until the SDK is finished with the frame, e.g. until the
+///         // encoder has consumed it, then return it to the pool.
+///         inFlight.push_back(surface);
+///     }
+/// }
+/// ...
+/// NvstSurfacePool::release(inFlight.front());
+/// \endcode
+/// The SDK does not release pushed surfaces: the application must call release()
+/// exactly once for every acquired surface, after the SDK is done reading it.
+/// Surfaces that are never released stay in flight and the pool eventually runs dry.
+/// The pool locates the owning slot through NvstGraphicsSurface::context,
+/// so that field must be left untouched; use setUserContext() to attach
+/// application data to a surface instead.
+/// \warning Every surface must be released before the pool is destroyed.
+/// \ingroup VideoData
+class NvstSurfacePool
+{
+public:
+    /// Create the pool and allocate all of its surfaces.
+    /// \param[in] width Width of every surface in pixels.
+    /// \param[in] height Height of every surface in pixels.
+    /// \param[in] format One of NVST_SF_ARGB, NVST_SF_BGRA, NVST_SF_ABGR, NVST_SF_NV12 or NVST_SF_YCbCr420p.
+    /// \param[in] capacity Number of surfaces to pre-allocate.
+    /// If the format is not supported or an allocation fails, valid() returns false.
+    NvstSurfacePool(uint16_t width, uint16_t height, NvstSurfaceFormat format, uint32_t capacity)
+        : m_format(format)
+        , m_capacity(capacity)
+        , m_bufferSize(0)
+        , m_slots(new Slot[capacity]())
+        , m_head(packHead(0, kEmpty))
+    {
+        uint16_t pitch = 0;
+        m_bufferSize = computeLayout(width, height, format, &pitch);
+        m_valid = m_bufferSize != 0;
+
+        const size_t alignment = pageSize();
+        for (uint32_t i = 0; i < m_capacity && m_valid; ++i)
+        {
+            Slot& slot = m_slots[i];
+            slot.pool = this;
+            slot.index = i;
+            slot.userContext = nullptr;
+            slot.memory = alignedAlloc(alignment, roundUp(m_bufferSize, alignment));
+            if (!slot.memory)
+            {
+                m_valid = false;
+                break;
+            }
+            std::memset(&slot.surface, 0, sizeof(slot.surface));
+            slot.surface.width = width;
+            slot.surface.height = height;
+            slot.surface.dataWidth = width;
+            slot.surface.dataHeight = height;
+            slot.surface.pitch = pitch;
+            slot.surface.surface = slot.memory;
+            slot.surface.context = &slot;
+        }
+
+        if (m_valid)
+        {
+            for (uint32_t i = m_capacity; i > 0; --i)
+            {
+                push(i - 1);
+            }
+        }
+    }
+
+    ~NvstSurfacePool()
+    {
+        for (uint32_t i = 0; i < m_capacity; ++i)
+        {
+            alignedFree(m_slots[i].memory);
+        }
+    }
+
+    NvstSurfacePool(const NvstSurfacePool&) = delete;
+    NvstSurfacePool& operator=(const NvstSurfacePool&) = delete;
+
+    /// \return true if all surfaces were allocated successfully.
+    bool valid() const { return m_valid; }
+
+    /// \return Surface format shared by all surfaces in the pool.
+    NvstSurfaceFormat format() const { return m_format; }
+
+    /// \return Size in bytes of the pixel buffer backing each surface.
+    size_t bufferSize() const { return m_bufferSize; }
+
+    /// Take a surface from the free list.
+    ///
+    /// Per-frame fields (timestamps, sequence number, metadata, hints) are reset,
+    /// geometry and the pixel buffer are preserved. This function is lock-free.
+    /// \return The surface, or NULL if every surface is currently in flight.
+    NvstGraphicsSurface* acquire()
+    {
+        const uint32_t index = pop();
+        if (index == kEmpty)
+        {
+            m_exhausted.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        m_acquired.fetch_add(1, std::memory_order_relaxed);
+
+        Slot& slot = m_slots[index];
+        NvstGraphicsSurface& surface = slot.surface;
+        surface.dataWidth = surface.width;
+        surface.dataHeight = surface.height;
+        surface.renderSequenceNumber = 0;
+        surface.renderTimestampUs = 0;
+        surface.displayTimestampUs = 0;
+        surface.captureStartTs = 0;
+        surface.captureEndTs = 0;
+        surface.metadataSize = 0;
+        surface.metadata = nullptr;
+        surface.sizeHintPerBlock = 0;
+        surface.meHintCountsPerBlock = nullptr;
+        surface.meExternalHints = nullptr;
+        surface.bPerPixelAlpha = false;
+        surface.vvsyncStatus = NVST_VV_DISABLED;
+        surface.context = &slot;
+        slot.userContext = nullptr;
+        return &surface;
+    }
+
+    /// Return a surface to the pool it was acquired from.
+    ///
+    /// Called by the application once the SDK no longer uses the surface. Accepts either
+    /// the pointer returned by acquire() or any copy of that struct, since the owning slot
+    /// is found through NvstGraphicsSurface::context. This function is lock-free.
+    /// \param[in] surface Surface obtained from acquire(). NULL is ignored.
+    static void release(const NvstGraphicsSurface* surface)
+    {
+        if (!surface || !surface->context)
+        {
+            return;
+        }
+        Slot* slot = static_cast<Slot*>(surface->context);
+        slot->pool->m_released.fetch_add(1, std::memory_order_relaxed);
+        slot->pool->push(slot->index);
+    }
+
+    /// Attach application data to an acquired surface.
+    static void setUserContext(const NvstGraphicsSurface* surface, void* userContext)
+    {
+        static_cast<Slot*>(surface->context)->userContext = userContext;
+    }
+
+    /// \return Application data attached through setUserContext(), or NULL.
+    static void* getUserContext(const NvstGraphicsSurface* surface)
+    {
+        return static_cast<Slot*>(surface->context)->userContext;
+    }
+
+    /// Snapshot of the pool counters.
+    NvstSurfacePoolStats getStats() const
+    {
+        NvstSurfacePoolStats stats;
+        stats.acquired = m_acquired.load(std::memory_order_relaxed);
+        stats.released = m_released.load(std::memory_order_relaxed);
+        stats.exhausted = m_exhausted.load(std::memory_order_relaxed);
+        stats.inFlight = static_cast<uint32_t>(stats.acquired - stats.released);
+        stats.capacity = m_capacity;
+        return stats;
+    }
+
+    /// Compute the pitch and buffer size the pool uses for a given surface layout.
+    /// \param[in] width Width in pixels.
+    /// \param[in] height Height in pixels.
+    /// \param[in] format Surface format.
+    /// \param[out] pitch Row pitch in bytes (0 for planar formats, which don't use it).
+    /// \return Buffer size in bytes, or 0 if the format is not supported on the sysmem path.
+    static size_t computeLayout(uint16_t width, uint16_t height, NvstSurfaceFormat format, uint16_t* pitch)
+    {
+        const size_t w = width;
+        const size_t h = height;
+        switch (format)
+        {
+        case NVST_SF_ARGB:
+        case NVST_SF_BGRA:
+        case NVST_SF_ABGR:
+        {
+            const size_t rowBytes = roundUp(w * 4, kRowAlignment);
+            if (rowBytes > UINT16_MAX)
+            {
+                return 0;
+            }
+            *pitch = static_cast<uint16_t>(rowBytes);
+            return rowBytes * h;
+        }
+        case NVST_SF_NV12:
+        {
+            if ((w | h) & 1)
+            {
+                return 0;
+            }
+            const size_t rowBytes = roundUp(w, kRowAlignment);
+            if (rowBytes > UINT16_MAX)
+            {
+                return 0;
+            }
+            *pitch = static_cast<uint16_t>(rowBytes);
+            return rowBytes * h + rowBytes * (h / 2);
+        }
+        case NVST_SF_YCbCr420p:
+            if ((w | h) & 1)
+            {
+                return 0;
+            }
+            *pitch = 0;
+            return w * h + 2 * (w / 2) * (h / 2);
+        default:
+            return 0;
+        }
+    }
+
+private:
+    /// Row pitch alignment, wide enough for any SIMD load used on the surfaces.
+    static const size_t kRowAlignment = 64;
+    static const uint32_t kEmpty = UINT32_MAX;
+
+    struct Slot
+    {
+        NvstGraphicsSurface surface;
+        NvstSurfacePool* pool;
+        void* memory;
+        void* userContext;
+        uint32_t index;
+        std::atomic<uint32_t> next;
+    };
+
+    static uint64_t packHead(uint32_t tag, uint32_t index) { return (static_cast<uint64_t>(tag) << 32) | index; }
+
+    static size_t roundUp(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+    static size_t pageSize()
+    {
+#ifdef _WIN32
+        return 4096;
+#else
+        const long size = sysconf(_SC_PAGESIZE);
+        return size > 0 ? static_cast<size_t>(size) : 4096;
+#endif
+    }
+
+    static void* alignedAlloc(size_t alignment, size_t size)
+    {
+#ifdef _WIN32
+        return _aligned_malloc(size, alignment);
+#else
+        void* memory = nullptr;
+        return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+#endif
+    }
+
+    static void alignedFree(void* memory)
+    {
+#ifdef _WIN32
+        _aligned_free(memory);
+#else
+        free(memory);
+#endif
+    }
+
+    /// Treiber stack push; the tag in the upper half of m_head guards against ABA.
+    void push(uint32_t index)
+    {
+        uint64_t head = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            m_slots[index].next.store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            const uint64_t desired = packHead(static_cast<uint32_t>(head >> 32) + 1, index);
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_release, std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+    }
+
+    uint32_t pop()
+    {
+        uint64_t head = m_head.load(std::memory_order_acquire);
+        for (;;)
+        {
+            const uint32_t index = static_cast<uint32_t>(head);
+            if (index == kEmpty)
+            {
+                return kEmpty;
+            }
+            const uint32_t next = m_slots[index].next.load(std::memory_order_relaxed);
+            const uint64_t desired = packHead(static_cast<uint32_t>(head >> 32) + 1, next);
+            if (m_head.compare_exchange_weak(head, desired, std::memory_order_acquire, std::memory_order_acquire))
+            {
+                return index;
+            }
+        }
+    }
+
+    NvstSurfaceFormat m_format;
+    uint32_t m_capacity;
+    size_t m_bufferSize;
+    bool m_valid;
+    std::unique_ptr<Slot[]> m_slots;
+    std::atomic<uint64_t> m_head;
+    std::atomic<uint64_t> m_acquired{0};
+    std::atomic<uint64_t> m_released{0};
+    std::atomic<uint64_t> m_exhausted{0};
+};
@@ -0,0 +1,325 @@
+// Copyright NVIDIA Corporation 2022
+// TO THE MAXIMUM EXTENT PERMITTED BY APPLICABLE LAW, THIS SOFTWARE IS PROVIDED
+// *AS IS* AND NVIDIA AND ITS SUPPLIERS DISCLAIM ALL WARRANTIES, EITHER EXPRESS
+// OR IMPLIED, INCLUDING, BUT NOT LIMITED TO, IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.  IN NO EVENT SHALL
+// NVIDIA OR ITS SUPPLIERS BE LIABLE FOR ANY SPECIAL, INCIDENTAL, INDIRECT, OR
+// CONSEQUENTIAL DAMAGES WHATSOEVER (INCLUDING, WITHOUT LIMITATION, DAMAGES FOR
+// LOSS OF BUSINESS PROFITS, BUSINESS INTERRUPTION, LOSS OF BUSINESS
+// INFORMATION, OR ANY OTHER PECUNIARY LOSS) ARISING OUT OF THE USE OF OR
+// INABILITY TO USE THIS SOFTWARE, EVEN IF NVIDIA HAS BEEN ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGES.
+
+/// \file TileDiffMap.h
+/// Software difference map for system memory surfaces.
+///
+/// The CPU counterpart of the FBC difference map (useFbcDiffMap), which is
+/// only available with the FBC capture strategy. Each frame is split into
+/// square tiles that are hashed and compared with the last pushed frame, giving
+/// a per-tile change map, fully static frame detection and a static scene
+/// hint comparable to the encoder utilization based detection of QoS
+/// (staticSceneEncUtilThresx1000).
+
+#pragma once
+
+#include <nvst/common/SurfaceLayout.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/// Configuration of NvstTileDiffMap.
+/// \ingroup VideoData
+typedef struct NvstTileDiffMapConfig_t
+{
+    /// Tile edge in luma pixels. Must be a multiple of 2.
+    uint32_t tileSize;
+    /// A static frame is still pushed if nothing was pushed for this long,
+    /// so the encoder timeout (encoderTimeoutMs) never fires and late joiners
+    /// get refreshed. 0 drops every static frame.
+    uint32_t keepAliveIntervalMs;
+    /// Number of consecutive static frames after which the scene is reported static.
+    uint32_t staticSceneFrames;
+    /// Share of changed tiles, in thousandths, below which a frame counts towards
+    /// a static scene (the frame itself is only dropped if no tile changed).
+    uint32_t staticSceneChangeThresx1000;
+} NvstTileDiffMapConfig;
+
+/// Fill the config with defaults: 64 pixel tiles, 1 s keep-alive,
+/// static scene after 30 frames with under 1% of tiles changing.
+static inline void nvstTileDiffMapGetDefaultConfig(NvstTileDiffMapConfig* config)
+{
+    config->tileSize = 64;
+    config->keepAliveIntervalMs = 1000;
+    config->staticSceneFrames = 30;
+    config->staticSceneChangeThresx1000 = 10;
+}
+
+/// Counters of an NvstTileDiffMap.
+/// \ingroup VideoData
+typedef struct NvstTileDiffMapStats_t
+{
+    /// Frames passed to update().
+    uint64_t framesAnalyzed;
+    /// Frames with no changed tile.
+    uint64_t staticFrames;
+    /// Static frames for which shouldPush() returned false.
+    uint64_t framesSkipped;
+    /// Static frames pushed because of keepAliveIntervalMs.
+    uint64_t keepAliveFrames;
+    /// Sum of changed tiles over all frames.
+    uint64_t changedTiles;
+} NvstTileDiffMapStats;
+
+/// Tile hashing difference map.
+///
+/// Frames are compared with the last frame confirmed through onPushed(), which
+/// is the encoder's reference, not merely the last analyzed one; content whose
+/// push failed or was skipped keeps counting as changed until it gets through.
+///
+/// Typical use in the push loop:
+/// \code
+///     const uint64_t nowUs = nvstGetTimeNs() / 1000;
+///     diffMap.update(surface);
+///     if (diffMap.shouldPush(nowUs) && nvstPushStreamData(connection, &data) == NVST_R_SUCCESS)
+///     {
+///         diffMap.onPushed(nowUs);
+///     }
+///     else
+///     {
+///         recycle(surface);
+///     }
+/// \endcode
+/// Not thread safe; use one instance per stream.
+/// \ingroup VideoData
+class NvstTileDiffMap
+{
+public:
+    /// \param[in] width Width of the frames in pixels.
+    /// \param[in] height Height of the frames in pixels.
+    /// \param[in] format Format of the frames; any format supported by nvstGetSurfacePlanes.
+    /// \param[in] config Diff map configuration.
+    NvstTileDiffMap(uint32_t width, uint32_t height, NvstSurfaceFormat format, const NvstTileDiffMapConfig& config)
+        : m_width(width)
+        , m_height(height)
+        , m_format(format)
+        , m_config(config)
+    {
+        if (m_config.tileSize < 2)
+        {
+            m_config.tileSize = 2;
+        }
+        m_config.tileSize &= ~1u;
+        m_tilesX = (width + m_config.tileSize - 1) / m_config.tileSize;
+        m_tilesY = (height + m_config.tileSize - 1) / m_config.tileSize;
+        m_hashes.assign(static_cast<size_t>(m_tilesX) * m_tilesY, 0);
+        m_pendingHashes.assign(m_hashes.size(), 0);
+        m_map.assign(m_hashes.size(), 1);
+    }
+
+    /// Hash a new frame and compare it with the last pushed one.
+    ///
+    /// Every frame until the first onPushed(), and after reset(), is reported as fully changed.
+    /// \return Number of changed tiles, or -1 if the surface can't be read.
+    int64_t update(const NvstGraphicsSurface* surface)
+    {
+        NvstSurfacePlanes planes;
+        if (!nvstGetSurfacePlanes(surface, m_format, &planes) || planes.width != m_width ||
+            planes.height != m_height)
+        {
+            return -1;
+        }
+
+        const uint32_t tileSize = m_config.tileSize;
+        const uint32_t bytesPerPixel = planes.planeCount == 1 ? 4 : 1;
+        m_lanes.resize(static_cast<size_t>(m_tilesX) * 4);
+        uint32_t changed = 0;
+        for (uint32_t ty = 0; ty < m_tilesY; ++ty)
+        {
+            for (size_t i = 0; i < m_lanes.size(); i += 4)
+            {
+                m_lanes[i] = kSeed + kPrime1;
+                m_lanes[i + 1] = kSeed ^ kPrime2;
+                m_lanes[i + 2] = kSeed;
+                m_lanes[i + 3] = kSeed - kPrime1;
+            }
+            for (uint32_t p = 0; p < planes.planeCount; ++p)
+            {
+                // NV12 chroma interleaves Cb and Cr, so a chroma tile is as many bytes wide as a luma tile.
+                const bool chroma = p > 0;
+                const uint32_t shift = chroma ? 1 : 0;
+                const uint32_t tileBytes = (tileSize >> shift) * (chroma && planes.planeCount == 2 ? 2 : bytesPerPixel);
+                const size_t rowBytes = (planes.planeCount == 2 && chroma) ? ((m_width + 1) & ~1u)
+                                                                            : ((m_width + shift) >> shift) * bytesPerPixel;
+                const uint32_t y0 = (ty * tileSize) >> shift;
+                const uint32_t y1 = std::min((ty + 1) * tileSize, m_height + shift) >> shift;
+                for (uint32_t y = y0; y < y1; ++y)
+                {
+                    const uint8_t* row = planes.data[p] + static_cast<size_t>(planes.pitch[p]) * y;
+                    for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+                    {
+                        const size_t begin = static_cast<size_t>(tx) * tileBytes;
+                        const size_t end = std::min(begin + tileBytes, rowBytes);
+                        hashBytes(&m_lanes[4 * tx], row + begin, end - begin);
+                    }
+                }
+            }
+            for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+            {
+                const size_t index = static_cast<size_t>(ty) * m_tilesX + tx;
+                const uint64_t hash = finalize(&m_lanes[4 * tx]) | 1; // 0 marks "no previous frame".
+                const bool tileChanged = hash != m_hashes[index];
+                m_map[index] = tileChanged ? 1 : 0;
+                m_pendingHashes[index] = hash;
+                changed += tileChanged ? 1 : 0;
+            }
+        }
+
+        m_changedTiles = changed;
+        ++m_stats.framesAnalyzed;
+        m_stats.changedTiles += changed;
+        if (changed == 0)
+        {
+            ++m_stats.staticFrames;
+        }
+        const uint64_t tiles = tileCount();
+        if (static_cast<uint64_t>(changed) * 1000 <= tiles * m_config.staticSceneChangeThresx1000)
+        {
+            ++m_staticRun;
+        }
+        else
+        {
+            m_staticRun = 0;
+        }
+        return changed;
+    }
+
+    /// Decide whether the frame given to the last update() should be pushed.
+    /// Call onPushed() once the push succeeded.
+    /// \param[in] nowUs Current time in microseconds, e.g. nvstGetTimeNs() / 1000.
+    /// \return true if the frame changed or the keep-alive interval elapsed.
+    bool shouldPush(uint64_t nowUs)
+    {
+        const bool keepAlive = m_hasPushed && m_config.keepAliveIntervalMs &&
+            nowUs - m_lastPushUs >= static_cast<uint64_t>(m_config.keepAliveIntervalMs) * 1000;
+        if (m_changedTiles == 0 && m_hasPushed && !keepAlive)
+        {
+            ++m_stats.framesSkipped;
+            return false;
+        }
+        if (m_changedTiles == 0 && keepAlive)
+        {
+            ++m_stats.keepAliveFrames;
+        }
+        return true;
+    }
+
+    /// Confirm that the frame given to the last update() was pushed, making it the
+    /// reference the next frames are compared with.
+    /// \param[in] nowUs Time of the push, on the clock given to shouldPush().
+    void onPushed(uint64_t nowUs)
+    {
+        m_hashes = m_pendingHashes;
+        m_hasPushed = true;
+        m_lastPushUs = nowUs;
+    }
+
+    /// Forget the previous frame, e.g. after a stream restart or an IDR request.
+    void reset()
+    {
+        std::fill(m_hashes.begin(), m_hashes.end(), 0);
+        std::fill(m_pendingHashes.begin(), m_pendingHashes.end(), 0);
+        std::fill(m_map.begin(), m_map.end(), 1);
+        m_hasPushed = false;
+        m_staticRun = 0;
+    }
+
+    /// \return true if the last frame had no changed tile.
+    bool isStaticFrame() const { return m_changedTiles == 0 && m_stats.framesAnalyzed > 0; }
+
+    /// \return true after staticSceneFrames consecutive frames below staticSceneChangeThresx1000.
+    /// Pass this to QoS as the static scene hint, in place of the encoder utilization
+    /// test against staticSceneEncUtilThresx1000.
+    bool isStaticScene() const { return m_staticRun >= m_config.staticSceneFrames; }
+
+    /// \return Share of tiles changed in the last frame, in thousandths.
+    uint32_t changedTilesx1000() const
+    {
+        const uint64_t tiles = tileCount();
+        return tiles ? static_cast<uint32_t>(static_cast<uint64_t>(m_changedTiles) * 1000 / tiles) : 0;
+    }
+
+    /// \return Number of tiles changed in the last frame.
+    uint32_t changedTiles() const { return m_changedTiles; }
+
+    /// Change map of the last frame, tilesX() * tilesY() bytes in row-major order,
+    /// 1 for a changed tile and 0 otherwise.
+    const uint8_t* map() const { return m_map.data(); }
+
+    uint32_t tilesX() const { return m_tilesX; }
+    uint32_t tilesY() const { return m_tilesY; }
+    uint64_t tileCount() const { return static_cast<uint64_t>(m_tilesX) * m_tilesY; }
+
+    NvstTileDiffMapStats getStats() const { return m_stats; }
+
+private:
+    static const uint64_t kSeed = 0x9E3779B97F4A7C15ull;
+    static const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+    static const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+    static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static uint64_t load64(const uint8_t* p)
+    {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    /// Absorb a byte range into four independent lanes, which keeps the multiplier busy.
+    static void hashBytes(uint64_t* lane, const uint8_t* data, size_t size)
+    {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                lane[k] = rotl(lane[k] + load64(data + i + 8 * k) * kPrime2, 31) * kPrime1;
+            }
+        }
+        for (; i + 8 <= size; i += 8)
+        {
+            lane[0] = rotl(lane[0] ^ (load64(data + i) * kPrime2), 27) * kPrime1;
+        }
+        for (; i < size; ++i)
+        {
+            lane[1] = rotl(lane[1] ^ (data[i] * kPrime1), 11) * kPrime2;
+        }
+    }
+
+    static uint64_t finalize(const uint64_t* lane)
+    {
+        const uint64_t hash = rotl(lane[0], 1) + rotl(lane[1], 7) + rotl(lane[2], 12) + rotl(lane[3], 18);
+        return hash ^ (hash >> 29);
+    }
+
+    uint32_t m_width;
+    uint32_t m_height;
+    NvstSurfaceFormat m_format;
+    NvstTileDiffMapConfig m_config;
+    uint32_t m_tilesX = 0;
+    uint32_t m_tilesY = 0;
+    /// Tile hashes of the last pushed frame; 0 if there is none.
+    std::vector<uint64_t> m_hashes;
+    /// Tile hashes of the frame given to the last update().
+    std::vector<uint64_t> m_pendingHashes;
+    /// Hash state of the current row of tiles, four lanes per tile.
+    std::vector<uint64_t> m_lanes;
+    std::vector<uint8_t> m_map;
+    uint32_t m_changedTiles = 0;
+    uint32_t m_staticRun = 0;
+    bool m_hasPushed = false;
+    uint64_t m_lastPushUs = 0;
+    NvstTileDiffMapStats m_stats = {};
+};